@@ -7,6 +7,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "memsetting.h"
 #include "mapqueue.h"
 #include "varray.h"
@@ -69,6 +75,91 @@ struct chain_info {
     chain_info(std::vector<utils::mapqueue<size_t>> &&c, std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &&c2) : counts(std::move(c)), contents(std::move(c2)) {}
 };
 
+//束搜索链排序方式
+enum chain_order {
+    CHAIN_SHORTEST = 0,   //层数最少优先 同层偏移和小者优先
+    CHAIN_MIN_OFFSET = 1, //偏移和最小优先
+};
+
+//环路与冗余链处理
+enum cycle_mode {
+    CYCLE_KEEP = 0,     //保留全部链 (原方式)
+    CYCLE_SHORTEST = 1, //每个指针只保留在它第一次出现 (离目标最近) 的层 搜索时直接裁剪 环路不会再展开
+    CYCLE_ACYCLIC = 2,  //输出时逐链检查 去掉重复经过同一地址的链 以及同一起点已有更短后缀链的链
+};
+
+//束搜索策略 每层最多保留 width 个节点 内存和耗时只与 width * depth 相关
+//内置评分 = offset_weight * 最小子偏移得分 + chain_weight * 链数得分 + region_weight * 区域得分
+//各项得分均归一化到 [0, 1]
+template <class T>
+struct beam_policy {
+    size_t width;        //每层保留的节点上限 0为不限制
+    float offset_weight; //节点到子节点的最小偏移 越小越优
+    float chain_weight;  //经过该节点到达目标的链数(扇入) 越多越优
+    float region_weight; //节点所在内存区域 静态数据/bss > 匿名 > 堆
+    size_t topk;         //每个静态模块最多输出的链数 0为不限制
+    chain_order order;   //topk 的排序方式
+
+    //自定义评分 (节点, 层数, 链数) 返回值越大越优 设置后替换内置评分
+    std::function<double(const pointer_dir<T> &, int, double)> scorer;
+
+    beam_policy() : width(0), offset_weight(1.0f), chain_weight(1.0f), region_weight(0.5f), topk(0), order(CHAIN_SHORTEST) {}
+};
+
+//每层的偏移规则 偏移 = 子节点地址 - 指针值 按有符号数解释
+//允许 [-floor, max] 内且为 align 倍数的偏移 whitelist 非空时只允许其中的偏移
+//规则在搜索和建立索引的循环里检查 不满足的节点不会进入下一层
+struct offset_rule {
+    size_t max;   //最大正向偏移 0为使用扫描参数 offset
+    size_t floor; //负向偏移下限的绝对值 0为不允许负偏移
+    size_t align; //偏移必须是 align 的倍数 0/1为不限制
+    std::vector<long> whitelist; //已知偏移 (升序) 空为不限制
+
+    offset_rule() : max(0), floor(0), align(1) {}
+
+    //与原来的 [0, max] 窗口相同 走不检查规则的快速路径
+    bool trivial() const { return floor == 0 && align <= 1 && whitelist.empty(); }
+
+    bool accept(long d) const
+    {
+        if (d < -(long)floor || d > (long)max)
+            return false;
+        if (align > 1 && d % (long)align != 0)
+            return false;
+        return whitelist.empty() || std::binary_search(whitelist.begin(), whitelist.end(), d);
+    }
+
+    //清单中记录的规则签名 max/floor/align/w1,w2...
+    std::string signature() const
+    {
+        std::string sig = std::to_string(max) + "/" + std::to_string(floor) + "/" + std::to_string(align) + "/";
+        for (size_t i = 0; i < whitelist.size(); ++i)
+            sig += (i ? "," : "") + std::to_string(whitelist[i]);
+        return sig;
+    }
+};
+
+//T 的差值按有符号解释 负偏移在无符号运算中是回绕的
+template <class T>
+inline long signed_offset(T d)
+{
+    return (long)(typename std::make_signed<T>::type)d;
+}
+
+//文本中的偏移: 正偏移 "+ 0x10" 负偏移 "- 0x10" 返回写入的字符数
+template <class T>
+inline int format_offset(char *buf, const char *prefix, T d)
+{
+    long off = signed_offset(d);
+    return off < 0 ? sprintf(buf, "%s- 0x%lX", prefix, (size_t)-off) : sprintf(buf, "%s+ 0x%lX", prefix, (size_t)off);
+}
+
+//.bin 的读取方式 决定映射后的 madvise 提示
+enum cprog_access {
+    CPROG_SEQUENTIAL = 0, //逐层顺序读取 转文本 校验 对比
+    CPROG_RANDOM = 1,     //按链号随机读取 cstore
+};
+
 struct cprog_header {
     char sign[128];
     // int max_offset;
@@ -98,6 +189,25 @@ struct cprog_llen {
 template <typename T>
 using cprog_data = pointer_dir<T>;
 
+//可选的链索引段 附加在 v101 或 v2 数据之后 文件最后是 cprog_index_tail
+//段内依次为 cprog_index_header 每层 count + 1 个 uint64_t (该层前 i 个节点之下的链数)
+//每个模块 pointer_count + 1 个 uint64_t (该模块前 i 个根节点的链数)
+//有索引时可以按链号直接定位一条链 不需要展开其他链 见 cstore.h
+struct cprog_index_header {
+    char magic[8]; //"chainidx"
+    uint32_t version; //1
+    uint32_t level;
+    uint64_t module_count;
+    uint64_t chains; //总链数
+};
+
+struct cprog_index_tail {
+    uint64_t offset; //cprog_index_header 在文件中的偏移
+    char magic[8];
+};
+
+constexpr char cprog_index_magic[8] = {'c', 'h', 'a', 'i', 'n', 'i', 'd', 'x'};
+
 template <typename T>
 struct cprog_sym_integr {
     cprog_sym<T> *sym;
@@ -143,9 +253,17 @@ template <typename T>
 class base
 {
 public:
+    //解析 b_data 中的 v101 布局 一次遍历检查文件头 每个模块和每层的长度不超出文件 失败时抛出 std::runtime_error
     void parse_cprog_bin_data(cprog_chain_info<T> &b_data);
 
-    cprog_chain_info<T> parse_cprog_bin_data(FILE *f);
+    //v2 文件: 解压并解码为 v101 的内存布局 (匿名映射) 替换 b_data 中的文件映射 之后按 v101 解析
+    void unpack_cprog_v2(cprog_chain_info<T> &b_data);
+
+    //只读映射 (MAP_PRIVATE) 文件 按 access 设置访问提示 并预读各层数据
+    cprog_chain_info<T> parse_cprog_bin_data(FILE *f, cprog_access access = CPROG_SEQUENTIAL);
+
+    //文件末尾有索引段时返回索引段的偏移 (即链数据的长度) 否则返回 size
+    static size_t cprog_index_offset(const char *addr, size_t size);
 
 };
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "cbase.h"
+#include "cpack.h"
+#include <climits>
 #include <stdexcept>
 
 #define PARSE_ADDR_DATA(a, b) \
@@ -19,45 +21,228 @@ void chainer::base<T>::parse_cprog_bin_data(chainer::cprog_chain_info<T> &b_data
     auto &syms = b_data.syms;
     auto &contents = b_data.contents;
 
+    // 所有长度都要落在链数据内 (索引段之前)
+    const char *limit = b_data.addr + cprog_index_offset(b_data.addr, b_data.size);
+    auto need = [&addr, limit](size_t n) {
+        if ((size_t)(limit - addr) < n)
+            throw std::runtime_error("指针链文件不完整或长度字段损坏");
+    };
+
+    need(sizeof(*header));
     PARSE_ADDR_DATA(header, addr);
+    if (strncmp(header->sign, ".bin from chainer", 17) != 0)
+        throw std::runtime_error("不是指针链二进制文件");
+    if (header->size != sizeof(T))
+        throw std::runtime_error("指针链文件指针大小不匹配");
+    if (header->module_count < 0 || header->level < 0)
+        throw std::runtime_error("指针链文件头损坏");
+    need((size_t)header->module_count * sizeof(*sym) + (size_t)header->level * sizeof(*llen));
 
     syms.assign(header->module_count, {});
     for (auto i = 0; i < header->module_count; ++i) {
+        need(sizeof(*sym));
         PARSE_ADDR_DATA(sym, addr);
+        if (sym->pointer_count < 0 || sym->level < 0 || sym->level > header->level || memchr(sym->name, 0, sizeof(sym->name)) == nullptr)
+            throw std::runtime_error("指针链文件模块信息损坏");
 
         syms[i].sym = sym;
         data = (decltype(data))addr;
+        need(sym->pointer_count * sizeof(*data));
 
         syms[i].data.set_data(data, sym->pointer_count);
         addr = (char *)(data + sym->pointer_count);
     }
 
+    std::vector<char> seen(header->level, 0);
     contents.assign(header->level, {});
     for (auto i = 0; i < header->level; ++i) {
+        need(sizeof(*llen));
         PARSE_ADDR_DATA(llen, addr);
+        if (llen->level < 0 || llen->level >= header->level || seen[llen->level])
+            throw std::runtime_error("指针链文件层信息损坏");
+        seen[llen->level] = 1;
 
         data = (decltype(data))addr;
+        need(llen->count * sizeof(*data));
         contents[llen->level].set_data(data, llen->count);
         addr = (char *)(data + llen->count);
     }
+
+    // 子节点索引不能超出下一层 (第0层为 [0, 1]) 与 v2 解码的检查一致 每个节点只读一遍
+    auto check = [&contents](const auto &nodes, int level) {
+        size_t limit = level > 0 ? contents[level - 1].size() : 1;
+        for (auto &node : nodes) {
+            if (node.start > node.end || node.end > limit)
+                throw std::runtime_error("指针链文件节点索引越界");
+        }
+    };
+    for (auto &sym : syms)
+        check(sym.data, sym.sym->level);
+    for (auto i = 0; i < header->level; ++i)
+        check(contents[i], i);
 }
 
 template <class T>
-chainer::cprog_chain_info<T> chainer::base<T>::parse_cprog_bin_data(FILE *f)
+chainer::cprog_chain_info<T> chainer::base<T>::parse_cprog_bin_data(FILE *f, chainer::cprog_access access)
 {
     int fd;
     struct stat st;
     chainer::cprog_chain_info<T> data;
 
     fd = fileno(f);
-    fstat(fd, &st);
+    if (fstat(fd, &st) != 0)
+        throw std::runtime_error("无法获取指针链文件大小");
     data.size = st.st_size;
     printf("data.size %ld fd %d\n", data.size, fd);
-  data.addr = (char *)mmap(nullptr, data.size, PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
-  if (data.addr == MAP_FAILED) {
-    throw std::runtime_error("指针链文件映射失败");
-  }
+    if (data.size < sizeof(cprog_header_v2))
+        throw std::runtime_error("文件过小或不是指针链二进制文件");
+
+    // 只读私有映射 读取方不会改写文件 也不需要可写打开
+    data.addr = (char *)mmap(nullptr, data.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data.addr == MAP_FAILED) {
+        data.addr = nullptr, data.size = 0;
+        throw std::runtime_error("指针链文件映射失败");
+    }
+
+    // v2 解码是一次顺序读 解码后的内存按 v101 解析 不再有缺页
+    bool packed = memcmp(data.addr, cprog_v2_magic, sizeof(cprog_v2_magic)) == 0;
+    madvise(data.addr, data.size, packed || access == CPROG_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+    if (packed)
+        unpack_cprog_v2(data);
     parse_cprog_bin_data(data);
+    if (packed)
+        return data;
+
+    // 各层在文件中是连续的 提前异步读入 避免转文本和对比时逐页缺页
+    size_t page = sysconf(_SC_PAGESIZE);
+    for (auto &layer : data.contents) {
+        if (layer.size() == 0)
+            continue;
+        auto begin = (uintptr_t)layer.begin() / page * page;
+        madvise((void *)begin, (uintptr_t)layer.end() - begin, MADV_WILLNEED);
+    }
     return data;
 }
 
+template <class T>
+size_t chainer::base<T>::cprog_index_offset(const char *addr, size_t size)
+{
+    cprog_index_tail tail;
+    if (size < sizeof(cprog_index_header) + sizeof(tail))
+        return size;
+
+    memcpy(&tail, addr + size - sizeof(tail), sizeof(tail));
+    if (memcmp(tail.magic, cprog_index_magic, sizeof(tail.magic)) != 0 || tail.offset > size - sizeof(cprog_index_header) - sizeof(tail))
+        return size;
+    if (memcmp(addr + tail.offset, cprog_index_magic, sizeof(cprog_index_magic)) != 0)
+        return size;
+    return tail.offset;
+}
+
+template <class T>
+void chainer::base<T>::unpack_cprog_v2(chainer::cprog_chain_info<T> &b_data)
+{
+    auto header = (cprog_header_v2 *)b_data.addr;
+    if (header->version != 2 || header->size != sizeof(T))
+        throw std::runtime_error("指针链文件版本或指针大小不匹配");
+
+    // 索引段不属于压缩块
+    auto raw = unpack_cprog_blocks(b_data.addr, cprog_index_offset(b_data.addr, b_data.size));
+    varint_reader in{raw.data(), raw.data() + raw.size()};
+
+    // 目录: 先得到每个模块和每层的节点数 才能确定 v101 布局的大小
+    uint64_t module_count = in.get(), level_count = in.get();
+    if (module_count > INT_MAX || level_count > INT_MAX)
+        throw std::runtime_error("指针链文件目录损坏");
+
+    std::vector<cprog_sym<T>> syms(module_count);
+    std::vector<uint64_t> counts(level_count);
+    uint64_t nodes = 0;
+    for (auto &sym : syms) {
+        memset(&sym, 0, sizeof(sym));
+        sym.start = (T)in.get();
+        size_t len = in.get();
+        memcpy(sym.name, in.take(len), std::min(len, sizeof(sym.name) - 1));
+        sym.range = (int)in.get_signed();
+        sym.count = (int)in.get_signed();
+        uint64_t level = in.get(), n = in.get();
+        if (level > level_count || n > INT_MAX)
+            throw std::runtime_error("指针链文件模块信息损坏");
+        sym.level = level;
+        sym.pointer_count = n;
+        nodes += n;
+    }
+    for (auto &n : counts) {
+        n = in.get();
+        if (n > UINT32_MAX)
+            throw std::runtime_error("指针链文件层节点数超出 v101 布局");
+        nodes += n;
+    }
+
+    // 每个节点至少 4 字节负载 防止损坏的计数导致巨大的分配
+    if (nodes > (uint64_t)(in.end - in.p) / 4 + 1)
+        throw std::runtime_error("指针链文件节点数与负载不符");
+
+    size_t size = sizeof(cprog_header) + module_count * sizeof(cprog_sym<T>) + level_count * sizeof(cprog_llen) + nodes * sizeof(cprog_data<T>);
+    auto image = (char *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (image == MAP_FAILED)
+        throw std::runtime_error("指针链文件解码内存不足");
+
+    // 之后出错时释放解码内存
+    struct guard {
+        char *addr;
+        size_t size;
+        ~guard() { if (addr != nullptr) munmap(addr, size); }
+    } hold{image, size};
+
+    auto out = image;
+    auto v101 = (cprog_header *)out;
+    strcpy(v101->sign, ".bin from chainer, by 青衫白衣\n");
+    v101->module_count = module_count;
+    v101->version = 101;
+    v101->size = sizeof(T);
+    v101->level = level_count;
+    out += sizeof(cprog_header);
+
+    // 节点: 地址和值是差分 start 相对上一节点的 end end = start + 长度 子节点索引不能超出下一层
+    auto read_nodes = [&in, &counts](cprog_data<T> *dat, uint64_t n, T address, int level) {
+        T value = 0;
+        int64_t end = 0;
+        uint64_t limit = level > 0 ? counts[level - 1] : 1;
+        for (uint64_t i = 0; i < n; ++i) {
+            address += (T)in.get_signed();
+            value += (T)in.get_signed();
+            int64_t start = end + in.get_signed();
+            uint64_t len = in.get();
+            if (start < 0 || len > limit || (uint64_t)start > limit - len)
+                throw std::runtime_error("指针链文件节点索引越界");
+            end = start + len;
+            dat[i] = cprog_data<T>(address, value, start, end);
+        }
+    };
+
+    for (auto &sym : syms) {
+        memcpy(out, &sym, sizeof(sym));
+        out += sizeof(sym);
+        read_nodes((cprog_data<T> *)out, sym.pointer_count, sym.start, sym.level);
+        out += sym.pointer_count * sizeof(cprog_data<T>);
+    }
+    for (uint64_t level = 0; level < level_count; ++level) {
+        auto llen = (cprog_llen *)out;
+        llen->module_count = 0;
+        llen->count = counts[level];
+        llen->level = level;
+        out += sizeof(cprog_llen);
+        read_nodes((cprog_data<T> *)out, counts[level], 0, level);
+        out += counts[level] * sizeof(cprog_data<T>);
+    }
+
+    // 解码结果与文件映射一样只读
+    mprotect(image, size, PROT_READ);
+
+    munmap(b_data.addr, b_data.size);
+    b_data.addr = image;
+    b_data.size = size;
+    hold.addr = nullptr;
+}
+
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "cbase.h"
+#include "ccursor.h"
+#include "cjoin.h"
+#include "cparse.h"
+#include "mapqueue.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <functional>
 #include <string>
@@ -58,11 +63,26 @@ struct bin_compare_result {
   std::vector<module_chain_diff<T>> modules;
 };
 
+// 两份 .bin 的交集统计
+struct bin_intersect_result {
+  size_t lhs_total = 0;
+  size_t rhs_total = 0;
+  size_t common = 0;   // 两份文件共有的链数 (按链计 不去重)
+  size_t nodes = 0;    // 交集子图各层的节点数 不含根节点
+  size_t modules = 0;  // 有共有链的模块数
+};
+
 template <class T>
 class ccompare : public base<T> {
  public:
   bin_compare_result<T> compare_bin_files(const std::string &lhs_path,
                                           const std::string &rhs_path);
+  // 两份 .bin 的指针树同步遍历 只生成共有链构成的子图 不展开链
+  // out 不为空时把子图写成新的 v101 .bin 失败时抛出 std::runtime_error
+  bin_intersect_result intersect_bin_files(const std::string &lhs_path,
+                                           const std::string &rhs_path,
+                                           FILE *out);
+  // 文本链文件按指纹在外存分区中对比 (txt_join) 内存里只保留共有链
   bin_compare_result<T> compare_txt_files(const std::string &lhs_path,
                                           const std::string &rhs_path);
 
@@ -78,28 +98,44 @@ class ccompare : public base<T> {
     }
   };
 
-  using chain_collection = std::vector<chain_signature<T>>;
   using chain_set =
       std::unordered_set<std::vector<T>, offsets_hash, std::equal_to<>>;
   using module_chain_map =
       std::unordered_map<chain_module_key, chain_set, chain_module_key_hash>;
 
-  chain_collection parse_file(const std::string &path);
-  chain_collection parse_txt_file(const std::string &path);
-  bool parse_txt_line(const std::string &line, chain_signature<T> &out);
+  // 交集子图 布局同 v101: 每个模块的根节点和每层的节点
+  struct intersection {
+    std::vector<cprog_sym<T>> syms;
+    std::vector<utils::mapqueue<cprog_data<T>>> roots;
+    std::vector<utils::mapqueue<cprog_data<T>>> layers;
+  };
+
+  // 两个节点的配对 delta 为两边父节点 value 之差
+  // 同一对父节点的子节点配对 delta 相同且按 lhs 递增
+  struct product_edge {
+    T delta;
+    uint32_t lhs;
+    uint32_t rhs;
+
+    bool operator<(const product_edge &other) const {
+      if (delta != other.delta) return delta < other.delta;
+      if (lhs != other.lhs) return lhs < other.lhs;
+      return rhs < other.rhs;
+    }
+    bool operator==(const product_edge &other) const {
+      return delta == other.delta && lhs == other.lhs && rhs == other.rhs;
+    }
+  };
+
+  cprog_chain_info<T> load_bin_file(const std::string &path);
+  size_t count_chains(const cprog_chain_info<T> &info);
+  void intersect(const cprog_chain_info<T> &lhs,
+                 const cprog_chain_info<T> &rhs, intersection &out);
+  void prune(intersection &out);
+  cprog_chain_info<T> view_of(intersection &out);
+  void write_bin(const intersection &out, FILE *f);
+  bool parse_txt_line(const char *p, size_t n, chain_signature<T> &out);
   void validate_bin_file(FILE *file, const std::string &path);
-  void collect_module_chains(const cprog_chain_info<T> &info,
-                             const cprog_sym_integr<T> &sym,
-                             chain_collection &out);
-  void collect_from_dir(const cprog_chain_info<T> &info,
-                        const cprog_data<T> &dir, int level,
-                        std::vector<T> &offsets,
-                        const chain_signature<T> &base,
-                        chain_collection &out);
-  module_chain_map build_chain_map(const chain_collection &chains);
-  void process_module_diff(const chain_module_key &key, const chain_set *lhs,
-                           const chain_set *rhs, bin_compare_result<T> &result,
-                           size_t &unchanged);
 };
 
 extern template class ccompare<uint32_t>;
@@ -2,10 +2,10 @@
 
 #include "ccompare.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <memory>
-#include <sstream>
 #include <stdexcept>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -13,20 +13,35 @@
 namespace chainer {
 
 template <class T>
-auto ccompare<T>::parse_file(const std::string &path) -> chain_collection {
-  std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path.c_str(), "rb+"),
+cprog_chain_info<T> ccompare<T>::load_bin_file(const std::string &path) {
+  std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path.c_str(), "rb"),
                                                 &fclose);
   if (!file) {
     throw std::runtime_error("无法打开指针链文件: " + path);
   }
   validate_bin_file(file.get(), path);
-  auto info = this->parse_cprog_bin_data(file.get());
+  // 数据已映射 返回后关闭文件不影响
+  return this->parse_cprog_bin_data(file.get());
+}
+
+template <class T>
+size_t ccompare<T>::count_chains(const cprog_chain_info<T> &info) {
+  std::vector<utils::mapqueue<uint64_t>> prefix;
+  std::vector<utils::varray<uint64_t>> levels;
+  build_chain_prefix(info, prefix, levels);
 
-  chain_collection chains;
+  // 顺带检查了每个节点的子节点区间 之后的遍历不再检查
+  uint64_t total = 0;
   for (auto &sym : info.syms) {
-    collect_module_chains(info, sym, chains);
+    utils::mapqueue<uint64_t> part;
+    int level = sym.sym->level;
+    if (!fill_chain_prefix<T>(part, sym.data.begin(), sym.data.size(), level,
+                              level > 0 ? &levels[level - 1] : nullptr)) {
+      throw std::runtime_error("指针链文件节点索引越界");
+    }
+    total += part.back();
   }
-  return chains;
+  return total;
 }
 
 template <class T>
@@ -39,6 +54,18 @@ void ccompare<T>::validate_bin_file(FILE *file, const std::string &path) {
     throw std::runtime_error("无法定位到文件开头: " + path);
   }
 
+  // v2 文件头较短 魔数和指针大小对上即可 其余由解码时检查
+  cprog_header_v2 v2 {};
+  if (fread(&v2, sizeof(v2), 1, file) == 1 &&
+      std::memcmp(v2.magic, cprog_v2_magic, sizeof(cprog_v2_magic)) == 0) {
+    if (v2.version != 2 || v2.size != sizeof(T)) {
+      throw std::runtime_error("指针链文件头字段非法: " + path);
+    }
+    rewind(file);
+    return;
+  }
+  rewind(file);
+
   cprog_header header {};
   if (fread(&header, sizeof(header), 1, file) != 1) {
     throw std::runtime_error("文件过小或不是指针链二进制文件: " + path);
@@ -72,255 +99,536 @@ void ccompare<T>::validate_bin_file(FILE *file, const std::string &path) {
 }
 
 template <class T>
-void ccompare<T>::collect_module_chains(const cprog_chain_info<T> &info,
-                                        const cprog_sym_integr<T> &sym,
-                                        chain_collection &out) {
-  if (sym.sym == nullptr || sym.data.size() == 0) {
-    return;
-  }
-
-  chain_signature<T> base;
-  base.module_name = sym.sym->name;
-  base.module_index = sym.sym->count;
-
-  std::vector<T> offsets;
-  offsets.reserve(sym.sym->level + 1);
-  for (size_t i = 0; i < sym.data.size(); ++i) {
-    const auto &dir = sym.data[i];
-    offsets.clear();
-    offsets.emplace_back(static_cast<T>(dir.address - sym.sym->start));
-    collect_from_dir(info, dir, sym.sym->level, offsets, base, out);
+bool ccompare<T>::parse_txt_line(const char *p, size_t n,
+                                 chain_signature<T> &out) {
+  txt_chain_head head;
+  out.offsets.clear();
+  if (!parse_chain_line<T>(p, p + n, head, out.offsets)) {
+    return false;
   }
+  out.module_name.assign(head.name, head.name_len);
+  out.module_index = head.count;
+  return true;
 }
 
 template <class T>
-void ccompare<T>::collect_from_dir(const cprog_chain_info<T> &info,
-                                   const cprog_data<T> &dir, int level,
-                                   std::vector<T> &offsets,
-                                   const chain_signature<T> &base,
-                                   chain_collection &out) {
-  if (level == 0) {
-    chain_signature<T> record;
-    record.module_name = base.module_name;
-    record.module_index = base.module_index;
-    record.offsets = offsets;
-    out.emplace_back(std::move(record));
-    return;
-  }
+void ccompare<T>::intersect(const cprog_chain_info<T> &lhs,
+                            const cprog_chain_info<T> &rhs,
+                            intersection &out) {
+  constexpr size_t avg = 10000;
+
+  // 两边的模块按 名称 序号 层数 配对 根节点按模块内偏移归并
+  auto sorted_roots = [](const cprog_sym_integr<T> &sym) {
+    std::vector<std::pair<long, uint32_t>> list(sym.data.size());
+    for (size_t i = 0; i < list.size(); ++i) {
+      list[i] = {signed_offset<T>(sym.data[i].address - sym.sym->start),
+                 static_cast<uint32_t>(i)};
+    }
+    std::sort(list.begin(), list.end());
+    return list;
+  };
+
+  std::vector<size_t> lhs_sym, rhs_sym;
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> root_pairs;
+  int top = 0;
+  for (size_t m = 0; m < lhs.syms.size(); ++m) {
+    auto &a = *lhs.syms[m].sym;
+    for (size_t n = 0; n < rhs.syms.size(); ++n) {
+      auto &b = *rhs.syms[n].sym;
+      if (a.count != b.count || a.level != b.level ||
+          std::strcmp(a.name, b.name) != 0) {
+        continue;
+      }
 
-  int target_level = level - 1;
-  if (target_level < 0 ||
-      static_cast<size_t>(target_level) >= info.contents.size()) {
-    return;
-  }
+      auto la = sorted_roots(lhs.syms[m]);
+      auto lb = sorted_roots(rhs.syms[n]);
+      std::vector<std::pair<uint32_t, uint32_t>> matched;
+      size_t i = 0, j = 0;
+      while (i < la.size() && j < lb.size()) {
+        if (la[i].first < lb[j].first) {
+          ++i;
+        } else if (lb[j].first < la[i].first) {
+          ++j;
+        } else {
+          long off = la[i].first;
+          size_t j0 = j;
+          for (; i < la.size() && la[i].first == off; ++i) {
+            for (j = j0; j < lb.size() && lb[j].first == off; ++j) {
+              matched.emplace_back(la[i].second, lb[j].second);
+            }
+          }
+        }
+      }
+      if (matched.empty()) {
+        continue;
+      }
 
-  auto &child_level = info.contents[target_level];
-  for (uint32_t idx = dir.start; idx < dir.end && idx < child_level.size();
-       ++idx) {
-    auto &child = child_level[idx];
-    offsets.emplace_back(static_cast<T>(child.address - dir.value));
-    collect_from_dir(info, child, target_level, offsets, base, out);
-    offsets.pop_back();
+      out.syms.emplace_back(a);
+      out.roots.emplace_back();
+      auto &roots = out.roots.back();
+      roots.resize(matched.size());
+      for (size_t k = 0; k < matched.size(); ++k) {
+        roots[k] = lhs.syms[m].data[matched[k].first];
+      }
+      lhs_sym.emplace_back(m);
+      rhs_sym.emplace_back(n);
+      root_pairs.emplace_back(std::move(matched));
+      top = std::max(top, a.level);
+    }
   }
-}
 
-template <class T>
-auto ccompare<T>::build_chain_map(const chain_collection &chains)
-    -> module_chain_map {
-  module_chain_map result;
-  for (const auto &chain : chains) {
-    chain_module_key key(chain.module_name, chain.module_index);
-    result[key].insert(chain.offsets);
+  // 自顶向下逐层生成配对: 第 c + 1 层的父节点配对 (根节点或上一步的配对)
+  // 两边子节点区间按到父节点的偏移归并 偏移相同的两个子节点配成第 c 层的一对
+  // 同一对节点可能经不同的路径到达 排序去重后共用 父节点的子节点在去重后的
+  // 数组中恰好连续时直接引用这一段 (层内地址不重复时总是连续)
+  // 否则在层末追加一份副本
+  struct parent {
+    const cprog_data<T> *lhs;
+    const cprog_data<T> *rhs;
+    cprog_data<T> *dst;
+  };
+
+  out.layers.resize(top);
+  utils::mapqueue<product_edge> upper;  // 第 c + 1 层去重后的配对
+  std::vector<uint32_t> pending;        // 第 c + 1 层的副本 对应 upper 中的下标
+
+  utils::task_group jobs;
+  for (int c = top - 1; c >= 0; --c) {
+    auto &la = lhs.contents[c];
+    auto &lb = rhs.contents[c];
+
+    utils::mapqueue<parent> parents;
+    for (size_t k = 0; k < out.syms.size(); ++k) {
+      if (out.syms[k].level != c + 1) {
+        continue;
+      }
+      auto &a = lhs.syms[lhs_sym[k]].data;
+      auto &b = rhs.syms[rhs_sym[k]].data;
+      for (size_t r = 0; r < root_pairs[k].size(); ++r) {
+        parents.emplace_back(parent{&a[root_pairs[k][r].first],
+                                    &b[root_pairs[k][r].second],
+                                    &out.roots[k][r]});
+      }
+    }
+    if (c + 1 < top) {
+      auto &layer = out.layers[c + 1];
+      for (size_t i = 0; i < upper.size(); ++i) {
+        parents.emplace_back(parent{&lhs.contents[c + 1][upper[i].lhs],
+                                    &rhs.contents[c + 1][upper[i].rhs],
+                                    &layer[i]});
+      }
+    }
+
+    // 两边的子节点区间都按地址有序 偏移相同的一段做笛卡尔积
+    auto join = [&](const parent &p, auto &&fn) {
+      T delta = p.lhs->value - p.rhs->value;
+      auto off_a = [&](uint32_t x) {
+        return signed_offset<T>(la[x].address - p.lhs->value);
+      };
+      auto off_b = [&](uint32_t x) {
+        return signed_offset<T>(lb[x].address - p.rhs->value);
+      };
+      uint32_t i = p.lhs->start, j = p.rhs->start;
+      while (i < p.lhs->end && j < p.rhs->end) {
+        long oa = off_a(i), ob = off_b(j);
+        if (oa < ob) {
+          ++i;
+        } else if (ob < oa) {
+          ++j;
+        } else {
+          uint32_t j0 = j;
+          for (; i < p.lhs->end && off_a(i) == oa; ++i) {
+            for (j = j0; j < p.rhs->end && off_b(j) == oa; ++j) {
+              fn(product_edge{delta, i, j});
+            }
+          }
+        }
+      }
+    };
+
+    // 按段并行生成配对 每段内排序去重
+    size_t n = parents.size();
+    utils::mapqueue<uint32_t> counts;
+    counts.resize(n, 0);
+    std::vector<size_t> bounds{0};
+    utils::split_num_to_avg(n, avg, [&](size_t len) {
+      bounds.emplace_back(bounds.back() + len);
+    });
+    std::vector<std::vector<product_edge>> parts(bounds.size() - 1);
+
+    auto generate = [&](size_t part) {
+      auto &local = parts[part];
+      for (size_t x = bounds[part]; x < bounds[part + 1]; ++x) {
+        size_t before = local.size();
+        join(parents[x], [&](const product_edge &e) { local.emplace_back(e); });
+        counts[x] = local.size() - before;
+      }
+      std::sort(local.begin(), local.end());
+      local.erase(std::unique(local.begin(), local.end()), local.end());
+    };
+    for (size_t part = 0; part < parts.size(); ++part) {
+      utils::thread_pool->post(jobs, generate, part);
+    }
+    utils::thread_pool->wait(jobs);
+
+    // 各段拷贝到一起 两两归并直到只剩一段 再去掉段间的重复
+    utils::mapqueue<product_edge> edges;
+    std::vector<size_t> runs{0};
+    for (auto &local : parts) {
+      runs.emplace_back(runs.back() + local.size());
+    }
+    edges.resize(runs.back());
+    auto gather = [&](size_t part) {
+      std::copy(parts[part].begin(), parts[part].end(),
+                edges.begin() + runs[part]);
+      std::vector<product_edge>().swap(parts[part]);
+    };
+    for (size_t part = 0; part < parts.size(); ++part) {
+      utils::thread_pool->post(jobs, gather, part);
+    }
+    utils::thread_pool->wait(jobs);
+
+    auto merge = [&](size_t first, size_t middle, size_t last) {
+      std::inplace_merge(edges.begin() + first, edges.begin() + middle,
+                         edges.begin() + last);
+    };
+    while (runs.size() > 2) {
+      std::vector<size_t> next{0};
+      for (size_t r = 0; r + 1 < runs.size(); r += 2) {
+        if (r + 2 < runs.size()) {
+          utils::thread_pool->post(jobs, merge, runs[r], runs[r + 1], runs[r + 2]);
+          next.emplace_back(runs[r + 2]);
+        } else {
+          next.emplace_back(runs[r + 1]);
+        }
+      }
+      utils::thread_pool->wait(jobs);
+      runs.swap(next);
+    }
+    edges.resize(std::unique(edges.begin(), edges.end()) - edges.begin());
+
+    // 按段并行定位每个父节点的子节点 不连续的留给下面追加副本
+    std::vector<std::vector<size_t>> scattered(parts.size());
+    auto place = [&](size_t part) {
+      for (size_t x = bounds[part]; x < bounds[part + 1]; ++x) {
+        auto &p = parents[x];
+        size_t count = counts[x];
+        if (count == 0) {
+          p.dst->start = p.dst->end = 0;
+          continue;
+        }
+        T delta = p.lhs->value - p.rhs->value;
+        size_t f = std::lower_bound(edges.begin(), edges.end(),
+                                    product_edge{delta, p.lhs->start, 0}) -
+                   edges.begin();
+        bool whole = f + count <= edges.size();
+        for (size_t y = f; whole && y < f + count; ++y) {
+          auto &e = edges[y];
+          whole = e.delta == delta && e.lhs < p.lhs->end &&
+                  e.rhs >= p.rhs->start && e.rhs < p.rhs->end;
+        }
+        if (whole) {
+          p.dst->start = f;
+          p.dst->end = f + count;
+        } else {
+          scattered[part].emplace_back(x);
+        }
+      }
+    };
+    for (size_t part = 0; part < parts.size(); ++part) {
+      utils::thread_pool->post(jobs, place, part);
+    }
+    utils::thread_pool->wait(jobs);
+
+    std::vector<uint32_t> copies;
+    for (auto &list : scattered) {
+      for (auto x : list) {
+        auto &p = parents[x];
+        size_t first = edges.size() + copies.size();
+        join(p, [&](const product_edge &e) {
+          copies.emplace_back(
+              std::lower_bound(edges.begin(), edges.end(), e) - edges.begin());
+        });
+        p.dst->start = first;
+        p.dst->end = edges.size() + copies.size();
+      }
+    }
+    if (edges.size() + copies.size() > UINT32_MAX) {
+      throw std::runtime_error("交集节点数超出范围");
+    }
+
+    // 第 c + 1 层的区间已确定 补上它的副本
+    if (c + 1 < top) {
+      auto &layer = out.layers[c + 1];
+      for (size_t i = 0; i < pending.size(); ++i) {
+        layer[upper.size() + i] = layer[pending[i]];
+      }
+    }
+
+    // 第 c 层的节点取 lhs 的地址和值 区间在下一步确定 第0层没有子节点
+    auto &layer = out.layers[c];
+    layer.resize(edges.size() + copies.size());
+    auto fill = [&](size_t start, size_t len) {
+      for (auto i = start; i < start + len; ++i) {
+        layer[i] = la[edges[i].lhs];
+      }
+    };
+    size_t index = 0;
+    utils::split_num_to_avg(edges.size(), avg, [&](size_t len) {
+      utils::thread_pool->post(jobs, fill, index, len);
+      index += len;
+    });
+    utils::thread_pool->wait(jobs);
+
+    if (c == 0) {
+      for (size_t i = 0; i < copies.size(); ++i) {
+        layer[edges.size() + i] = layer[copies[i]];
+      }
+    }
+    upper.swap(edges);
+    pending.swap(copies);
   }
-  return result;
+
+  prune(out);
 }
 
 template <class T>
-bool ccompare<T>::parse_txt_line(const std::string &line,
-                                 chain_signature<T> &out) {
-  std::string s = line;
-  // 去掉首尾空白
-  auto not_space = [](int ch) { return !std::isspace(ch); };
-  s.erase(s.begin(), std::find_if(s.begin(), s.end(), not_space));
-  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
-    s.pop_back();
-  }
-  if (s.empty()) {
-    return false;
-  }
-  // 期望格式: module[index] + 0xOFFSET -> + 0xOFFSET...
-  auto left_bracket = s.find('[');
-  auto right_bracket = s.find(']', left_bracket == std::string::npos
-                                         ? std::string::npos
-                                         : left_bracket + 1);
-  if (left_bracket == std::string::npos || right_bracket == std::string::npos ||
-      right_bracket <= left_bracket) {
-    return false;
+void ccompare<T>::prune(intersection &out) {
+  int top = out.layers.size();
+
+  // 按新下标改写子节点区间 区间为空时返回 false
+  auto remap = [](cprog_data<T> &node, const utils::mapqueue<uint32_t> &rank) {
+    node.start = rank[node.start];
+    node.end = rank[node.end];
+    return node.end > node.start;
+  };
+
+  // 只保留 keep 为真的节点 rank[i] 为节点 i 之前保留的节点数
+  auto compact = [](utils::mapqueue<cprog_data<T>> &nodes,
+                    utils::mapqueue<uint32_t> &rank, auto &&keep) {
+    size_t n = 0;
+    rank.clear();
+    rank.resize(nodes.size() + 1, 0);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      rank[i] = n;
+      if (keep(i)) {
+        nodes[n++] = nodes[i];
+      }
+    }
+    rank[nodes.size()] = n;
+    nodes.resize(n);
+  };
+
+  // 自底向上: 子节点全被剪掉的节点之下没有共有链
+  utils::mapqueue<uint32_t> lower, rank, unused;
+  for (int c = 0; c < top; ++c) {
+    auto &layer = out.layers[c];
+    compact(layer, rank,
+            [&](size_t i) { return c == 0 || remap(layer[i], lower); });
+    for (size_t k = 0; k < out.syms.size(); ++k) {
+      if (out.syms[k].level == c + 1) {
+        auto &roots = out.roots[k];
+        compact(roots, unused, [&](size_t i) { return remap(roots[i], rank); });
+      }
+    }
+    lower.swap(rank);
   }
 
-  out.module_name = s.substr(0, left_bracket);
-
-  std::string index_str =
-      s.substr(left_bracket + 1, right_bracket - left_bracket - 1);
-  try {
-    out.module_index = std::stoi(index_str);
-  } catch (...) {
-    return false;
+  size_t m = 0;
+  top = 0;
+  for (size_t k = 0; k < out.syms.size(); ++k) {
+    if (out.roots[k].size() == 0) {
+      continue;
+    }
+    out.syms[k].pointer_count = out.roots[k].size();
+    top = std::max(top, out.syms[k].level);
+    out.syms[m] = out.syms[k];
+    out.roots[m].swap(out.roots[k]);
+    ++m;
   }
-
-  out.offsets.clear();
-
-  std::string rest = s.substr(right_bracket + 1);
-  std::size_t pos = 0;
-  while (true) {
-    auto plus_pos = rest.find("+ 0x", pos);
-    if (plus_pos == std::string::npos) {
-      break;
+  out.syms.resize(m);
+  out.roots.resize(m);
+  out.layers.resize(top);
+
+  // 自顶向下: 只被副本的来源或剪掉的节点引用的节点已不可达
+  utils::mapqueue<uint32_t> cover;
+  for (int c = top - 1; c >= 0; --c) {
+    auto &layer = out.layers[c];
+    cover.clear();
+    cover.resize(layer.size() + 1, 0);
+    auto mark = [&](const cprog_data<T> &node) {
+      ++cover[node.start];
+      --cover[node.end];
+    };
+    for (size_t k = 0; k < out.syms.size(); ++k) {
+      if (out.syms[k].level == c + 1) {
+        for (auto &root : out.roots[k]) {
+          mark(root);
+        }
+      }
     }
-    plus_pos += 4;  // 跳过 "+ 0x"
-    std::size_t end_pos = plus_pos;
-    while (end_pos < rest.size() &&
-           std::isxdigit(static_cast<unsigned char>(rest[end_pos]))) {
-      ++end_pos;
+    if (c + 1 < top) {
+      for (auto &node : out.layers[c + 1]) {
+        mark(node);
+      }
     }
-    if (end_pos == plus_pos) {
-      break;
+
+    uint32_t depth = 0;
+    compact(layer, rank, [&](size_t i) { return (depth += cover[i]) != 0; });
+    for (size_t k = 0; k < out.syms.size(); ++k) {
+      if (out.syms[k].level == c + 1) {
+        for (auto &root : out.roots[k]) {
+          remap(root, rank);
+        }
+      }
     }
-    std::string hex_str = rest.substr(plus_pos, end_pos - plus_pos);
-    std::istringstream iss(hex_str);
-    std::size_t value = 0;
-    iss >> std::hex >> value;
-    if (!iss.fail()) {
-      out.offsets.emplace_back(static_cast<T>(value));
+    if (c + 1 < top) {
+      for (auto &node : out.layers[c + 1]) {
+        remap(node, rank);
+      }
     }
-    pos = end_pos;
   }
+}
 
-  return !out.offsets.empty();
+template <class T>
+cprog_chain_info<T> ccompare<T>::view_of(intersection &out) {
+  std::vector<cprog_sym_integr<T>> syms;
+  std::vector<utils::varray<cprog_data<T>>> contents;
+  for (size_t k = 0; k < out.syms.size(); ++k) {
+    utils::varray<cprog_data<T>> data;
+    data.set_data(out.roots[k].begin(), out.roots[k].size());
+    syms.emplace_back(&out.syms[k], std::move(data));
+  }
+  for (auto &layer : out.layers) {
+    contents.emplace_back();
+    contents.back().set_data(layer.begin(), layer.size());
+  }
+  return cprog_chain_info<T>(std::move(syms), std::move(contents));
 }
 
 template <class T>
-auto ccompare<T>::parse_txt_file(const std::string &path) -> chain_collection {
-  std::ifstream in(path);
-  if (!in) {
-    throw std::runtime_error("无法打开指针链文本文件: " + path);
+void ccompare<T>::write_bin(const intersection &out, FILE *f) {
+  cprog_header header {};
+  header.size = sizeof(T);
+  header.version = 101;
+  header.module_count = out.syms.size();
+  header.level = out.layers.size();
+  std::strcpy(header.sign, ".bin from chainer, by 青衫白衣\n");
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+  for (size_t k = 0; ok && k < out.syms.size(); ++k) {
+    auto &roots = out.roots[k];
+    ok = fwrite(&out.syms[k], sizeof(out.syms[k]), 1, f) == 1 &&
+         fwrite(roots.begin(), sizeof(*roots.begin()), roots.size(), f) ==
+             roots.size();
   }
 
-  chain_collection result;
-  std::string line;
-  chain_signature<T> sig;
-  while (std::getline(in, line)) {
-    if (parse_txt_line(line, sig)) {
-      result.emplace_back(sig);
-    }
+  for (size_t c = 0; ok && c < out.layers.size(); ++c) {
+    auto &layer = out.layers[c];
+    cprog_llen llen {};
+    llen.level = c;
+    llen.count = layer.size();
+    ok = fwrite(&llen, sizeof(llen), 1, f) == 1 &&
+         fwrite(layer.begin(), sizeof(*layer.begin()), layer.size(), f) ==
+             layer.size();
+  }
+
+  if (!ok || fflush(f) != 0) {
+    throw std::runtime_error("写入交集指针链文件失败");
   }
-  return result;
 }
 
 template <class T>
-void ccompare<T>::process_module_diff(const chain_module_key &key,
-                                      const chain_set *lhs, const chain_set *rhs,
-                                      bin_compare_result<T> &result,
-                                      size_t &unchanged) {
-  module_chain_diff<T> diff;
-  diff.module_name = key.name;
-  diff.module_index = key.index;
-
-  if (lhs != nullptr && rhs != nullptr) {
-    for (const auto &chain : *lhs) {
-      if (rhs->find(chain) != rhs->end()) {
-        diff.common.emplace_back(chain);
-        ++unchanged;
-      }
-    }
+bin_intersect_result ccompare<T>::intersect_bin_files(
+    const std::string &lhs_path, const std::string &rhs_path, FILE *out) {
+  auto lhs = load_bin_file(lhs_path);
+  auto rhs = load_bin_file(rhs_path);
+
+  bin_intersect_result result;
+  result.lhs_total = count_chains(lhs);
+  result.rhs_total = count_chains(rhs);
+
+  intersection common;
+  intersect(lhs, rhs, common);
+  result.common = count_chains(view_of(common));
+  result.modules = common.syms.size();
+  for (auto &layer : common.layers) {
+    result.nodes += layer.size();
   }
 
-  if (!diff.common.empty()) {
-    result.modules.emplace_back(std::move(diff));
+  if (out != nullptr) {
+    write_bin(common, out);
   }
+  return result;
 }
 
 template <class T>
 bin_compare_result<T> ccompare<T>::compare_bin_files(const std::string &lhs_path,
                                                      const std::string &rhs_path) {
-  auto lhs_chains = parse_file(lhs_path);
-  auto rhs_chains = parse_file(rhs_path);
+  auto lhs = load_bin_file(lhs_path);
+  auto rhs = load_bin_file(rhs_path);
 
   bin_compare_result<T> result;
-  result.lhs_total = lhs_chains.size();
-  result.rhs_total = rhs_chains.size();
-
-  auto lhs_map = build_chain_map(lhs_chains);
-  auto rhs_map = build_chain_map(rhs_chains);
-
-  size_t unchanged = 0;
-  std::unordered_set<chain_module_key, chain_module_key_hash> visited;
-  visited.reserve(lhs_map.size());
-
-  for (auto &entry : lhs_map) {
-    const auto &key = entry.first;
-    visited.insert(key);
-
-    const chain_set *rhs_set = nullptr;
-    auto rhs_it = rhs_map.find(key);
-    if (rhs_it != rhs_map.end()) {
-      rhs_set = &rhs_it->second;
+  result.lhs_total = count_chains(lhs);
+  result.rhs_total = count_chains(rhs);
+
+  // 交集子图里只有共有链 只需展开这些链并按模块去重
+  intersection common;
+  intersect(lhs, rhs, common);
+  auto info = view_of(common);
+
+  module_chain_map map;
+  chain_set *current = nullptr;
+  size_t module = SIZE_MAX;
+  chain_cursor<T> cursor(info);
+  for (auto &view : cursor) {
+    if (view.module != module) {
+      module = view.module;
+      auto sym = info.syms[module].sym;
+      current = &map[chain_module_key(sym->name, sym->count)];
     }
-
-    process_module_diff(key, &entry.second, rhs_set, result, unchanged);
+    current->emplace(view.offsets, view.offsets + view.size);
   }
 
-  for (auto &entry : rhs_map) {
-    if (visited.find(entry.first) != visited.end()) {
-      continue;
-    }
-
-    process_module_diff(entry.first, nullptr, &entry.second, result, unchanged);
+  for (auto &entry : map) {
+    module_chain_diff<T> diff;
+    diff.module_name = entry.first.name;
+    diff.module_index = entry.first.index;
+    diff.common.assign(entry.second.begin(), entry.second.end());
+    result.unchanged += diff.common.size();
+    result.modules.emplace_back(std::move(diff));
   }
-
-  result.unchanged = unchanged;
   return result;
 }
 
 template <class T>
 bin_compare_result<T> ccompare<T>::compare_txt_files(const std::string &lhs_path,
                                                      const std::string &rhs_path) {
-  auto lhs_chains = parse_txt_file(lhs_path);
-  auto rhs_chains = parse_txt_file(rhs_path);
+  txt_join join;
+  auto st = join.run(lhs_path, rhs_path);
 
   bin_compare_result<T> result;
-  result.lhs_total = lhs_chains.size();
-  result.rhs_total = rhs_chains.size();
-
-  auto lhs_map = build_chain_map(lhs_chains);
-  auto rhs_map = build_chain_map(rhs_chains);
-
-  size_t unchanged = 0;
-  std::unordered_set<chain_module_key, chain_module_key_hash> visited;
-  visited.reserve(lhs_map.size());
+  result.lhs_total = st.lines[0];
+  result.rhs_total = st.lines[1];
 
-  for (auto &entry : lhs_map) {
-    const auto &key = entry.first;
-    visited.insert(key);
-
-    const chain_set *rhs_set = nullptr;
-    auto rhs_it = rhs_map.find(key);
-    if (rhs_it != rhs_map.end()) {
-      rhs_set = &rhs_it->second;
+  // 共有链已按规范形式去重 按模块归组即可
+  std::unordered_map<chain_module_key, size_t, chain_module_key_hash> modules;
+  chain_signature<T> sig;
+  join.emit(TXT_JOIN_COMMON, [&](const char *p, size_t n) {
+    if (!parse_txt_line(p, n, sig)) {
+      return;
     }
-
-    process_module_diff(key, &entry.second, rhs_set, result, unchanged);
-  }
-
-  for (auto &entry : rhs_map) {
-    if (visited.find(entry.first) != visited.end()) {
-      continue;
+    chain_module_key key(sig.module_name, sig.module_index);
+    auto it = modules.find(key);
+    if (it == modules.end()) {
+      it = modules.emplace(key, result.modules.size()).first;
+      result.modules.emplace_back();
+      result.modules.back().module_name = key.name;
+      result.modules.back().module_index = key.index;
     }
-
-    process_module_diff(entry.first, nullptr, &entry.second, result, unchanged);
-  }
-
-  result.unchanged = unchanged;
+    result.modules[it->second].common.emplace_back(std::move(sig.offsets));
+    ++result.unchanged;
+  });
   return result;
 }
 
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+namespace chainer
+{
+
+//扫描进度
+struct scan_progress {
+    int level;          //当前层数 -1 为读取内存阶段
+    int depth;          //最大深度
+    size_t bytes;       //已读取内存字节
+    size_t total_bytes; //需读取内存字节
+    size_t pointers;    //读取阶段为已发现指针数 搜索阶段为当前层指针数
+    double elapsed;     //已耗时 秒
+    double eta;         //预计剩余 秒 小于0为未知
+};
+
+//扫描控制 search/scan/format 的工作循环协作检查
+//cancel 可在其他线程或信号处理函数中调用 扫描尽快停止 放弃未完成的结果
+//超出时间预算时停止加深 只输出已完成层的结果
+class scan_control
+{
+private:
+    std::atomic<bool> cancel_flag;
+    std::atomic<long> begin_us;
+    std::atomic<long> read_begin_us;
+    std::atomic<long> last_report_us;
+    double budget;   //秒 0为不限制
+    double interval; //进度回调最小间隔 秒
+
+    static long now_us();
+
+public:
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> total_bytes;
+    std::atomic<size_t> pointers;
+
+    //进度回调 读取阶段在工作线程中调用 同一时刻只有一个线程进入
+    std::function<void(const scan_progress &)> progress;
+
+    scan_control();
+
+    void start(); //重新计时 清除取消标志和计数
+
+    void set_budget(double seconds);
+
+    void set_interval(double seconds);
+
+    void cancel();
+
+    bool cancelled() const;
+
+    bool expired() const;
+
+    bool stopped() const; //cancelled || expired 工作循环使用
+
+    double elapsed() const;
+
+    double remaining() const; //剩余预算 秒 不限制时小于0
+
+    void begin_read(size_t total);
+
+    void add_read(size_t len, size_t count);
+
+    void report_level(int level, int depth, size_t count, double eta);
+};
+
+} // namespace chainer
+
+inline long chainer::scan_control::now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+inline chainer::scan_control::scan_control() : cancel_flag(false), begin_us(now_us()), read_begin_us(now_us()), last_report_us(0), budget(0), interval(0.5), bytes(0), total_bytes(0), pointers(0)
+{
+}
+
+inline void chainer::scan_control::start()
+{
+    cancel_flag = false;
+    begin_us = read_begin_us = now_us();
+    last_report_us = 0;
+    bytes = total_bytes = pointers = 0;
+}
+
+inline void chainer::scan_control::set_budget(double seconds)
+{
+    budget = seconds;
+}
+
+inline void chainer::scan_control::set_interval(double seconds)
+{
+    interval = seconds;
+}
+
+inline void chainer::scan_control::cancel()
+{
+    cancel_flag.store(true, std::memory_order_relaxed);
+}
+
+inline bool chainer::scan_control::cancelled() const
+{
+    return cancel_flag.load(std::memory_order_relaxed);
+}
+
+inline bool chainer::scan_control::expired() const
+{
+    return budget > 0 && elapsed() > budget;
+}
+
+inline bool chainer::scan_control::stopped() const
+{
+    return cancelled() || expired();
+}
+
+inline double chainer::scan_control::elapsed() const
+{
+    return (now_us() - begin_us.load(std::memory_order_relaxed)) / 1000000.0;
+}
+
+inline double chainer::scan_control::remaining() const
+{
+    return budget > 0 ? std::max(budget - elapsed(), 0.0) : -1.0;
+}
+
+inline void chainer::scan_control::begin_read(size_t total)
+{
+    read_begin_us = now_us();
+    bytes = pointers = 0;
+    total_bytes = total;
+}
+
+inline void chainer::scan_control::add_read(size_t len, size_t count)
+{
+    size_t done = bytes.fetch_add(len, std::memory_order_relaxed) + len;
+    size_t found = pointers.fetch_add(count, std::memory_order_relaxed) + count;
+
+    if (!progress)
+        return;
+
+    // 限制回调频率 抢到时间片的线程负责回调
+    long now = now_us();
+    long last = last_report_us.load(std::memory_order_relaxed);
+    if (now - last < interval * 1000000 || !last_report_us.compare_exchange_strong(last, now))
+        return;
+
+    double spent = (now - read_begin_us.load(std::memory_order_relaxed)) / 1000000.0;
+    size_t total = total_bytes.load(std::memory_order_relaxed);
+
+    scan_progress p;
+    p.level = -1;
+    p.depth = 0;
+    p.bytes = done;
+    p.total_bytes = total;
+    p.pointers = found;
+    p.elapsed = elapsed();
+    p.eta = done > 0 && total >= done ? spent * (total - done) / done : -1.0;
+    progress(p);
+}
+
+inline void chainer::scan_control::report_level(int level, int depth, size_t count, double eta)
+{
+    last_report_us = now_us();
+    if (!progress)
+        return;
+
+    scan_progress p;
+    p.level = level;
+    p.depth = depth;
+    p.bytes = bytes.load(std::memory_order_relaxed);
+    p.total_bytes = total_bytes.load(std::memory_order_relaxed);
+    p.pointers = count;
+    p.elapsed = elapsed();
+    p.eta = eta;
+    progress(p);
+}
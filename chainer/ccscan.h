@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cscan.h"
+#include "cdfs.h"
 
 namespace chainer
 {
@@ -20,13 +21,64 @@ struct cscan : public ::chainer::scan<T>
     size_t scan_pointer_chain_to_txt(std::vector<T> &addr, int depth,
       size_t offset, bool limit, size_t plim, FILE *outstream);
     //将指针链转为文本格式输出到outstream中
+
+    //深度优先扫描 不保存按层数据 内存占用 O(depth * threads) 链找到即以文本写出
+    //limit为链数上限 0为不限制
+    size_t scan_pointer_chain_dfs(std::vector<T> &addr, int depth, size_t offset,
+      size_t limit, FILE *outstream);
+
+    //多目标扫描后每个目标(按 addr 中的序号)的链数 文本输出行尾的 " #id" 即此序号
+    //addr 只有一个目标时不输出编号
+    const std::vector<size_t> &get_target_counts() const;
+
+    //目标负向余量 结构体基址未知时 addr[i] 作为区间 [addr[i] - slack[i], addr[i]]
+    //链最后一跳输出到 addr[i] 的偏移 slack 只有一个元素时用于全部目标 传空为精确地址
+    void set_target_slack(const std::vector<T> &slack);
+
+    //按层偏移规则 rules[i] 用于第 i + 1 层 (从目标数起第 i + 1 跳) 超出的层用最后一条
+    //可设不同的最大偏移 负偏移下限 对齐和已知偏移白名单 在搜索和建立索引时直接裁剪
+    //区间目标的第1跳只用最大偏移 传空恢复为扫描参数 offset
+    void set_offset_rules(const std::vector<offset_rule> &rules);
+
+    //环路处理 自引用结构 (链表 父指针 侵入式容器) 会让同一节点出现在很多层 产生大量 A -> B -> A 的链
+    //CYCLE_SHORTEST: 每个指针只保留在离目标最近的层 搜索时直接截断 .bin 和文本输出都适用
+    //CYCLE_ACYCLIC: 文本输出时逐链去掉重复经过同一地址的链 以及同一起点存在真后缀 (更短) 链的链
+    //  .bin 输出时退化为 CYCLE_SHORTEST 深度优先扫描两种模式都按 CYCLE_ACYCLIC 处理
+    void set_cycle_mode(cycle_mode mode);
+
+    //束搜索模式 每层最多保留 policy.width 个节点 每个模块最多输出 policy.topk 条链
+    void set_beam_policy(const beam_policy<T> &policy);
+
+    //途经地址约束 只输出经过 addr ± tol 的链 (节点地址或指向的值) addr 为0关闭
+    //在第一次出现途经地址的层只保留命中节点 之后只从这些节点继续向上搜索
+    void set_waypoint(T addr, T tol);
+
+    //起点模块 只输出从该模块出发的链 name 或 name[count] 传空关闭
+    //先从模块沿指针表正向扩展 depth/2 层 反向搜索在后 depth/2 层只保留正向可达的指针
+    void set_root_module(const char *name);
+
+    //.bin 输出格式 101 为旧格式 (默认) 2 为差分变长整数加块压缩的新格式 两种都能被 cformat 等读取
+    //2 的文件小得多 但读取时要解码出完整的 101 布局 内存占用为压缩映射加完整解码
+    void set_bin_version(int version);
+
+    //.bin 之后追加链索引段 (默认开启) 供 cstore 按链号随机读取 没有索引的文件由 cstore 在内存中重建
+    void set_bin_index(bool enable);
+
+    //设置扫描目录 每完成一层即落盘 目标相同时从最后完成的层继续 depth 更大时在已有层上加深
+    //续扫使用目录中的指针快照 不依赖目标进程仍存活 传空关闭
+    void set_scan_dir(const char *dir);
+
     cscan();
 
     ~cscan();
+
+private:
+    size_t scan_pointer_chain_impl(std::vector<T> &addr, int depth, size_t offset,
+        bool limit, size_t plim, FILE *outstream, bool txt);
 };
 
 //显式实例化
 extern template class chainer::cscan<uint32_t>;//32位
 extern template class chainer::cscan<size_t>;//64位
 
-} // namespace chainer
\ No newline at end of file
+} // namespace chainer
@@ -13,109 +13,98 @@ template <class T>
 size_t chainer::cscan<T>::scan_pointer_chain(std::vector<T> &addr, int depth,
      size_t offset, bool limit, size_t plim, FILE *outstream)
 {
-    if (addr.empty()) {
-        return 0;
-    }
+    return scan_pointer_chain_impl(addr, depth, offset, limit, plim, outstream, false);
+}
 
-    // 初始化
+template <class T>
+size_t chainer::cscan<T>::scan_pointer_chain_to_txt(std::vector<T> &addr, int depth,
+     size_t offset, bool limit, size_t plim, FILE *outstream)
+{
+    return scan_pointer_chain_impl(addr, depth, offset, limit, plim, outstream, true);
+}
+
+template <class T>
+size_t chainer::cscan<T>::scan_pointer_chain_dfs(std::vector<T> &addr, int depth,
+     size_t offset, size_t limit, FILE *outstream)
+{
     utils::timer ptimer;
     ptimer.start();
-    
-    std::vector<chainer::pointer_range<T>> ranges;
-    std::vector<utils::mapqueue<pointer_dir<T>>> dirs(depth + 1);
-    size_t first_range_idx = 0;
-    size_t total_count = 0;
-
-    // 阶段 1: 多级指针链扫描
-    for (int level = 0; level <= depth; ++level) {
-        std::vector<pointer_data<T> *> curr;
-        printf("\n当前层数: %d\n", level);
-
-        if (level > 0) {
-            // 在全局指针数据中搜索上一层的指针
-            this->search_pointer(dirs[level - 1], curr, offset, limit, plim);
-            printf("%d: 搜索 %ld 指针\n", level, curr.size());
 
-            if (curr.empty()) {
-                break;
-            }
+    chainer::dfs<T> engine(this->pcoll, this->control);
+    engine.set_target_slack(this->target_slack);
+    engine.set_offset_rules(this->offset_rules);
+    engine.set_cycle_mode(this->cycles);
+    size_t total_count = engine.scan_pointer_chain(addr, depth, offset, limit, outstream);
+    engine.get_target_counts(this->target_counts);
 
-            // 过滤指针范围：找到的加入 ranges，找不到的加入 dirs[level]
-            this->filter_pointer_ranges(dirs, ranges, curr, level);
-            
-            // 创建索引：对 dirs[level] 中的指针建立到上一层的索引
-            // dirs 的每一层都是按地址排序的
-            this->create_assoc_dir_index(dirs[level - 1], dirs[level], offset, 10000);
-            continue;
-        }
+    printf("\n深度优先扫描完成, 总计耗时: %fs\n", ptimer.get() / 1000000.0);
+    return total_count;
+}
 
-        // Level 0: 转换地址为指针数据
-        this->trans_addr_to_pointer_data(addr, curr);
-        std::sort(curr.begin(), curr.end(), 
-                 [](auto x, auto y) { return x->address < y->address; });
-        
-        // 获取静态区域中目标 address 范围的指针数据
-        // 找不到的加入 dirs[level]，找到的加入 ranges
-        this->filter_pointer_ranges(dirs, ranges, curr, level);
-        first_range_idx = ranges.size();
-        
-        // 清理临时数据
-        utils::free_container_data(curr);
-    }
+template <class T>
+const std::vector<size_t> &chainer::cscan<T>::get_target_counts() const
+{
+    return this->target_counts;
+}
 
-    // 阶段 2: 补充静态模块到前一层的索引
-    for (; first_range_idx < ranges.size(); ++first_range_idx) {
-        this->create_assoc_dir_index(
-            dirs[ranges[first_range_idx].level - 1],
-            ranges[first_range_idx].results,
-            offset,
-            10000
-        );
-    }
+template <class T>
+void chainer::cscan<T>::set_target_slack(const std::vector<T> &slack)
+{
+    this->target_slack = slack;
+}
 
-    // 等待所有线程完成
-    utils::thread_pool->wait();
-    
-    if (ranges.empty()) {
-        return total_count;
-    }
+template <class T>
+void chainer::cscan<T>::set_offset_rules(const std::vector<offset_rule> &rules)
+{
+    this->offset_rules = rules;
+}
 
-    printf("\n搜索和关联完成, 耗时: %fs, 启用指针过滤\n",
-           ptimer.get() / 1000000.0);
+template <class T>
+void chainer::cscan<T>::set_cycle_mode(cycle_mode mode)
+{
+    this->cycles = mode;
+}
 
-    // 阶段 3: 构建指针目录树
-    auto [counts, contents] = this->build_pointer_dirs_tree(dirs, ranges);
-    if (counts.empty() || contents.empty()) {
-        return total_count;
-    }
+template <class T>
+void chainer::cscan<T>::set_beam_policy(const beam_policy<T> &policy)
+{
+    this->beam = policy;
+}
 
-    // 阶段 4: 统计每个模块的指针链数量
-    for (auto &r : ranges) {
-        size_t module_count = 0;
-        auto &level_count = counts[r.level];
-        
-        for (auto &v : r.results) {
-            module_count += level_count[v.end] - level_count[v.start];
-        }
+template <class T>
+void chainer::cscan<T>::set_waypoint(T addr, T tol)
+{
+    this->waypoint = addr;
+    this->waypoint_tolerance = tol;
+}
 
-        total_count += module_count;
-        printf("发现 %lu 锁链 %d %s[%d]\n",
-               module_count, r.level, r.vma->name, r.vma->count);
-    }
+template <class T>
+void chainer::cscan<T>::set_root_module(const char *name)
+{
+    this->root_module = name == nullptr ? "" : name;
+}
 
-    // 阶段 5: 输出到二进制文件
-    this->integr_data_to_file(contents, ranges, outstream);
+template <class T>
+void chainer::cscan<T>::set_bin_version(int version)
+{
+    this->bin_version = version == 2 ? 2 : 101;
+}
 
-    printf("\n写入文件完成, 总计耗时: %fs\n",
-           ptimer.get() / 1000000.0);
-    
-    return total_count;
+template <class T>
+void chainer::cscan<T>::set_bin_index(bool enable)
+{
+    this->bin_index = enable;
 }
 
+template <class T>
+void chainer::cscan<T>::set_scan_dir(const char *dir)
+{
+    this->scan_dir = dir == nullptr ? "" : dir;
+}
 
 template <class T>
-size_t chainer::cscan<T>::scan_pointer_chain_to_txt(std::vector<T> &addr, int depth,
-     size_t offset, bool limit, size_t plim, FILE *outstream)
+size_t chainer::cscan<T>::scan_pointer_chain_impl(std::vector<T> &addr, int depth,
+     size_t offset, bool limit, size_t plim, FILE *outstream, bool txt)
 {
     if (addr.empty()) {
         return 0;
@@ -138,64 +127,251 @@ size_t chainer::cscan<T>::scan_pointer_chain_to_txt(std::vector<T> &addr, int de
         uint32_t start;//索引起始
         uint32_t end;//索引结束 */
     std::vector<utils::mapqueue<pointer_dir<T>>> dirs(depth + 1);
-    size_t first_range_idx = 0;
+    std::vector<double> weights; // 束搜索: 上一层每个节点经过的链数
     size_t total_count = 0;
 
+    // 多目标共用一次遍历 第0层为去重后的全部目标 输出时按地址归属到目标编号
+    std::vector<T> targets;
+    this->set_chain_targets(addr, targets);
+    bool spans = this->has_target_spans();
+
+    // .bin 保存的是各条链共享的树 无法逐链过滤 无环模式退化为按层去重的最短模式
+    bool acyclic = txt && this->cycles == CYCLE_ACYCLIC;
+    this->shortest = this->cycles == CYCLE_SHORTEST || (!txt && this->cycles == CYCLE_ACYCLIC);
+    if (!txt && this->cycles == CYCLE_ACYCLIC)
+        printf("二进制输出不支持逐链去环, 改用最短模式\n");
+
+    // 扫描目录: 每完成一层就落盘 可从最后完成的层继续或加深
+    chainer::level_store<T> store;
+    chainer::level_manifest<T> manifest;
+    bool persist = !this->scan_dir.empty() && store.open(this->scan_dir.c_str());
+    int first_level = 0;
+
+    if (persist)
+        first_level = this->resume_pointer_levels(store, manifest, addr, depth, offset, dirs, ranges);
+    else
+        this->statics.assign(memtool::extend::vm_static_list.begin(), memtool::extend::vm_static_list.end());
+
+    // 区间目标: 续扫从第1层开始时重建基本段 第0层节点与载入的一致
+    if (spans && first_level == 1) {
+        utils::mapqueue<pointer_dir<T>> level0;
+        this->build_target_segments(ranges, this->rule_of(1, offset).max, level0);
+    }
+
+    // 正向扩展不区分层 用所有层规则的并集作为窗口
+    size_t reach_max = 0, reach_floor = 0;
+    for (int level = 1; level <= depth; ++level) {
+        auto rule = this->rule_of(level, offset);
+        reach_max = std::max(reach_max, rule.max);
+        reach_floor = std::max(reach_floor, rule.floor);
+    }
+
+    // 起点模块: 正向扩展一半深度 反向搜索到 depth - half 层之后与之相交
+    int half = depth / 2;
+    if (!this->root_module.empty())
+        this->forward_reach(reach_max, reach_floor, half);
+
+    // 途经地址: 每层节点按是否已途经拆分 未途经的节点要在剩余层数内能到达途经地址
+    // 续扫载入的层已经拆分过 重算状态即可
+    bool split = this->waypoint != 0;
+    if (split) {
+        this->waypoint_forward_reach(reach_max, reach_floor, std::min(depth, 0xfe));
+        this->passed.clear();
+        this->passed.resize(depth + 1);
+        for (int level = 0; level < first_level && level <= depth; ++level)
+            this->mark_passed(dirs, level);
+    }
+
+    // 最短模式: 已载入的层先记为已访问
+    if (this->shortest)
+        this->reset_visited(dirs, ranges, 0, std::max(first_level, 0));
+
+    // 续扫时重算已载入最后一层的链数权重
+    if (this->beam.width > 0 && first_level > 0) {
+        weights.assign(dirs[0].size(), 1.0);
+        for (int level = 1; level < first_level && level <= depth; ++level) {
+            std::vector<double> prefix(weights.size() + 1, 0.0);
+            for (size_t i = 0; i < weights.size(); ++i)
+                prefix[i + 1] = prefix[i] + weights[i];
+
+            weights.resize(dirs[level].size());
+            for (size_t i = 0; i < dirs[level].size(); ++i)
+                weights[i] = prefix[dirs[level][i].end] - prefix[dirs[level][i].start];
+        }
+    }
+
+    auto save_level = [&](int level) {
+        if (!persist)
+            return;
+        manifest.depth = level;
+        manifest.exhausted = false;
+        if (!store.save_level(level, dirs[level], ranges, this->statics) || !store.save_manifest(manifest)) {
+            printf("扫描目录写入失败, 停止落盘\n");
+            persist = false;
+        }
+    };
+
+    // 进度: 按最近两层的耗时增长估算剩余层数的耗时
+    double level_time = 0, prev_time = 0;
+    auto estimate = [&](int level) {
+        double ratio = prev_time > 0 ? std::min(std::max(level_time / prev_time, 1.0), 8.0) : 1.0;
+        double eta = 0, t = level_time;
+        for (int k = level + 1; k <= depth; ++k)
+            eta += (t *= ratio);
+
+        double rest = this->control->remaining();
+        return rest >= 0 ? std::min(eta, rest) : eta;
+    };
+
+    // 建立索引的任务 不需要等待时与下一层的搜索并行 扫描结束前等待
+    utils::task_group index_jobs;
+
     // 阶段 1: 多级指针链扫描
-    for (int level = 0; level <= depth; ++level) {
+    for (int level = first_level; level <= depth; ++level) {
         std::vector<pointer_data<T> *> curr;
         printf("\n当前层数: %d\n", level);
 
         if (level > 0) {
-            // 在全局指针数据中搜索上一层的指针
-            this->search_pointer(dirs[level - 1], curr, offset, limit, plim);
+            // 取消或超出时间预算: 不再加深 用已完成的层输出
+            if (this->stopped())
+                break;
+
+            utils::timer ltimer;
+            ltimer.start();
+
+            // 本层的偏移规则 只有最大偏移时走原来的 [0, max] 窗口
+            auto rule = this->rule_of(level, offset);
+            const offset_rule *hot = rule.trivial() ? nullptr : &rule;
+
+            // 在全局指针数据中搜索上一层的指针 区间目标的第1层用探测点搜索 (只用最大偏移)
+            if (level == 1 && spans)
+                this->search_pointer(this->target_probes, curr, rule.max, limit, plim);
+            else
+                this->search_pointer(dirs[level - 1], curr, rule.max, limit, plim, hot);
             printf("%d: 搜索 %ld 指针\n", level, curr.size());
 
+            // 离起点只剩 depth - level 跳 正向不可达的指针不可能连到起点模块
+            if (!this->root_module.empty() && level >= depth - half) {
+                this->filter_by_reach(curr, depth - level);
+                printf("%d: 与正向扩展相交 %ld 指针\n", level, curr.size());
+            }
+
+            // 最短模式: 更低层已出现的指针不再展开 环路和绕远的路径在这里截断
+            if (this->shortest) {
+                this->drop_visited(curr);
+                printf("%d: 去除已访问后 %ld 指针\n", level, curr.size());
+            }
+
+            // 搜索被取消或超出预算时 curr 可能是空的 这不代表搜索已穷尽
+            if (this->stopped()) {
+                printf("%d: 扫描中断 丢弃本层\n", level);
+                break;
+            }
+
             if (curr.empty()) {
+                if (persist) {
+                    manifest.exhausted = true;
+                    store.save_manifest(manifest);
+                }
                 break;
             }
 
             // 过滤指针范围：找到的加入 ranges，找不到的加入 dirs[level]
+            size_t range_idx = ranges.size();
             this->filter_pointer_ranges(dirs, ranges, curr, level);
             
-            // 创建索引：对 dirs[level] 中的指针建立到上一层的索引
+            // 创建索引：对 dirs[level] 和本层静态模块中的指针建立到上一层的索引
             // dirs 的每一层都是按地址排序的
-            this->create_assoc_dir_index(dirs[level - 1], dirs[level], offset, 10000);
+            if (level == 1 && spans) {
+                this->create_segment_index(dirs[level], 10000, index_jobs);
+                for (; range_idx < ranges.size(); ++range_idx)
+                    this->create_segment_index(ranges[range_idx].results, 10000, index_jobs);
+            } else if (hot != nullptr) {
+                // 满足规则的子节点不连续时拆分节点 没有子节点的节点直接丢弃
+                this->create_rule_dir_index(dirs[level - 1], dirs[level], rule, 10000, index_jobs);
+                for (auto i = range_idx; i < ranges.size(); ++i)
+                    this->create_rule_dir_index(dirs[level - 1], ranges[i].results, rule, 10000, index_jobs);
+                ranges.erase(std::remove_if(ranges.begin() + range_idx, ranges.end(),
+                    [](auto &r) { return r.results.empty(); }), ranges.end());
+            } else {
+                this->create_assoc_dir_index(dirs[level - 1], dirs[level], rule.max, 10000, index_jobs);
+                for (; range_idx < ranges.size(); ++range_idx)
+                    this->create_assoc_dir_index(dirs[level - 1], ranges[range_idx].results, rule.max, 10000, index_jobs);
+            }
+
+            if (this->beam.width > 0 || persist || this->control != nullptr || split)
+                utils::thread_pool->wait(index_jobs);
+
+            // 本层被中途打断 索引不完整 整层丢弃
+            if (this->stopped()) {
+                dirs[level].clear();
+                ranges.erase(std::remove_if(ranges.begin(), ranges.end(),
+                    [level](auto &r) { return r.level == level; }), ranges.end());
+                printf("%d: 扫描中断 丢弃本层\n", level);
+                break;
+            }
+
+            if (split && this->split_by_waypoint(dirs, ranges, level, depth) > 0 && manifest.waypoint_level < 0)
+                manifest.waypoint_level = level;
+
+            // 束搜索：索引建立后按评分裁剪本层 下一层只在保留的节点上搜索
+            if (this->beam.width > 0) {
+                this->prune_pointer_dirs(dirs[level - 1], dirs[level], weights, rule.max, level);
+                if (split)
+                    this->mark_passed(dirs, level);
+            }
+
+            if (this->shortest)
+                this->mark_visited(dirs, ranges, level);
+            save_level(level);
+
+            if (this->control != nullptr) {
+                prev_time = level_time;
+                level_time = ltimer.get() / 1000000.0;
+                this->control->report_level(level, depth, curr.size(), estimate(level));
+            }
             continue;
         }
 
         // Level 0: 转换地址为指针数据
-        this->trans_addr_to_pointer_data(addr, curr);
+        this->trans_addr_to_pointer_data(targets, curr);
         std::sort(curr.begin(), curr.end(), 
                  [](auto x, auto y) { return x->address < y->address; });
         
         // 获取静态区域中目标 address 范围的指针数据
         // 找不到的加入 dirs[level]，找到的加入 ranges
         this->filter_pointer_ranges(dirs, ranges, curr, level);
-        first_range_idx = ranges.size();
+        // 区间目标的第0层节点按基本段排列 不按地址有序 途经地址从第1层开始检查
+        if (spans)
+            this->build_target_segments(ranges, this->rule_of(1, offset).max, dirs[level]);
+        if (split && this->split_by_waypoint(dirs, ranges, level, depth) > 0)
+            manifest.waypoint_level = level;
+        if (this->shortest)
+            this->mark_visited(dirs, ranges, level);
+        weights.assign(dirs[level].size(), 1.0);
         
         // 清理临时数据
         utils::free_container_data(curr);
+        save_level(level);
     }
 
-    // 阶段 2: 补充静态模块到前一层的索引
-    for (; first_range_idx < ranges.size(); ++first_range_idx) {
-        this->create_assoc_dir_index(
-            dirs[ranges[first_range_idx].level - 1],
-            ranges[first_range_idx].results,
-            offset,
-            10000
-        );
-    }
+    // 等待所有索引任务完成
+    utils::thread_pool->wait(index_jobs);
 
-    // 等待所有线程完成
-    utils::thread_pool->wait();
+    if (this->control != nullptr && this->control->cancelled()) {
+        printf("\n扫描已取消, 耗时: %fs\n", ptimer.get() / 1000000.0);
+        return total_count;
+    }
+    if (this->control != nullptr && this->control->expired())
+        printf("\n超出时间预算 输出已完成层的结果\n");
+    if (split && manifest.waypoint_level < 0)
+        printf("\n未到达途经地址 0x%lx\n", (size_t)this->waypoint);
     
     if (ranges.empty()) {
         return total_count;
     }
 
-    printf("\n搜索和关联完成, 耗时: %fs, 启动指针过滤\n",
+    printf("\n搜索和关联完成, 耗时: %fs, 启用指针过滤\n",
            ptimer.get() / 1000000.0);
 
     // 阶段 3: 构建指针目录树
@@ -204,6 +380,14 @@ size_t chainer::cscan<T>::scan_pointer_chain_to_txt(std::vector<T> &addr, int de
         return total_count;
     }
 
+    // 束搜索：每个模块只保留评分最优的 topk 条链 重建为一棵小树
+    std::vector<std::vector<pointer_dir<T>>> top_nodes;
+    if (this->beam.topk > 0) {
+        this->select_top_chains(contents, ranges, top_nodes);
+        counts = std::vector<utils::mapqueue<size_t>>(contents.size());
+        this->stat_pointer_dir_count(counts, contents);
+    }
+
     // 阶段 4: 统计每个模块的指针链数量
     for (auto &r : ranges) {
         size_t module_count = 0;
@@ -218,8 +402,41 @@ size_t chainer::cscan<T>::scan_pointer_chain_to_txt(std::vector<T> &addr, int de
                module_count, r.level, r.vma->name, r.vma->count);
     }
 
-    // 阶段 5: 输出到文本文件
-    this->integr_data_to_txt(contents, ranges, outstream);
+    // 按目标统计 只打印有链的目标
+    auto report_targets = [&]() {
+        if (addr.size() <= 1)
+            return;
+        size_t found = 0;
+        for (size_t i = 0; i < addr.size(); ++i) {
+            if (this->target_counts[i] == 0)
+                continue;
+            ++found;
+            printf("目标 #%lu 0x%lX: %lu 锁链\n", i, (size_t)addr[i], this->target_counts[i]);
+        }
+        printf("%lu/%lu 个目标找到指针链\n", found, addr.size());
+    };
+    this->count_target_chains(contents, ranges);
+    if (!acyclic)
+        report_targets();
+
+    // 阶段 5: 输出到文本文件或二进制文件
+    if (acyclic) {
+        // 无环模式: 输出时逐链检查 链数和按目标统计以写出的为准
+        std::vector<offset_rule> hops;
+        for (size_t level = 0; level < contents.size(); ++level)
+            hops.emplace_back(this->rule_of(level, offset));
+
+        size_t written = this->integr_data_to_txt(contents, ranges, outstream, &hops);
+        printf("去除环路和冗余后缀链: %lu -> %lu 锁链\n", total_count, written);
+        total_count = written;
+        report_targets();
+    } else if (txt)
+        this->integr_data_to_txt(contents, ranges, outstream);
+    else {
+        this->integr_data_to_file(contents, ranges, outstream);
+        if (this->bin_index)
+            this->integr_index_to_file(counts, ranges, outstream);
+    }
 
     printf("\n写入文件完成, 总计耗时: %fs\n",
            ptimer.get() / 1000000.0);
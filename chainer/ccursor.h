@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "cbase.h"
+#include "cstore.h"
+
+namespace chainer
+{
+
+//游标当前所在的一条链 指向游标内部的缓冲 游标前进后失效
+template <class T>
+struct chain_view {
+    size_t module;     //模块下标 同 cprog_chain_info::syms
+    const T *offsets;  //offsets[0] 为静态指针在模块中的偏移 offsets[k] 为第 k 跳的偏移
+    size_t size;       //偏移个数 即深度 + 1
+    const cprog_data<T> *const *path; //path[k] 为第 k 跳到达的节点 path[0] 为静态指针
+};
+
+//按 .bin 转文本的顺序逐条枚举链 不递归 不按链分配内存
+//状态是每层一个子节点区间的显式栈 偏移和路径缓冲在构造时按最大深度分配一次
+//根节点按模块顺序统一编号 游标只枚举 [first, last) 内的根节点 可拆成多段给多个线程
+template <class T>
+class chain_cursor
+{
+private:
+    struct slot {
+        uint32_t next;
+        uint32_t end;
+    };
+
+    const cprog_chain_info<T> &info;
+    size_t root;  //下一个根节点的编号
+    size_t last;
+    size_t module;
+    size_t module_end; //当前模块之后第一个根节点的编号
+    int depth;    //当前根节点的层数
+    int curr;     //栈顶所在层 大于 depth 时当前根节点已枚举完
+
+    std::vector<slot> stack; //下标为层数
+    std::vector<T> offsets;
+    std::vector<const cprog_data<T> *> path;
+    chain_view<T> view;
+
+    //开始下一个根节点 没有时返回 false
+    bool start_root();
+
+public:
+    //单遍的输入迭代器 供 range-for 使用
+    class iterator
+    {
+    private:
+        chain_cursor *cursor;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = chain_view<T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const chain_view<T> *;
+        using reference = const chain_view<T> &;
+
+        explicit iterator(chain_cursor *c) : cursor(c) {}
+
+        reference operator*() const { return cursor->get(); }
+        pointer operator->() const { return &cursor->get(); }
+
+        iterator &operator++()
+        {
+            if (!cursor->next())
+                cursor = nullptr;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return cursor == other.cursor; }
+        bool operator!=(const iterator &other) const { return cursor != other.cursor; }
+    };
+
+    //枚举编号在 [first, last) 内的根节点之下的链
+    explicit chain_cursor(const cprog_chain_info<T> &info, size_t first = 0, size_t last = SIZE_MAX);
+
+    //前进到下一条链 没有时返回 false 构造后需先调用一次
+    bool next();
+
+    const chain_view<T> &get() const;
+
+    iterator begin();
+    iterator end();
+};
+
+//把全部根节点按链数切成至多 n 段连续区间 [first, last) 每段的链数大致相同 供多个 chain_cursor 并行枚举
+template <class T>
+std::vector<std::pair<size_t, size_t>> split_chain_ranges(const cprog_chain_info<T> &info, size_t n);
+
+} // namespace chainer
+
+#include "ccursor.hpp"
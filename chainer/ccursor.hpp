@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ccursor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template <class T>
+chainer::chain_cursor<T>::chain_cursor(const chainer::cprog_chain_info<T> &info, size_t first, size_t last) : info(info), root(first), last(last), module(0), module_end(0), depth(0), curr(1)
+{
+    int max_level = 0;
+    for (auto &sym : info.syms)
+        max_level = std::max(max_level, sym.sym->level);
+
+    stack.resize(max_level + 1);
+    offsets.resize(max_level + 1);
+    path.resize(max_level + 1);
+    view = chain_view<T>{0, offsets.data(), 0, path.data()};
+
+    // 定位 first 所在的模块
+    for (; module < info.syms.size(); ++module) {
+        module_end += info.syms[module].data.size();
+        if (root < module_end)
+            break;
+    }
+}
+
+template <class T>
+bool chainer::chain_cursor<T>::start_root()
+{
+    if (root >= last)
+        return false;
+    while (root >= module_end) {
+        if (++module >= info.syms.size())
+            return false;
+        module_end += info.syms[module].data.size();
+    }
+
+    auto &sym = info.syms[module];
+    auto &node = sym.data[root - (module_end - sym.data.size())];
+    ++root;
+
+    depth = sym.sym->level;
+    offsets[0] = node.address - sym.sym->start;
+    path[0] = &node;
+    view.module = module;
+    view.size = depth + 1;
+
+    stack[depth] = slot{node.start, node.end};
+    curr = depth;
+    return true;
+}
+
+template <class T>
+bool chainer::chain_cursor<T>::next()
+{
+    for (;;) {
+        // 当前根节点已枚举完
+        if (curr > depth) {
+            if (!start_root())
+                return false;
+            // 静态指针本身就是目标
+            if (depth == 0) {
+                curr = 1;
+                return true;
+            }
+        }
+
+        while (curr <= depth) {
+            auto &s = stack[curr];
+            auto &layer = info.contents[curr - 1];
+            if (s.next >= s.end || s.next >= layer.size()) {
+                ++curr;
+                continue;
+            }
+
+            auto &child = layer[s.next++];
+            int k = depth - curr + 1;
+            offsets[k] = child.address - path[k - 1]->value;
+            path[k] = &child;
+
+            if (curr == 1)
+                return true;
+
+            --curr;
+            stack[curr] = slot{child.start, child.end};
+        }
+    }
+}
+
+template <class T>
+const chainer::chain_view<T> &chainer::chain_cursor<T>::get() const
+{
+    return view;
+}
+
+template <class T>
+typename chainer::chain_cursor<T>::iterator chainer::chain_cursor<T>::begin()
+{
+    return iterator(next() ? this : nullptr);
+}
+
+template <class T>
+typename chainer::chain_cursor<T>::iterator chainer::chain_cursor<T>::end()
+{
+    return iterator(nullptr);
+}
+
+template <class T>
+std::vector<std::pair<size_t, size_t>> chainer::split_chain_ranges(const chainer::cprog_chain_info<T> &info, size_t n)
+{
+    std::vector<utils::mapqueue<uint64_t>> prefix;
+    std::vector<utils::varray<uint64_t>> levels;
+    bool ok = true;
+    build_chain_prefix(info, prefix, levels);
+
+    // 所有根节点链数的前缀和
+    utils::mapqueue<uint64_t> roots;
+    roots.emplace_back(0);
+    for (auto &sym : info.syms) {
+        utils::mapqueue<uint64_t> part;
+        int level = sym.sym->level;
+        ok = fill_chain_prefix<T>(part, sym.data.begin(), sym.data.size(), level, level > 0 ? &levels[level - 1] : nullptr) && ok;
+        uint64_t base = roots.back();
+        for (size_t i = 1; i < part.size(); ++i)
+            roots.emplace_back(base + part[i]);
+    }
+    if (!ok)
+        throw std::runtime_error("指针链文件节点索引越界");
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t count = roots.size() - 1;
+    uint64_t total = roots.back();
+    n = std::max<size_t>(n, 1);
+
+    size_t first = 0;
+    for (size_t i = 1; i <= n && first < count; ++i) {
+        size_t last = count;
+        if (i < n) {
+            uint64_t want = total / n * i + total % n * i / n;
+            last = std::lower_bound(roots.begin() + first + 1, roots.end(), want) - roots.begin();
+            last = std::min(last, count);
+        }
+        if (last > first)
+            ranges.emplace_back(first, last);
+        first = last;
+    }
+    return ranges;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "mapqueue.h"
+#include "sutils.h"
+
+#include "memextend.hpp"
+
+#include "cbase.h"
+#include "ccontrol.h"
+#include "cemit.h"
+
+namespace chainer
+{
+
+//深度优先指针链扫描
+//与 bfs 按层保存 dirs 不同 这里只保留 按value排序的指针表 和 每个线程一条路径栈
+//内存占用 O(depth * threads) 链找到即写出 适合深层扫描时 bfs 层数据爆内存的场景
+template <class T>
+class dfs
+{
+private:
+    struct frame {
+        T address;
+        T value;
+        size_t next; //下一个待访问的父指针 (vindex 下标)
+        size_t end;
+        size_t found; //入栈时已找到的链数 出栈时比较判断子树是否无解
+    };
+
+    //"从该地址出发 rest 层内到达不了静态模块" 的记忆 线程间共享 分片加锁
+    struct dead_shard {
+        std::mutex lock;
+        std::unordered_map<T, int> rest;
+    };
+
+    struct chain_buffer {
+        std::unique_ptr<char[]> data;
+        size_t len;
+    };
+
+    static constexpr size_t shard_count = 64;
+    static constexpr size_t buffer_size = 1 << 20;
+
+    utils::mapqueue<pointer_data<T>> &pcoll;
+    utils::mapqueue<pointer_data<T>> vindex; //按 value 排序的指针表
+
+    std::vector<memtool::vm_static_data *> statics; //按起始地址排序的静态模块
+    dead_shard shards[shard_count];
+
+    scan_control *control;
+
+    FILE *out_f;
+    std::mutex out_lock;
+    std::atomic<size_t> total;
+    std::atomic<bool> stop;
+    size_t limit;
+    size_t offset;
+    int depth;
+
+    std::vector<std::pair<T, uint32_t>> target_ids; //按地址排序的 (目标地址, 编号)
+    std::unique_ptr<std::atomic<size_t>[]> target_hits; //每个目标编号的链数
+    size_t target_count;
+    std::vector<T> target_slack; //负向余量 只有一个时用于全部目标
+    std::vector<T> target_lows; //与 target_ids 对应 区间目标的下界
+
+    std::vector<offset_rule> offset_rules; //按层偏移规则 与 cscan::set_offset_rules 相同
+    std::vector<offset_rule> level_rules; //level_rules[level] 为父指针在第 level 层时的规则
+
+    cycle_mode cycles; //非 CYCLE_KEEP 时输出前逐链检查 子树是否有解仍按未过滤的链判断
+
+    void build_value_index();
+
+    //第 level 层的父指针: value 落在 [low - max, address + floor] 非区间目标时 low 即 address
+    void parents_of(T low, T address, int level, size_t &lower, size_t &upper);
+
+    //父指针 dat 到子节点 address 的偏移是否满足第 level 层的规则
+    bool accept(T address, const pointer_data<T> &dat, int level) const;
+
+    T target_low(T address);
+
+    //无环模式: 链重复经过同一地址 或根节点可直接到达路径上更靠近目标的节点 (同一起点有更短的后缀链)
+    bool redundant(const std::vector<frame> &stack, const pointer_data<T> &root);
+
+    memtool::vm_static_data *find_static(T address);
+
+    bool is_dead(T address, int rest);
+
+    void set_dead(T address, int rest);
+
+    void flush_chain_buffer(chain_buffer &buf);
+
+    void emit_chain(chain_buffer &buf, std::vector<frame> &stack, memtool::vm_static_data *vma, const pointer_data<T> &root);
+
+    void walk(std::vector<frame> &stack, chain_buffer &buf);
+
+public:
+    explicit dfs(utils::mapqueue<pointer_data<T>> &p, scan_control *c = nullptr);
+
+    //addr为目标地址列表 depth为深度 offset为偏移 limit为链数上限(0不限制)
+    //多目标共用一次遍历 重复地址只扫描一次 多于一个目标时行尾输出 " #编号"
+    size_t scan_pointer_chain(std::vector<T> &addr, int depth, size_t offset, size_t limit, FILE *outstream);
+
+    //目标负向余量 addr[i] 作为区间 [addr[i] - slack[i], addr[i]] 与 cscan::set_target_slack 相同
+    void set_target_slack(const std::vector<T> &slack);
+
+    void set_offset_rules(const std::vector<offset_rule> &rules);
+
+    //深度优先没有按层的数据 CYCLE_SHORTEST 与 CYCLE_ACYCLIC 相同 都在输出时逐链检查
+    void set_cycle_mode(cycle_mode mode);
+
+    //上次扫描每个目标(按 addr 中的序号)的链数
+    void get_target_counts(std::vector<size_t> &counts);
+};
+
+} // namespace chainer
+
+#include "cdfs.hpp"
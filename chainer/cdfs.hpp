@@ -0,0 +1,358 @@
+#pragma once
+
+#include "cdfs.h"
+
+#include <algorithm>
+
+template <class T>
+chainer::dfs<T>::dfs(utils::mapqueue<pointer_data<T>> &p, chainer::scan_control *c) : pcoll(p), control(c), out_f(nullptr), total(0), stop(false), limit(0), offset(0), depth(0), target_count(0), cycles(CYCLE_KEEP)
+{
+}
+
+template <class T>
+void chainer::dfs<T>::build_value_index()
+{
+    // 复制一份全局指针表按 value 排序 父指针查找变为一次二分
+    vindex.clear();
+    vindex.reserve(pcoll.size());
+    for (auto &dat : pcoll) {
+        vindex.emplace_back(dat.address, dat.value);
+    }
+
+    std::sort(vindex.begin(), vindex.end(), [](auto &x, auto &y) { return x.value < y.value; });
+
+    statics.clear();
+    for (auto vma : memtool::extend::vm_static_list) {
+        if (!vma->filter)
+            statics.emplace_back(vma);
+    }
+    std::sort(statics.begin(), statics.end(), [](auto x, auto y) { return x->start < y->start; });
+}
+
+template <class T>
+void chainer::dfs<T>::parents_of(T low, T address, int level, size_t &lower, size_t &upper)
+{
+    // 父指针: value 落在 [low - max, address + floor]
+    auto &rule = level_rules[level];
+    T min = low > rule.max ? low - rule.max : 0;
+    address = address + rule.floor < address ? ~T(0) : address + rule.floor;
+
+    auto value_lt = [](auto &dat, auto target) { return dat.value < target; };
+    auto value_gt = [](auto target, auto &dat) { return target < dat.value; };
+
+    lower = std::lower_bound(vindex.begin(), vindex.end(), min, value_lt) - vindex.begin();
+    upper = std::upper_bound(vindex.begin() + lower, vindex.end(), address, value_gt) - vindex.begin();
+}
+
+template <class T>
+bool chainer::dfs<T>::accept(T address, const pointer_data<T> &dat, int level) const
+{
+    auto &rule = level_rules[level];
+    return rule.trivial() || rule.accept(signed_offset<T>(address - dat.value));
+}
+
+template <class T>
+T chainer::dfs<T>::target_low(T address)
+{
+    auto it = std::lower_bound(target_ids.begin(), target_ids.end(), address, [](auto &x, T t) { return x.first < t; });
+    return it != target_ids.end() && it->first == address ? target_lows[it - target_ids.begin()] : address;
+}
+
+template <class T>
+bool chainer::dfs<T>::redundant(const std::vector<frame> &stack, const pointer_data<T> &root)
+{
+    // 栈底为目标 (值无意义) 其余节点与根节点比较地址和值
+    for (size_t i = 0; i < stack.size(); ++i) {
+        if (stack[i].address == root.address || (i > 0 && stack[i].value == root.value))
+            return true;
+        for (size_t j = 0; j < i; ++j) {
+            if (stack[j].address == stack[i].address || (j > 0 && stack[j].value == stack[i].value))
+                return true;
+        }
+    }
+
+    // 根节点到 stack[i] 为第 i + 1 层的一跳 栈顶是根节点的直接子节点 不算
+    // 窗口与 parents_of 相同: [low - max, address + floor]
+    for (size_t i = 0; i + 1 < stack.size(); ++i) {
+        auto &rule = level_rules[i + 1];
+        T address = stack[i].address;
+        T low = i == 0 ? target_low(address) : address;
+        T min = low > rule.max ? low - rule.max : 0;
+        T max = address + rule.floor < address ? ~T(0) : address + rule.floor;
+        if (root.value >= min && root.value <= max && accept(address, root, i + 1))
+            return true;
+    }
+    return false;
+}
+
+template <class T>
+memtool::vm_static_data *chainer::dfs<T>::find_static(T address)
+{
+    auto it = std::upper_bound(statics.begin(), statics.end(), address, [](auto target, auto vma) { return target < vma->start; });
+    if (it == statics.begin())
+        return nullptr;
+
+    --it;
+    return address < (*it)->end ? *it : nullptr;
+}
+
+template <class T>
+bool chainer::dfs<T>::is_dead(T address, int rest)
+{
+    auto &shard = shards[(address >> 3) % shard_count];
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto it = shard.rest.find(address);
+    return it != shard.rest.end() && it->second >= rest;
+}
+
+template <class T>
+void chainer::dfs<T>::set_dead(T address, int rest)
+{
+    auto &shard = shards[(address >> 3) % shard_count];
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto &dead = shard.rest[address];
+    dead = std::max(dead, rest);
+}
+
+template <class T>
+void chainer::dfs<T>::flush_chain_buffer(chain_buffer &buf)
+{
+    if (buf.len == 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(out_lock);
+    fwrite(buf.data.get(), buf.len, 1, out_f);
+    buf.len = 0;
+}
+
+template <class T>
+void chainer::dfs<T>::emit_chain(chain_buffer &buf, std::vector<frame> &stack, memtool::vm_static_data *vma, const pointer_data<T> &root)
+{
+    if (cycles != CYCLE_KEEP && redundant(stack, root))
+        return;
+
+    if (buf.len + 32 * stack.size() + 256 > buffer_size)
+        flush_chain_buffer(buf);
+
+    // 栈底为目标 栈顶为根节点的子节点 输出时从根往下
+    char *p = buf.data.get() + buf.len;
+    T value = root.value;
+
+    p = put_head(p, vma->name, vma->count, root.address - vma->start);
+    for (auto i = stack.size(); i > 0; --i) {
+        p = put_hop<T>(p, stack[i - 1].address - value);
+        value = stack[i - 1].value;
+    }
+
+    // 栈底 (或根节点本身) 就是目标
+    T target = stack.empty() ? root.address : stack[0].address;
+    auto it = std::lower_bound(target_ids.begin(), target_ids.end(), target, [](auto &x, T t) { return x.first < t; });
+    if (it != target_ids.end() && it->first == target) {
+        target_hits[it->second].fetch_add(1, std::memory_order_relaxed);
+        if (target_ids.size() > 1) {
+            memcpy(p, " #", 2);
+            p = put_dec(p + 2, it->second);
+        }
+    }
+    *p++ = '\n';
+    buf.len = p - buf.data.get();
+
+    auto count = ++total;
+    if (limit > 0 && count >= limit)
+        stop = true;
+}
+
+template <class T>
+void chainer::dfs<T>::walk(std::vector<frame> &stack, chain_buffer &buf)
+{
+    // 栈中 base 以下是种子路径 由调用方展开 这里不出栈
+    size_t base = stack.size();
+    size_t found = 0;
+    size_t steps = 0;
+
+    while (stack.size() >= base && !stop.load(std::memory_order_relaxed)) {
+        // 取消或超出时间预算 已写出的链保留
+        if ((++steps & 0xfff) == 0 && control != nullptr && control->stopped()) {
+            stop = true;
+            break;
+        }
+
+        auto &top = stack.back();
+        int level = stack.size(); // 父指针所在层数
+
+        if (top.next == top.end) {
+            // 子树内没有找到任何链 记录该节点在剩余层数内无解
+            if (found == top.found)
+                set_dead(top.address, depth - (level - 1));
+            stack.pop_back();
+            continue;
+        }
+
+        auto &dat = vindex[top.next++];
+        if (!accept(top.address, dat, level))
+            continue;
+
+        auto vma = find_static(dat.address);
+        if (vma != nullptr) {
+            emit_chain(buf, stack, vma, dat);
+            ++found;
+            continue;
+        }
+
+        int rest = depth - level;
+        if (rest <= 0 || is_dead(dat.address, rest))
+            continue;
+
+        frame next{dat.address, dat.value, 0, 0, found};
+        parents_of(dat.address, dat.address, level + 1, next.next, next.end);
+        stack.emplace_back(next);
+    }
+}
+
+template <class T>
+size_t chainer::dfs<T>::scan_pointer_chain(std::vector<T> &addr, int depth, size_t offset, size_t limit, FILE *outstream)
+{
+    if (addr.empty() || outstream == nullptr || pcoll.size() == 0)
+        return 0;
+
+    this->depth = depth;
+    this->offset = offset;
+    this->limit = limit;
+    this->out_f = outstream;
+    total = 0;
+    stop = false;
+
+    // 重复目标只扫描一次 编号取第一次出现的序号
+    target_ids.clear();
+    for (size_t i = 0; i < addr.size(); ++i)
+        target_ids.emplace_back(addr[i], i);
+    std::stable_sort(target_ids.begin(), target_ids.end(), [](auto &x, auto &y) { return x.first < y.first; });
+    target_ids.erase(std::unique(target_ids.begin(), target_ids.end(), [](auto &x, auto &y) { return x.first == y.first; }), target_ids.end());
+    // 区间下界 重复地址取最大的余量
+    target_lows.clear();
+    for (auto &t : target_ids)
+        target_lows.emplace_back(t.first);
+    for (size_t i = 0; i < addr.size(); ++i) {
+        T slack = target_slack.size() == 1 ? target_slack[0] : i < target_slack.size() ? target_slack[i] : T(0);
+        slack = std::min(slack, addr[i]);
+        auto &low = target_lows[std::lower_bound(target_ids.begin(), target_ids.end(), addr[i], [](auto &x, T t) { return x.first < t; }) - target_ids.begin()];
+        low = std::min(low, T(addr[i] - slack));
+    }
+    target_count = addr.size();
+    target_hits.reset(new std::atomic<size_t>[target_count]);
+    for (size_t i = 0; i < target_count; ++i)
+        target_hits[i] = 0;
+
+    // 每层的偏移规则 max 为0时取 offset
+    level_rules.assign(depth + 2, offset_rule());
+    for (int level = 1; level < (int)level_rules.size(); ++level) {
+        auto &rule = level_rules[level];
+        if (!offset_rules.empty())
+            rule = offset_rules[std::min<size_t>(level - 1, offset_rules.size() - 1)];
+        if (rule.max == 0)
+            rule.max = offset;
+        if (rule.align == 0)
+            rule.align = 1;
+        std::sort(rule.whitelist.begin(), rule.whitelist.end());
+    }
+
+    build_value_index();
+
+    chain_buffer main_buf{std::unique_ptr<char[]>(new char[buffer_size]), 0};
+
+    // 种子路径: 先按层展开前几层 直到足够分给所有线程
+    // 每条种子只含少数几个节点 展开过程中遇到的静态指针直接输出
+    std::vector<std::vector<frame>> seeds, next;
+    for (auto &t : target_ids) {
+        auto address = t.first;
+        pointer_data<T> target(address, 0);
+        std::vector<frame> empty;
+
+        auto vma = find_static(address);
+        if (vma != nullptr) {
+            emit_chain(main_buf, empty, vma, target);
+            continue;
+        }
+        seeds.push_back({frame{address, 0, 0, 0, 0}});
+    }
+
+    size_t want = utils::thread_pool->size() * 16;
+    for (int level = 1; level < depth && seeds.size() < want && !seeds.empty(); ++level) {
+        next.clear();
+        for (auto &seed : seeds) {
+            size_t lower, upper;
+            T address = seed.back().address;
+            parents_of(seed.size() == 1 ? target_low(address) : address, address, level, lower, upper);
+
+            for (auto i = lower; i < upper; ++i) {
+                auto &dat = vindex[i];
+                if (!accept(address, dat, level))
+                    continue;
+
+                auto vma = find_static(dat.address);
+                if (vma != nullptr) {
+                    emit_chain(main_buf, seed, vma, dat);
+                    continue;
+                }
+
+                auto path = seed;
+                path.push_back(frame{dat.address, dat.value, 0, 0, 0});
+                next.emplace_back(std::move(path));
+            }
+        }
+        seeds.swap(next);
+    }
+    flush_chain_buffer(main_buf);
+    printf("深度优先: 种子路径 %ld 条\n", seeds.size());
+
+    // 每个种子路径一个任务 任务内用显式栈深度优先展开
+    auto walk_seed = [this](std::vector<frame> *seed) {
+        chain_buffer buf{std::unique_ptr<char[]>(new char[buffer_size]), 0};
+        auto &stack = *seed;
+
+        T address = stack.back().address;
+        parents_of(stack.size() == 1 ? target_low(address) : address, address, stack.size(), stack.back().next, stack.back().end);
+        stack.back().found = 0;
+        walk(stack, buf);
+        flush_chain_buffer(buf);
+        std::vector<frame>().swap(stack);
+    };
+
+    utils::task_group jobs;
+    for (auto &seed : seeds) {
+        utils::thread_pool->post(jobs, walk_seed, &seed);
+    }
+    utils::thread_pool->wait(jobs);
+
+    fflush(out_f);
+    printf("深度优先: 写入指针链 %ld 条\n", total.load());
+    return total.load();
+}
+
+template <class T>
+void chainer::dfs<T>::get_target_counts(std::vector<size_t> &counts)
+{
+    counts.resize(target_count);
+    for (size_t i = 0; i < target_count; ++i)
+        counts[i] = target_hits[i].load();
+}
+
+template <class T>
+void chainer::dfs<T>::set_target_slack(const std::vector<T> &slack)
+{
+    target_slack = slack;
+}
+
+template <class T>
+void chainer::dfs<T>::set_offset_rules(const std::vector<offset_rule> &rules)
+{
+    offset_rules = rules;
+}
+
+template <class T>
+void chainer::dfs<T>::set_cycle_mode(cycle_mode mode)
+{
+    cycles = mode;
+}
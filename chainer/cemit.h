@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include "mapqueue.h"
+#include "sutils.h"
+
+#include "cbase.h"
+#include "ccontrol.h"
+
+namespace chainer
+{
+
+//两位一组的十六进制表 "00" ~ "FF"
+struct hex_table {
+    char pairs[512];
+
+    constexpr hex_table() : pairs()
+    {
+        constexpr char digits[] = "0123456789ABCDEF";
+        for (int i = 0; i < 256; ++i) {
+            pairs[i * 2] = digits[i >> 4];
+            pairs[i * 2 + 1] = digits[i & 0xf];
+        }
+    }
+};
+
+inline constexpr hex_table hex_lut{};
+
+//大写无前导零的十六进制 与 "%lX" 相同 返回写入后的位置
+inline char *put_hex(char *p, uint64_t v)
+{
+    int n = v == 0 ? 1 : (67 - __builtin_clzll(v)) / 4;
+    char *end = p + n;
+    for (char *q = end; n >= 2; n -= 2, v >>= 8) {
+        q -= 2;
+        memcpy(q, hex_lut.pairs + (v & 0xff) * 2, 2);
+    }
+    if (n != 0)
+        *p = hex_lut.pairs[(v & 0xf) * 2 + 1];
+    return end;
+}
+
+inline char *put_dec(char *p, uint64_t v)
+{
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    while (n > 0)
+        *p++ = tmp[--n];
+    return p;
+}
+
+inline char *put_str(char *p, const char *s)
+{
+    size_t n = strlen(s);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+//一跳 " -> + 0x10" 或 " -> - 0x10" 与 format_offset 的输出相同
+template <class T>
+inline char *put_hop(char *p, T d)
+{
+    long off = signed_offset(d);
+    memcpy(p, off < 0 ? " -> - 0x" : " -> + 0x", 8);
+    return put_hex(p + 8, off < 0 ? (uint64_t)-off : (uint64_t)off);
+}
+
+//链头 "name[count] + 0xOFF"
+inline char *put_head(char *p, const char *name, int count, uint64_t off)
+{
+    p = put_str(p, name);
+    *p++ = '[';
+    p = count < 0 ? put_dec(put_str(p, "-"), -(int64_t)count) : put_dec(p, count);
+    memcpy(p, "] + 0x", 6);
+    return put_hex(p + 6, off);
+}
+
+//文本链输出 bfs 建树输出和 .bin 转文本共用
+//链先写入大缓冲 攒满后一次 fwrite 展开链树时用显式栈
+//栈中每层记录节点 下一个子节点和该层在行缓冲中的长度 换子节点时只改写行尾 不递归也不重复 strlen
+template <class T>
+class chain_emitter
+{
+private:
+    struct slot {
+        const pointer_dir<T> *node;
+        uint32_t next;
+        uint32_t end;
+        size_t pos; //该层节点之前 (含) 的行长度
+    };
+
+    FILE *out; //为空时按 pos 用 pwrite 写入 fd
+    int fd;
+    off_t pos;
+    std::unique_ptr<char[]> data;
+    size_t len;
+    size_t capacity;
+    size_t total; //已写出的字节数
+    bool error;
+
+    std::vector<char> text;  //行缓冲 链头 + 每层一跳
+    std::vector<slot> stack; //下标为层数
+    std::vector<const pointer_dir<T> *> nodes; //当前链上各层的节点 供 skip 判断
+
+public:
+    static constexpr size_t hop_size = 32; //一跳最长 " -> - 0x" + 16 位十六进制
+
+    explicit chain_emitter(FILE *f, size_t capacity = 4 << 20);
+
+    //从文件偏移 offset 开始 pwrite 多个 emitter 可并发写同一文件的不同区间
+    chain_emitter(int fd, off_t offset, size_t capacity = 4 << 20);
+
+    ~chain_emitter();
+
+    //开始一条根节点: 保证行缓冲放得下 level 层 返回行缓冲 调用方在其中写入链头
+    char *begin(int level);
+
+    //按子节点索引非递归展开 root 下的全部链 head 为 begin 返回的缓冲中链头的长度
+    //child(level, i) 返回第 level 层第 i 个节点
+    //leaf(p, node) 在行尾 (第0层节点之后) 追加内容 返回新的行尾 不写换行
+    //skip(level, node, path) 为 true 时跳过第 level 层的子节点 node 及其子树 path[k] 为当前链第 k 层的节点
+    //返回写出的链数
+    template <class C, class L, class S>
+    size_t expand(size_t head, int level, const pointer_dir<T> &root, C &&child, L &&leaf, S &&skip);
+
+    void write(const char *buf, size_t n);
+
+    //写出缓冲中的数据 不 fflush 文件
+    void flush();
+
+    //写入失败过
+    bool failed() const;
+
+    //已写出 (flush 过) 的字节数
+    size_t written() const;
+};
+
+//并行输出的一组根节点 (一个模块某一层的静态指针) 链头为 "name[count] + 0x(address - start)"
+template <class T>
+struct chain_group {
+    const char *name;
+    int count;
+    T start;
+    int level;
+    const pointer_dir<T> *roots;
+    size_t size;
+};
+
+//并行文本输出: 先自底向上算出每个节点之下的链数和字节数 得到每个根节点在文件中的区间
+//再按字节数把根节点切成连续的任务 多线程各自 pwrite 到预先扩展好的文件中 顺序与单线程输出相同
+//widths[level] 为第 level 层节点数 child 和 leaf 同 chain_emitter::expand (leaf 会被并发调用 不能有副作用)
+//f 不是普通文件时退化为单线程输出 取消时文件截断到已完整写出的前缀 返回写出的链数
+template <class T, class C, class L>
+size_t write_chains_parallel(FILE *f, std::vector<chain_group<T>> &groups, const std::vector<size_t> &widths, C &&child, L &&leaf, scan_control *control);
+
+} // namespace chainer
+
+#include "cemit.hpp"
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "cemit.h"
+
+template <class T>
+chainer::chain_emitter<T>::chain_emitter(FILE *f, size_t capacity) : out(f), fd(-1), pos(0), data(new char[capacity]), len(0), capacity(capacity), total(0), error(false)
+{
+}
+
+template <class T>
+chainer::chain_emitter<T>::chain_emitter(int fd, off_t offset, size_t capacity) : out(nullptr), fd(fd), pos(offset), data(new char[capacity]), len(0), capacity(capacity), total(0), error(false)
+{
+}
+
+template <class T>
+chainer::chain_emitter<T>::~chain_emitter()
+{
+    flush();
+}
+
+template <class T>
+char *chainer::chain_emitter<T>::begin(int level)
+{
+    // 链头: 模块名最长 128 + "[count] + 0x" + 地址
+    size_t need = 256 + (level + 1) * hop_size + 32;
+    if (text.size() < need)
+        text.resize(need);
+    if (stack.size() < (size_t)level + 1) {
+        stack.resize(level + 1);
+        nodes.resize(level + 1);
+    }
+    return text.data();
+}
+
+template <class T>
+template <class C, class L, class S>
+size_t chainer::chain_emitter<T>::expand(size_t head, int level, const chainer::pointer_dir<T> &root, C &&child, L &&leaf, S &&skip)
+{
+    char *line = text.data();
+    size_t count = 0;
+
+    // 根节点本身就是目标
+    if (level == 0) {
+        char *p = leaf(line + head, root);
+        *p++ = '\n';
+        write(line, p - line);
+        return 1;
+    }
+
+    stack[level] = slot{&root, root.start, root.end, head};
+    nodes[level] = &root;
+
+    int curr = level;
+    while (curr <= level) {
+        auto &s = stack[curr];
+        if (s.next == s.end) {
+            ++curr;
+            continue;
+        }
+
+        auto &node = child(curr - 1, s.next++);
+        if (skip(curr, node, nodes.data()))
+            continue;
+
+        char *p = put_hop<T>(line + s.pos, node.address - s.node->value);
+        if (curr == 1) {
+            p = leaf(p, node);
+            *p++ = '\n';
+            write(line, p - line);
+            ++count;
+            continue;
+        }
+
+        --curr;
+        stack[curr] = slot{&node, node.start, node.end, (size_t)(p - line)};
+        nodes[curr] = &node;
+    }
+    return count;
+}
+
+template <class T>
+void chainer::chain_emitter<T>::write(const char *buf, size_t n)
+{
+    if (len + n > capacity) {
+        flush();
+        // 超过整个缓冲的数据先分段放入缓冲
+        for (; n > capacity; buf += capacity, n -= capacity) {
+            memcpy(data.get(), buf, capacity);
+            len = capacity;
+            flush();
+        }
+    }
+    memcpy(data.get() + len, buf, n);
+    len += n;
+}
+
+template <class T>
+void chainer::chain_emitter<T>::flush()
+{
+    if (len == 0)
+        return;
+
+    if (out != nullptr) {
+        error = fwrite(data.get(), len, 1, out) != 1 || error;
+    } else {
+        // pwrite 可能只写入一部分
+        for (size_t done = 0; done < len;) {
+            auto n = pwrite(fd, data.get() + done, len - done, pos + done);
+            if (n <= 0) {
+                error = true;
+                break;
+            }
+            done += n;
+        }
+        pos += len;
+    }
+    total += len;
+    len = 0;
+}
+
+template <class T>
+bool chainer::chain_emitter<T>::failed() const
+{
+    return error;
+}
+
+template <class T>
+size_t chainer::chain_emitter<T>::written() const
+{
+    return total;
+}
+
+template <class T, class C, class L>
+size_t chainer::write_chains_parallel(FILE *f, std::vector<chainer::chain_group<T>> &groups, const std::vector<size_t> &widths, C &&child, L &&leaf, chainer::scan_control *control)
+{
+    auto cancelled = [control]() { return control != nullptr && control->cancelled(); };
+    auto noskip = [](int, const pointer_dir<T> &, const pointer_dir<T> *const *) { return false; };
+
+    // 非普通文件 (管道 终端) 不能按偏移写入 单线程输出
+    struct stat st;
+    fflush(f);
+    off_t base = ftello(f);
+    if (base < 0 || fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) {
+        size_t chains = 0;
+        chain_emitter<T> emitter(f);
+        for (auto &g : groups) {
+            for (size_t i = 0; i < g.size && !cancelled(); ++i) {
+                char *line = emitter.begin(g.level);
+                char *p = put_head(line, g.name, g.count, g.roots[i].address - g.start);
+                chains += emitter.expand(p - line, g.level, g.roots[i], child, leaf, noskip);
+            }
+        }
+        emitter.flush();
+        return chains;
+    }
+
+    constexpr size_t avg = 10000;
+
+    // 第 level 层节点之下的链数和字节数 (不含本节点之前的部分) 按层存前缀和
+    // 父节点的字节数 = sum(子节点字节数 + 一跳长度 * 子节点链数) 一跳长度与父节点的值有关 按边累加
+    std::vector<utils::mapqueue<size_t>> chains(widths.size()), bytes(widths.size());
+
+    // 节点 dir 在第 level 层时 其下全部链的 (链数, 字节数)
+    auto subtree = [&](int level, const pointer_dir<T> &dir, char *tmp) -> std::pair<size_t, size_t> {
+        if (level == 0)
+            return {1, leaf(tmp, dir) - tmp + 1};
+
+        auto &c = chains[level - 1];
+        auto &b = bytes[level - 1];
+        size_t sum = b[dir.end] - b[dir.start];
+        for (auto i = dir.start; i < dir.end; ++i) {
+            auto &node = child(level - 1, i);
+            sum += (put_hop<T>(tmp, node.address - dir.value) - tmp) * (c[i + 1] - c[i]);
+        }
+        return {c[dir.end] - c[dir.start], sum};
+    };
+
+    utils::task_group jobs;
+    for (size_t level = 0; level < widths.size(); ++level) {
+        auto &c = chains[level];
+        auto &b = bytes[level];
+        c.resize(widths[level] + 1, 0);
+        b.resize(widths[level] + 1, 0);
+
+        auto count = [&, level](size_t start, size_t n) {
+            char tmp[256];
+            for (auto i = start; i < start + n; ++i) {
+                auto r = subtree(level, child(level, i), tmp);
+                c[i + 1] = r.first;
+                b[i + 1] = r.second;
+            }
+        };
+
+        size_t index = 0;
+        utils::split_num_to_avg(widths[level], avg, [&](size_t n) {
+            utils::thread_pool->post(jobs, count, index, n);
+            index += n;
+        });
+        utils::thread_pool->wait(jobs);
+
+        for (size_t i = 0; i < widths[level]; ++i) {
+            c[i + 1] += c[i];
+            b[i + 1] += b[i];
+        }
+    }
+
+    // 每个根节点输出的字节数 前缀和即为其在文件中的偏移
+    size_t roots = 0;
+    std::vector<size_t> first(groups.size() + 1, 0);
+    for (size_t g = 0; g < groups.size(); ++g)
+        first[g + 1] = roots += groups[g].size;
+
+    utils::mapqueue<size_t> offsets, counts;
+    offsets.resize(roots + 1, 0);
+    counts.resize(roots, 0);
+
+    auto measure = [&](size_t g, size_t start, size_t n) {
+        char tmp[256];
+        auto &group = groups[g];
+        for (auto i = start; i < start + n; ++i) {
+            auto &root = group.roots[i];
+            auto r = subtree(group.level, root, tmp);
+            size_t head = put_head(tmp, group.name, group.count, root.address - group.start) - tmp;
+            counts[first[g] + i] = r.first;
+            offsets[first[g] + i + 1] = head * r.first + r.second;
+        }
+    };
+
+    for (size_t g = 0; g < groups.size(); ++g) {
+        size_t index = 0;
+        utils::split_num_to_avg(groups[g].size, avg, [&](size_t n) {
+            utils::thread_pool->post(jobs, measure, g, index, n);
+            index += n;
+        });
+    }
+    utils::thread_pool->wait(jobs);
+
+    size_t total_chains = 0;
+    for (size_t i = 0; i < roots; ++i) {
+        offsets[i + 1] += offsets[i];
+        total_chains += counts[i];
+    }
+    size_t total_bytes = offsets[roots];
+
+    // 按字节数切分任务 每个任务是一段连续的根节点
+    struct task {
+        size_t begin, end;
+        size_t written;
+        bool done;
+    };
+    size_t chunk = std::max<size_t>(total_bytes / (utils::thread_pool->size() * 4 + 1), 4 << 20);
+    std::vector<task> tasks;
+    for (size_t i = 0; i < roots;) {
+        size_t j = i + 1;
+        while (j < roots && offsets[j] - offsets[i] < chunk)
+            ++j;
+        tasks.push_back(task{i, j, 0, false});
+        i = j;
+    }
+
+    if (ftruncate(fileno(f), base + total_bytes) != 0)
+        printf("预分配输出文件失败, 继续写入\n");
+    printf("并行写出 %lu 锁链 %lu 字节 %lu 个任务\n", total_chains, total_bytes, tasks.size());
+
+    auto run = [&](task *t) {
+        chain_emitter<T> emitter(fileno(f), base + offsets[t->begin]);
+        size_t g = std::upper_bound(first.begin(), first.end(), t->begin) - first.begin() - 1;
+        for (auto i = t->begin; i < t->end; ++i) {
+            if (cancelled())
+                break;
+            while (i >= first[g + 1])
+                ++g;
+
+            auto &group = groups[g];
+            auto &root = group.roots[i - first[g]];
+            char *line = emitter.begin(group.level);
+            char *p = put_head(line, group.name, group.count, root.address - group.start);
+            emitter.expand(p - line, group.level, root, child, leaf, noskip);
+        }
+        emitter.flush();
+        t->written = emitter.written();
+        t->done = !emitter.failed() && t->written == offsets[t->end] - offsets[t->begin];
+    };
+
+    for (auto &t : tasks)
+        utils::thread_pool->post(jobs, run, &t);
+    utils::thread_pool->wait(jobs);
+
+    // 取消或写入失败: 只保留从头开始连续完整的任务 之后截断
+    size_t end = 0, written = 0;
+    for (auto &t : tasks) {
+        if (!t.done)
+            break;
+        end = t.end;
+        written += t.written;
+    }
+    if (end < roots) {
+        printf("并行写出未完成 截断到 %lu 字节\n", written);
+        ftruncate(fileno(f), base + written);
+        total_chains = 0;
+        for (size_t i = 0; i < end; ++i)
+            total_chains += counts[i];
+    }
+
+    fseeko(f, base + written, SEEK_SET);
+    return total_chains;
+}
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "cbase.h"
+#include "ccontrol.h"
+#include "cemit.h"
 
 namespace chainer
 {
@@ -13,13 +15,17 @@ template <class T>
 class format : public ::chainer::base<T>
 {
 private:
-    static inline thread_local FILE *out_f;
-    static inline thread_local char *buf;
-    static inline thread_local size_t t_count;
+    //一个符号的全部链写入 emitter 返回链数
+    size_t out_sym_chains(chainer::chain_emitter<T> &emitter, chainer::cprog_sym_integr<T> &sym, std::vector<utils::varray<chainer::cprog_data<T>>> &contents);
 
-    void out_chain_string(char *pre, int level, chainer::cprog_data<T> &dat, std::vector<utils::varray<chainer::cprog_data<T>>> &contents);
+protected:
+    scan_control *control = nullptr;
+
+    bool cancelled() const;
 
 public:
+    void set_scan_control(scan_control *c);//取消后停止输出
+
     size_t format_bin_chain_data(FILE *instream, FILE *outstream);//输出到单一文件
 
     size_t format_bin_chain_data(FILE *instream, const char *folder);//输出到文件夹里面 每份文件对应一个符号链 包括深度
@@ -27,20 +33,34 @@ public:
 }; // namespace chainer
 
 template <class T>
-void chainer::format<T>::out_chain_string(char *pre, int level, chainer::cprog_data<T> &dat, std::vector<utils::varray<chainer::cprog_data<T>>> &contents)
+bool chainer::format<T>::cancelled() const
 {
-    if (level == 0) {
-        //printf("%s = %lx\n", buf, dat.address);
-        strcat(buf, "\n");
-        fwrite(buf, strlen(buf), 1, out_f);
-        ++t_count;
-    } else {
-        for (auto i = dat.start; i < dat.end; ++i) {
-            *pre = 0;
-            auto n = sprintf(pre, " -> + 0x%lX", (size_t)(contents[level - 1][i].address - dat.value));
-            out_chain_string(pre + n, level - 1, contents[level - 1][i], contents);
-        }
+    return control != nullptr && control->cancelled();
+}
+
+template <class T>
+void chainer::format<T>::set_scan_control(chainer::scan_control *c)
+{
+    control = c;
+}
+
+template <class T>
+size_t chainer::format<T>::out_sym_chains(chainer::chain_emitter<T> &emitter, chainer::cprog_sym_integr<T> &sym, std::vector<utils::varray<chainer::cprog_data<T>>> &contents)
+{
+    size_t count = 0;
+    auto child = [&contents](int level, uint32_t i) -> const chainer::cprog_data<T> & { return contents[level][i]; };
+    auto leaf = [](char *p, const chainer::cprog_data<T> &) { return p; };
+    auto skip = [](int, const chainer::cprog_data<T> &, const chainer::cprog_data<T> *const *) { return false; };
+
+    for (auto &dat : sym.data) {
+        if (cancelled())
+            break;
+
+        char *line = emitter.begin(sym.sym->level);
+        char *p = put_head(line, sym.sym->name, sym.sym->count, dat.address - sym.sym->start);
+        count += emitter.expand(p - line, sym.sym->level, dat, child, leaf, skip);
     }
+    return count;
 }
 
 template <class T>
@@ -49,28 +69,26 @@ size_t chainer::format<T>::format_bin_chain_data(FILE *instream, FILE *outstream
     if (outstream == nullptr)
         return 0;
 
-    size_t count;
+    size_t count = 0;
 
     //chainer::cprog_chain_info<T>
     auto [addr, size, syms, contents] = this->parse_cprog_bin_data(instream);
 
-    count = 0;
-    for (auto &sym : syms) {
-        char s_buf[500];
-
-        for (auto &dat : sym.data) {
-            t_count = 0;
-            buf = s_buf;
-            out_f = outstream;
-
-            *s_buf = 0;
-            auto n = sprintf(s_buf, "%s[%d] + 0x%lX", sym.sym->name, sym.sym->count, (size_t)(dat.address - sym.sym->start));
-            out_chain_string(s_buf + n, sym.sym->level, dat, contents);
-            
-            count += t_count;
-        }
-    }
+    // 每条链的长度可由树预先算出 按根节点的输出区间并行写入
+    std::vector<chainer::chain_group<T>> groups;
+    for (auto &sym : syms)
+        groups.push_back(chainer::chain_group<T>{sym.sym->name, sym.sym->count, (T)sym.sym->start, sym.sym->level, sym.data.begin(), sym.data.size()});
+
+    std::vector<size_t> widths;
+    for (auto &c : contents)
+        widths.emplace_back(c.size());
+
+    auto &c_contents = contents;
+    auto child = [&c_contents](int level, uint32_t i) -> const chainer::cprog_data<T> & { return c_contents[level][i]; };
+    auto leaf = [](char *p, const chainer::cprog_data<T> &) { return p; };
+    count = chainer::write_chains_parallel(outstream, groups, widths, child, leaf, control);
 
+    fflush(outstream);
     return count;
 }
 
@@ -86,23 +104,16 @@ size_t chainer::format<T>::format_bin_chain_data(FILE *instream, const char *fol
     auto [addr, size, syms, contents] = this->parse_cprog_bin_data(instream);
     auto &c_contents = contents;
 
+    // 每个文件一个任务 各自的输出缓冲
     auto out = [this, &c_contents, &count](chainer::cprog_sym_integr<T> &sym, auto of) {
-        char s_buf[500];
-
-        for (auto &dat : sym.data) {
-            *s_buf = 0;
-            t_count = 0;
-            buf = s_buf;
-            out_f = of;
-
-            auto n = sprintf(s_buf, "%s[%d] + 0x%lX", sym.sym->name, sym.sym->count, (size_t)(dat.address - sym.sym->start));
-            out_chain_string(s_buf + n, sym.sym->level, dat, c_contents);
-            
-            count += t_count;
+        {
+            chainer::chain_emitter<T> emitter(of);
+            count += out_sym_chains(emitter, sym, c_contents);
         }
         fclose(of);
     };
 
+    utils::task_group jobs;
     for (auto &sym : syms) {
         *path = 0;
         sprintf(path, "%s/%d %s[%d]", folder, sym.sym->level, sym.sym->name, sym.sym->count);
@@ -110,10 +121,10 @@ size_t chainer::format<T>::format_bin_chain_data(FILE *instream, const char *fol
         if (of == nullptr)
             continue;
 
-        utils::thread_pool->pushpool(out, std::ref(sym), of);
+        utils::thread_pool->post(jobs, out, std::ref(sym), of);
     }
 
-    utils::thread_pool->wait();
+    utils::thread_pool->wait(jobs);
 
     return count.load();
 }
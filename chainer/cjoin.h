@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "cparse.h"
+#include "mapqueue.h"
+#include "sutils.h"
+
+namespace chainer
+{
+
+//规范化后的一条链的 128 位指纹
+struct chain_fingerprint {
+    uint64_t hi;
+    uint64_t lo;
+
+    bool operator<(const chain_fingerprint &other) const { return hi != other.hi ? hi < other.hi : lo < other.lo; }
+    bool operator==(const chain_fingerprint &other) const { return hi == other.hi && lo == other.lo; }
+};
+
+//链的规范形式: 去掉全部空白 十六进制数字转小写并去掉前导零
+//"a.so[0] + 0x0010 -> + 0xA8" 与 "a.so[0]+0x10->+0xa8" 相同 只有空白的行返回 false
+//txt_join 只对 parse_chain_line 能解析的行计算指纹 其余行不参与对比和计数
+bool normalize_chain(const char *p, size_t n, std::string &out);
+
+chain_fingerprint fingerprint_of(const char *p, size_t n);
+
+enum txt_join_set {
+    TXT_JOIN_COMMON,   //两边都有 按 lhs 的行输出
+    TXT_JOIN_LHS_ONLY, //只在 lhs
+    TXT_JOIN_RHS_ONLY, //只在 rhs
+};
+
+struct txt_join_stats {
+    size_t lines[2];  //能解析成链的行数
+    size_t unique[2]; //去重后的链数
+    size_t common;
+
+    txt_join_stats() : lines{0, 0}, unique{0, 0}, common(0) {}
+};
+
+//k 路投票的统计 链的支持数为出现它的文件数
+struct txt_vote_stats {
+    std::vector<size_t> lines;   //每个文件能解析成链的行数
+    std::vector<size_t> unique;  //每个文件去重后的链数
+    std::vector<size_t> support; //support[m] 恰好出现在 m 个文件中的链数
+    size_t kept;                 //支持数达到阈值的链数
+
+    txt_vote_stats() : kept(0) {}
+};
+
+//外存哈希对比 k 个文本链文件 内存只与分区大小有关 与文件大小无关
+//1. 顺序读每个文件 按块并行规范化和计算指纹 (指纹, 行号) 按指纹分到各分区 分区缓冲满了追加到溢出文件
+//2. 各分区并行: 读入各文件的记录 按指纹排序后 k 路归并 得到每条链的支持数
+//   支持数达到阈值的链记在第一个出现它的文件的第一行上 (按位存在每个文件的行号位图里)
+//3. 按文件顺序重读原文件 输出记下的行 保持原文件顺序 每条链只输出一次
+//指纹碰撞的两条不同链会被当作同一条 128 位指纹在实际规模下可以忽略
+class txt_join
+{
+private:
+    struct record {
+        chain_fingerprint fp;
+        uint64_t line; //物理行号 从0开始 空行也计数
+    };
+
+    struct block {
+        uint64_t offset; //溢出文件中的位置
+        uint32_t count;  //记录数
+    };
+
+    std::string dir;
+    size_t memory;
+    size_t parts;
+    size_t threshold;
+
+    std::vector<std::string> paths;
+    std::vector<FILE *> spill;
+    std::vector<std::vector<std::vector<block>>> blocks; //blocks[side][p] 分区 p 的记录块
+    std::vector<uint64_t> total_lines;
+
+    //votes[side][b] 行号位图的第 b 位 一行的各位组成记下的支持数 0 为不输出
+    std::vector<std::vector<utils::mapqueue<uint64_t>>> votes;
+
+    void close();
+
+    FILE *make_spill();
+
+    //按块读文件 每块以换行结束 (文件末尾除外) call(p, n)
+    template <class F>
+    static void for_each_block(FILE *f, F &&call);
+
+    //按物理行号遍历文件中记下的行 (去掉首尾空白) call(p, n, support)
+    template <class F>
+    size_t for_each_vote(size_t side, F &&call);
+
+    //第一遍: 计算指纹写入分区
+    void partition(size_t side, txt_vote_stats &st);
+
+    void load(size_t side, size_t p, std::vector<record> &out);
+
+    //第二遍: 一个分区内的 k 路归并
+    void join_part(size_t p, txt_vote_stats &st);
+
+    void join(const std::vector<std::string> &files, size_t min_support, txt_vote_stats &st);
+
+public:
+    //dir 为溢出文件的目录 空时用 tmpfile memory 为大致的内存上限
+    explicit txt_join(const std::string &dir = "", size_t memory = 512ul << 20);
+    ~txt_join();
+
+    txt_join(const txt_join &) = delete;
+    txt_join &operator=(const txt_join &) = delete;
+
+    //对比两个文件 失败时抛出 std::runtime_error
+    txt_join_stats run(const std::string &lhs, const std::string &rhs);
+
+    //按原文件顺序把集合中的行 (去掉首尾空白) 交给 call(const char *p, size_t n) 返回行数
+    template <class F>
+    size_t emit(txt_join_set which, F &&call);
+
+    //一遍统计 k 个文件中每条链的支持数 保留支持数不小于 threshold 的链 失败时抛出 std::runtime_error
+    txt_vote_stats vote(const std::vector<std::string> &files, size_t threshold);
+
+    //按文件顺序输出保留的链 call(const char *p, size_t n, size_t support) 返回链数
+    template <class F>
+    size_t emit_votes(F &&call);
+};
+
+} // namespace chainer
+
+#include "cjoin.hpp"
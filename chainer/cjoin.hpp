@@ -0,0 +1,465 @@
+#pragma once
+
+#include "cjoin.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+inline bool chainer::normalize_chain(const char *p, size_t n, std::string &out)
+{
+    out.clear();
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = p[i];
+        if (isspace(c))
+            continue;
+
+        // 模块名中的 "0x" 不是数字 只处理独立的十六进制字面量
+        bool literal = c == '0' && i + 1 < n && (p[i + 1] == 'x' || p[i + 1] == 'X') && (i == 0 || !isalnum((unsigned char)p[i - 1]));
+        if (!literal) {
+            out += (char)c;
+            continue;
+        }
+
+        size_t j = i + 2;
+        while (j + 1 < n && p[j] == '0' && isxdigit((unsigned char)p[j + 1]))
+            ++j;
+        out += "0x";
+        for (; j < n && isxdigit((unsigned char)p[j]); ++j)
+            out += (char)tolower((unsigned char)p[j]);
+        i = j - 1;
+    }
+    return !out.empty();
+}
+
+//MurmurHash3 x64 128
+inline chainer::chain_fingerprint chainer::fingerprint_of(const char *p, size_t n)
+{
+    constexpr uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto fmix = [](uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    };
+
+    uint64_t h1 = 0, h2 = 0, k1, k2;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        memcpy(&k1, p + i, 8);
+        memcpy(&k2, p + i + 8, 8);
+        h1 ^= rotl(k1 * c1, 31) * c2;
+        h1 = (rotl(h1, 27) + h2) * 5 + 0x52dce729;
+        h2 ^= rotl(k2 * c2, 33) * c1;
+        h2 = (rotl(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+    k1 = k2 = 0;
+    for (size_t j = n - i; j > 8; --j)
+        k2 |= (uint64_t)(unsigned char)p[i + j - 1] << ((j - 9) * 8);
+    for (size_t j = std::min<size_t>(n - i, 8); j > 0; --j)
+        k1 |= (uint64_t)(unsigned char)p[i + j - 1] << ((j - 1) * 8);
+    if (n - i > 8)
+        h2 ^= rotl(k2 * c2, 33) * c1;
+    if (n - i > 0)
+        h1 ^= rotl(k1 * c1, 31) * c2;
+
+    h1 ^= n, h2 ^= n;
+    h1 += h2, h2 += h1;
+    h1 = fmix(h1), h2 = fmix(h2);
+    h1 += h2, h2 += h1;
+    return chain_fingerprint{h1, h2};
+}
+
+inline chainer::txt_join::txt_join(const std::string &dir, size_t memory) : dir(dir), memory(memory), parts(1), threshold(1)
+{
+}
+
+inline chainer::txt_join::~txt_join()
+{
+    close();
+}
+
+inline void chainer::txt_join::close()
+{
+    for (auto f : spill) {
+        if (f != nullptr)
+            fclose(f);
+    }
+    spill.clear();
+    blocks.clear();
+}
+
+inline FILE *chainer::txt_join::make_spill()
+{
+    if (dir.empty()) {
+        FILE *f = tmpfile();
+        if (f == nullptr)
+            throw std::runtime_error("无法创建溢出文件");
+        return f;
+    }
+
+    // 创建后立即删除 关闭时自动回收
+    std::string path = dir + "/.chain_join_XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        throw std::runtime_error("无法创建溢出文件: " + dir);
+    unlink(path.c_str());
+    FILE *f = fdopen(fd, "w+b");
+    if (f == nullptr) {
+        ::close(fd);
+        throw std::runtime_error("无法创建溢出文件: " + dir);
+    }
+    return f;
+}
+
+template <class F>
+void chainer::txt_join::for_each_block(FILE *f, F &&call)
+{
+    std::vector<char> buf(8 << 20);
+    size_t carry = 0;
+
+    for (;;) {
+        // 一行比缓冲还长
+        if (carry == buf.size())
+            buf.resize(buf.size() * 2);
+
+        size_t n = fread(buf.data() + carry, 1, buf.size() - carry, f);
+        size_t len = carry + n;
+        if (n == 0) {
+            if (len != 0)
+                call(buf.data(), len);
+            return;
+        }
+
+        size_t cut = len;
+        while (cut > 0 && buf[cut - 1] != '\n')
+            --cut;
+        if (cut == 0) {
+            carry = len;
+            continue;
+        }
+
+        call(buf.data(), cut);
+        carry = len - cut;
+        memmove(buf.data(), buf.data() + cut, carry);
+    }
+}
+
+inline void chainer::txt_join::partition(size_t side, chainer::txt_vote_stats &st)
+{
+    constexpr size_t avg = 1 << 20; //每个任务的文本字节数
+    std::unique_ptr<FILE, decltype(&fclose)> f(fopen(paths[side].c_str(), "rb"), &fclose);
+    if (!f)
+        throw std::runtime_error("无法打开指针链文本文件: " + paths[side]);
+
+    // 分区缓冲共用约 1/4 的内存上限
+    size_t cap = std::min<size_t>(std::max<size_t>(memory / 4 / parts / sizeof(record), 256), 1 << 16);
+    std::vector<std::vector<record>> bufs(parts);
+
+    auto flush = [&](size_t p) {
+        auto &buf = bufs[p];
+        if (buf.empty())
+            return;
+        block blk{(uint64_t)ftello(spill[side]), (uint32_t)buf.size()};
+        if (fwrite(buf.data(), sizeof(record), buf.size(), spill[side]) != buf.size())
+            throw std::runtime_error("写入溢出文件失败");
+        blocks[side][p].emplace_back(blk);
+        buf.clear();
+    };
+
+    utils::task_group jobs;
+    uint64_t line = 0;
+    size_t lines = 0;
+    for_each_block(f.get(), [&](const char *p, size_t n) {
+        // 按换行切段 各段并行规范化和计算指纹 行号先记段内的
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t begin = 0; begin < n;) {
+            size_t end = std::min(n, begin + avg);
+            while (end < n && p[end - 1] != '\n')
+                ++end;
+            ranges.emplace_back(begin, end);
+            begin = end;
+        }
+
+        std::vector<std::vector<record>> outs(ranges.size());
+        std::vector<uint64_t> counts(ranges.size());
+        auto work = [&](size_t k) {
+            std::string norm;
+            std::vector<uint64_t> offsets;
+            txt_chain_head head;
+            uint64_t local = 0;
+            const char *q = p + ranges[k].first, *end = p + ranges[k].second;
+            while (q < end) {
+                auto e = (const char *)memchr(q, '\n', end - q);
+                if (e == nullptr)
+                    e = end;
+                // 只统计能解析成链的行 表头 注释和格式不对的行跳过
+                offsets.clear();
+                if (parse_chain_line<uint64_t>(q, e, head, offsets) && normalize_chain(q, e - q, norm))
+                    outs[k].emplace_back(record{fingerprint_of(norm.data(), norm.size()), local});
+                ++local;
+                q = e + 1;
+            }
+            counts[k] = local;
+        };
+
+        for (size_t k = 0; k < ranges.size(); ++k)
+            utils::thread_pool->post(jobs, work, k);
+        utils::thread_pool->wait(jobs);
+
+        for (size_t k = 0; k < ranges.size(); ++k) {
+            for (auto &r : outs[k]) {
+                r.line += line;
+                auto &buf = bufs[r.fp.hi % parts];
+                buf.emplace_back(r);
+                if (buf.size() >= cap)
+                    flush(r.fp.hi % parts);
+            }
+            lines += outs[k].size();
+            line += counts[k];
+        }
+    });
+
+    if (ferror(f.get()))
+        throw std::runtime_error("读取指针链文本文件失败: " + paths[side]);
+    for (size_t p = 0; p < parts; ++p)
+        flush(p);
+    if (fflush(spill[side]) != 0)
+        throw std::runtime_error("写入溢出文件失败");
+
+    total_lines[side] = line;
+    st.lines[side] = lines;
+}
+
+inline void chainer::txt_join::load(size_t side, size_t p, std::vector<record> &out)
+{
+    size_t total = 0;
+    for (auto &blk : blocks[side][p])
+        total += blk.count;
+    out.resize(total);
+
+    char *dst = (char *)out.data();
+    for (auto &blk : blocks[side][p]) {
+        size_t size = (size_t)blk.count * sizeof(record), done = 0;
+        while (done < size) {
+            ssize_t n = pread(fileno(spill[side]), dst + done, size - done, blk.offset + done);
+            if (n <= 0)
+                throw std::runtime_error("读取溢出文件失败");
+            done += n;
+        }
+        dst += size;
+    }
+}
+
+inline void chainer::txt_join::join_part(size_t p, chainer::txt_vote_stats &st)
+{
+    size_t k = paths.size();
+    std::vector<std::vector<record>> sides(k);
+    std::vector<size_t> pos(k, 0), unique(k, 0), support(k + 1, 0);
+    size_t kept = 0;
+
+    // 同一指纹的记录按行号排 第一条就是最早出现的一行
+    auto by_fp = [](const record &x, const record &y) { return x.fp == y.fp ? x.line < y.line : x.fp < y.fp; };
+    for (size_t side = 0; side < k; ++side) {
+        load(side, p, sides[side]);
+        std::sort(sides[side].begin(), sides[side].end(), by_fp);
+    }
+
+    for (;;) {
+        // 各文件当前最小的指纹 k 很小 直接逐个比较
+        const chain_fingerprint *fp = nullptr;
+        for (size_t side = 0; side < k; ++side) {
+            if (pos[side] < sides[side].size() && (fp == nullptr || sides[side][pos[side]].fp < *fp))
+                fp = &sides[side][pos[side]].fp;
+        }
+        if (fp == nullptr)
+            break;
+
+        chain_fingerprint curr = *fp;
+        size_t owner = k, line = 0, count = 0;
+        for (size_t side = 0; side < k; ++side) {
+            auto &v = sides[side];
+            if (pos[side] >= v.size() || !(v[pos[side]].fp == curr))
+                continue;
+            if (owner == k)
+                owner = side, line = v[pos[side]].line;
+            ++count, ++unique[side];
+            while (pos[side] < v.size() && v[pos[side]].fp == curr)
+                ++pos[side];
+        }
+
+        ++support[count];
+        if (count < threshold)
+            continue;
+        ++kept;
+        auto &planes = votes[owner];
+        for (size_t b = 0; b < planes.size(); ++b) {
+            if (count >> b & 1)
+                __atomic_fetch_or(&planes[b][line >> 6], 1ull << (line & 63), __ATOMIC_RELAXED);
+        }
+    }
+
+    for (size_t side = 0; side < k; ++side)
+        __atomic_fetch_add(&st.unique[side], unique[side], __ATOMIC_RELAXED);
+    for (size_t m = 0; m <= k; ++m)
+        __atomic_fetch_add(&st.support[m], support[m], __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st.kept, kept, __ATOMIC_RELAXED);
+}
+
+inline void chainer::txt_join::join(const std::vector<std::string> &files, size_t min_support, chainer::txt_vote_stats &st)
+{
+    size_t k = files.size();
+    close();
+    paths = files;
+    threshold = std::max<size_t>(min_support, 1);
+    st = txt_vote_stats();
+    st.lines.assign(k, 0);
+    st.unique.assign(k, 0);
+    st.support.assign(k + 1, 0);
+
+    // 按每行至少 24 字节估计记录数 同时运行的分区合计约占一半内存
+    uint64_t bytes = 0;
+    for (auto &path : paths) {
+        struct stat sb;
+        if (stat(path.c_str(), &sb) != 0)
+            throw std::runtime_error("无法打开指针链文本文件: " + path);
+        bytes += sb.st_size;
+    }
+    size_t threads = std::max<size_t>(utils::thread_pool->size(), 1);
+    size_t budget = std::max<size_t>(memory / 2 / threads, 1 << 20);
+    parts = std::min<size_t>(bytes / 24 * sizeof(record) / budget + 1, 4096);
+
+    spill.assign(k, nullptr);
+    blocks.assign(k, std::vector<std::vector<block>>(parts));
+    total_lines.assign(k, 0);
+    for (size_t side = 0; side < k; ++side) {
+        spill[side] = make_spill();
+        partition(side, st);
+    }
+
+    // 支持数最大为 k 每个文件按位存
+    size_t bits = 1;
+    while ((k >> bits) != 0)
+        ++bits;
+    votes.assign(k, {});
+    for (size_t side = 0; side < k; ++side) {
+        votes[side].resize(bits);
+        for (auto &plane : votes[side])
+            plane.resize((total_lines[side] + 63) / 64, 0);
+    }
+
+    // 线程池里的异常不会传出来 记下后统一抛出
+    std::atomic_bool bad(false);
+    auto work = [&](size_t p) {
+        try {
+            join_part(p, st);
+        } catch (...) {
+            bad = true;
+        }
+    };
+    utils::task_group jobs;
+    for (size_t p = 0; p < parts; ++p)
+        utils::thread_pool->post(jobs, work, p);
+    utils::thread_pool->wait(jobs);
+
+    close();
+    if (bad)
+        throw std::runtime_error("读取溢出文件失败");
+}
+
+template <class F>
+size_t chainer::txt_join::for_each_vote(size_t side, F &&call)
+{
+    if (side >= votes.size() || total_lines[side] == 0)
+        return 0;
+    auto &planes = votes[side];
+
+    std::unique_ptr<FILE, decltype(&fclose)> f(fopen(paths[side].c_str(), "rb"), &fclose);
+    if (!f)
+        throw std::runtime_error("无法打开指针链文本文件: " + paths[side]);
+
+    // 与 partition 同样切行 行号一致
+    uint64_t line = 0;
+    size_t count = 0;
+    for_each_block(f.get(), [&](const char *p, size_t n) {
+        const char *q = p, *end = p + n;
+        while (q < end) {
+            auto e = (const char *)memchr(q, '\n', end - q);
+            if (e == nullptr)
+                e = end;
+
+            size_t support = 0;
+            for (size_t b = 0; line < total_lines[side] && b < planes.size(); ++b)
+                support |= (size_t)(planes[b][line >> 6] >> (line & 63) & 1) << b;
+            if (support != 0) {
+                const char *s = q, *t = e;
+                while (s < t && isspace((unsigned char)*s))
+                    ++s;
+                while (t > s && isspace((unsigned char)t[-1]))
+                    --t;
+                call(s, (size_t)(t - s), support);
+                ++count;
+            }
+            ++line;
+            q = e + 1;
+        }
+    });
+    return count;
+}
+
+inline chainer::txt_join_stats chainer::txt_join::run(const std::string &lhs, const std::string &rhs)
+{
+    txt_vote_stats vs;
+    join({lhs, rhs}, 1, vs);
+
+    txt_join_stats st;
+    for (int side = 0; side < 2; ++side) {
+        st.lines[side] = vs.lines[side];
+        st.unique[side] = vs.unique[side];
+    }
+    st.common = vs.support[2];
+    return st;
+}
+
+template <class F>
+size_t chainer::txt_join::emit(chainer::txt_join_set which, F &&call)
+{
+    // 共有链记在 lhs 上 支持数为 2 只在一边的支持数为 1
+    size_t side = which == TXT_JOIN_RHS_ONLY ? 1 : 0;
+    size_t want = which == TXT_JOIN_COMMON ? 2 : 1;
+    size_t count = 0;
+    for_each_vote(side, [&](const char *p, size_t n, size_t support) {
+        if (support == want) {
+            call(p, n);
+            ++count;
+        }
+    });
+    return count;
+}
+
+inline chainer::txt_vote_stats chainer::txt_join::vote(const std::vector<std::string> &files, size_t threshold)
+{
+    txt_vote_stats st;
+    join(files, threshold, st);
+    return st;
+}
+
+template <class F>
+size_t chainer::txt_join::emit_votes(F &&call)
+{
+    size_t count = 0;
+    for (size_t side = 0; side < paths.size(); ++side)
+        count += for_each_vote(side, call);
+    return count;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapqueue.h"
+
+#include "memsetting.h"
+
+#include "cbase.h"
+
+namespace chainer
+{
+
+//清单格式版本 行的顺序或层数据的含义改变时加一 版本不同的扫描目录不复用
+//lows rules shortest 三节可以省略 只在末尾追加可省略的节时不用加一
+constexpr int level_manifest_version = 2;
+
+//扫描目录的清单 记录已完成的层数和扫描参数
+template <class T>
+struct level_manifest {
+    int size;          //sizeof(T)
+    size_t offset;
+    int depth;         //[0, depth] 层已完成
+    bool exhausted;    //depth + 1 层已无指针 继续加深没有意义
+    size_t pointers;   //指针快照数量
+    T waypoint;        //途经地址 0为不限制
+    T waypoint_tolerance;
+    int waypoint_level; //命中途经地址的层数 -1为未命中
+    std::string root;   //起点模块 空为不限制
+    int scan_depth;     //扫描时的最大深度 起点模块的过滤与之相关
+    std::vector<T> targets;
+    std::vector<T> lows; //区间目标的下界 与 targets 对应 精确目标时为空
+    std::string rules;   //按层偏移规则的签名 空为只用 offset
+    bool shortest;       //最短模式 每个指针只保留在第一次出现的层
+
+    level_manifest() : size(sizeof(T)), offset(0), depth(-1), exhausted(false), pointers(0), waypoint(0), waypoint_tolerance(0), waypoint_level(-1), scan_depth(-1), shortest(false) {}
+};
+
+//把 bfs 每一层的 dirs 和 ranges 落盘到扫描目录
+//进程被杀后可从最后完成的层继续 也可以在已有结果上加深
+//目录结构:
+//  manifest         文本清单
+//  pointers.bin     指针快照 pointer_data<T>[]
+//  modules.bin      静态模块 vm_static_data[]
+//  level_N.dirs     第N层 pointer_dir<T>[]
+//  level_N.ranges   第N层落在静态模块的指针 {int 模块下标, size_t 数量, pointer_dir<T>[]}...
+template <class T>
+class level_store
+{
+private:
+    std::string dir;
+
+    std::string path_of(const char *name) const;
+
+    std::string path_of(int level, const char *suffix) const;
+
+    //先写入 .tmp 再 rename 保证被杀时不会留下半个文件
+    template <typename F>
+    bool write_file(const std::string &path, F &&call);
+
+public:
+    bool open(const char *path);
+
+    bool is_open() const;
+
+    bool load_manifest(level_manifest<T> &m);
+
+    bool save_manifest(const level_manifest<T> &m);
+
+    bool load_pointers(utils::mapqueue<pointer_data<T>> &pcoll);
+
+    bool save_pointers(utils::mapqueue<pointer_data<T>> &pcoll);
+
+    bool load_modules(std::vector<std::unique_ptr<memtool::vm_static_data>> &modules);
+
+    bool save_modules(std::vector<memtool::vm_static_data *> &modules);
+
+    //modules 为 statics 列表 ranges 中的 vma 按下标存取
+    bool load_level(int level, utils::mapqueue<pointer_dir<T>> &dirs, std::vector<pointer_range<T>> &ranges, std::vector<memtool::vm_static_data *> &modules);
+
+    bool save_level(int level, utils::mapqueue<pointer_dir<T>> &dirs, std::vector<pointer_range<T>> &ranges, std::vector<memtool::vm_static_data *> &modules);
+};
+
+} // namespace chainer
+
+#include "clevel.hpp"
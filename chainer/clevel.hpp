@@ -0,0 +1,274 @@
+#pragma once
+
+#include "clevel.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+template <class T>
+std::string chainer::level_store<T>::path_of(const char *name) const
+{
+    return dir + "/" + name;
+}
+
+template <class T>
+std::string chainer::level_store<T>::path_of(int level, const char *suffix) const
+{
+    return dir + "/level_" + std::to_string(level) + suffix;
+}
+
+template <class T>
+template <typename F>
+bool chainer::level_store<T>::write_file(const std::string &path, F &&call)
+{
+    std::string tmp = path + ".tmp";
+
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+
+    bool ok = call(f);
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    fclose(f);
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <class T>
+bool chainer::level_store<T>::open(const char *path)
+{
+    dir.clear();
+    if (path == nullptr || *path == 0)
+        return false;
+
+    // 逐级创建目录
+    std::string p(path);
+    for (size_t pos = p.find('/', 1);; pos = p.find('/', pos + 1)) {
+        mkdir(p.substr(0, pos).c_str(), 0777);
+        if (pos == std::string::npos)
+            break;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return false;
+
+    dir = p;
+    return true;
+}
+
+template <class T>
+bool chainer::level_store<T>::is_open() const
+{
+    return !dir.empty();
+}
+
+template <class T>
+bool chainer::level_store<T>::load_manifest(chainer::level_manifest<T> &m)
+{
+    FILE *f = fopen(path_of("manifest").c_str(), "r");
+    if (f == nullptr)
+        return false;
+
+    int version = 0, exhausted = 0;
+    size_t count = 0;
+    uint64_t waypoint = 0, tolerance = 0;
+    char root[256] = {0};
+    if (fscanf(f, "chainer-scan %d\n", &version) != 1 || version != level_manifest_version) {
+        printf("扫描目录清单版本 %d 与当前版本 %d 不同, 重新扫描\n", version, level_manifest_version);
+        fclose(f);
+        return false;
+    }
+
+    bool ok = fscanf(f, "size %d\n", &m.size) == 1 &&
+              fscanf(f, "offset %zu\n", &m.offset) == 1 &&
+              fscanf(f, "depth %d\n", &m.depth) == 1 &&
+              fscanf(f, "exhausted %d\n", &exhausted) == 1 &&
+              fscanf(f, "pointers %zu\n", &m.pointers) == 1 &&
+              fscanf(f, "waypoint %" SCNx64 " %" SCNx64 " %d\n", &waypoint, &tolerance, &m.waypoint_level) == 3 &&
+              fscanf(f, "root %255[^\n]\n", root) == 1 &&
+              fscanf(f, "scan_depth %d\n", &m.scan_depth) == 1 &&
+              fscanf(f, "targets %zu\n", &count) == 1;
+
+    m.exhausted = exhausted != 0;
+    m.waypoint = (T)waypoint;
+    m.waypoint_tolerance = (T)tolerance;
+    m.root = strcmp(root, "-") == 0 ? "" : root;
+    m.targets.clear();
+    for (size_t i = 0; ok && i < count; ++i) {
+        uint64_t target;
+        ok = fscanf(f, "%" SCNx64 "\n", &target) == 1;
+        m.targets.emplace_back((T)target);
+    }
+
+    // 区间目标的下界 与 targets 一一对应 旧清单没有这一节
+    m.lows.clear();
+    if (ok && fscanf(f, "lows %zu\n", &count) == 1) {
+        for (size_t i = 0; ok && i < count; ++i) {
+            uint64_t low;
+            ok = fscanf(f, "%" SCNx64 "\n", &low) == 1;
+            m.lows.emplace_back((T)low);
+        }
+    }
+
+    // 按层偏移规则 旧清单没有这一行
+    char rules[4096];
+    m.rules.clear();
+    if (ok && fscanf(f, "rules %4095[^\n]\n", rules) == 1)
+        m.rules = rules;
+
+    // 最短模式 旧清单没有这一行
+    int shortest = 0;
+    m.shortest = ok && fscanf(f, "shortest %d\n", &shortest) == 1 && shortest != 0;
+
+    fclose(f);
+    return ok;
+}
+
+template <class T>
+bool chainer::level_store<T>::save_manifest(const chainer::level_manifest<T> &m)
+{
+    return write_file(path_of("manifest"), [&m](FILE *f) {
+        fprintf(f, "chainer-scan %d\n", level_manifest_version);
+        fprintf(f, "size %d\n", m.size);
+        fprintf(f, "offset %zu\n", m.offset);
+        fprintf(f, "depth %d\n", m.depth);
+        fprintf(f, "exhausted %d\n", m.exhausted ? 1 : 0);
+        fprintf(f, "pointers %zu\n", m.pointers);
+        fprintf(f, "waypoint %" PRIx64 " %" PRIx64 " %d\n", (uint64_t)m.waypoint, (uint64_t)m.waypoint_tolerance, m.waypoint_level);
+        fprintf(f, "root %s\n", m.root.empty() ? "-" : m.root.c_str());
+        fprintf(f, "scan_depth %d\n", m.scan_depth);
+        fprintf(f, "targets %zu\n", m.targets.size());
+        for (auto target : m.targets)
+            fprintf(f, "%" PRIx64 "\n", (uint64_t)target);
+        if (!m.lows.empty()) {
+            fprintf(f, "lows %zu\n", m.lows.size());
+            for (auto low : m.lows)
+                fprintf(f, "%" PRIx64 "\n", (uint64_t)low);
+        }
+        if (!m.rules.empty())
+            fprintf(f, "rules %s\n", m.rules.c_str());
+        if (m.shortest)
+            fprintf(f, "shortest %d\n", 1);
+        return true;
+    });
+}
+
+template <class T>
+bool chainer::level_store<T>::load_pointers(utils::mapqueue<chainer::pointer_data<T>> &pcoll)
+{
+    FILE *f = fopen(path_of("pointers.bin").c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    struct stat st;
+    fstat(fileno(f), &st);
+
+    size_t count = st.st_size / sizeof(pointer_data<T>);
+    pcoll.shrink();
+    pcoll.resize(count);
+    bool ok = count == 0 || fread(pcoll.begin(), sizeof(pointer_data<T>), count, f) == count;
+    fclose(f);
+    return ok;
+}
+
+template <class T>
+bool chainer::level_store<T>::save_pointers(utils::mapqueue<chainer::pointer_data<T>> &pcoll)
+{
+    return write_file(path_of("pointers.bin"), [&pcoll](FILE *f) {
+        return pcoll.size() == 0 || fwrite(pcoll.begin(), sizeof(pointer_data<T>), pcoll.size(), f) == pcoll.size();
+    });
+}
+
+template <class T>
+bool chainer::level_store<T>::load_modules(std::vector<std::unique_ptr<memtool::vm_static_data>> &modules)
+{
+    FILE *f = fopen(path_of("modules.bin").c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    memtool::vm_static_data vma;
+    modules.clear();
+    while (fread(&vma, sizeof(vma), 1, f) == 1)
+        modules.emplace_back(new memtool::vm_static_data(vma));
+
+    fclose(f);
+    return true;
+}
+
+template <class T>
+bool chainer::level_store<T>::save_modules(std::vector<memtool::vm_static_data *> &modules)
+{
+    return write_file(path_of("modules.bin"), [&modules](FILE *f) {
+        for (auto vma : modules) {
+            if (fwrite(vma, sizeof(*vma), 1, f) != 1)
+                return false;
+        }
+        return true;
+    });
+}
+
+template <class T>
+bool chainer::level_store<T>::load_level(int level, utils::mapqueue<chainer::pointer_dir<T>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, std::vector<memtool::vm_static_data *> &modules)
+{
+    FILE *f = fopen(path_of(level, ".dirs").c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    struct stat st;
+    fstat(fileno(f), &st);
+
+    // 读入临时队列而非直接映射 建树时会原地改写 start/end
+    size_t count = st.st_size / sizeof(pointer_dir<T>);
+    dirs.shrink();
+    dirs.resize(count);
+    bool ok = count == 0 || fread(dirs.begin(), sizeof(pointer_dir<T>), count, f) == count;
+    fclose(f);
+
+    f = fopen(path_of(level, ".ranges").c_str(), "rb");
+    if (!ok || f == nullptr)
+        return false;
+
+    int index;
+    while (ok && fread(&index, sizeof(index), 1, f) == 1) {
+        ok = fread(&count, sizeof(count), 1, f) == 1 && index >= 0 && (size_t)index < modules.size();
+        if (!ok)
+            break;
+
+        decltype(pointer_range<T>::results) results;
+        results.resize(count);
+        ok = count == 0 || fread(results.begin(), sizeof(pointer_dir<T>), count, f) == count;
+        ranges.emplace_back(level, modules[index], std::move(results));
+    }
+
+    fclose(f);
+    return ok;
+}
+
+template <class T>
+bool chainer::level_store<T>::save_level(int level, utils::mapqueue<chainer::pointer_dir<T>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, std::vector<memtool::vm_static_data *> &modules)
+{
+    bool ok = write_file(path_of(level, ".dirs"), [&dirs](FILE *f) {
+        return dirs.size() == 0 || fwrite(dirs.begin(), sizeof(pointer_dir<T>), dirs.size(), f) == dirs.size();
+    });
+
+    return ok && write_file(path_of(level, ".ranges"), [&](FILE *f) {
+        for (auto &r : ranges) {
+            if (r.level != level)
+                continue;
+
+            int index = std::find(modules.begin(), modules.end(), r.vma) - modules.begin();
+            size_t count = r.results.size();
+            if (fwrite(&index, sizeof(index), 1, f) != 1 || fwrite(&count, sizeof(count), 1, f) != 1)
+                return false;
+            if (count > 0 && fwrite(r.results.begin(), sizeof(pointer_dir<T>), count, f) != count)
+                return false;
+        }
+        return true;
+    });
+}
@@ -0,0 +1,378 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "sutils.h"
+
+namespace chainer
+{
+
+//v2 .bin 文件头 之后是若干压缩块 直到文件结束
+//每块: uint32_t raw_len, uint32_t packed_len (0 为未压缩 数据长度为 raw_len) 然后是数据
+//0 < raw_len <= block_size 压缩块只在变小时保存 即 packed_len < raw_len
+//所有块解压后首尾相接为负载 变长整数可以跨块 负载内全部是变长整数:
+//  目录: 模块数 层数 每个模块 (start 名字 range count level 根节点数) 每层节点数
+//  数据: 每个模块的根节点 然后每层的节点
+//  节点: zigzag(地址 - 上一地址) zigzag(值 - 上一值) zigzag(start - 上一 end) end - start
+//  上一地址在模块根节点中从模块起始地址开始 在层中从0开始 每个模块和每层重新开始
+//计数都是变长整数 但读取时解码为 v101 布局 且 pointer_dir 的子节点索引是 32 位
+//每层节点数不超过 UINT32_MAX 每个模块的根节点数不超过 INT_MAX 超出的树两种格式都不写出
+struct cprog_header_v2 {
+    char magic[8];       //"chainer2"
+    uint32_t version;    //2
+    uint32_t size;       //sizeof(T)
+    uint32_t block_size; //每块解压后的最大字节数
+    uint32_t reserved;
+};
+
+constexpr char cprog_v2_magic[8] = {'c', 'h', 'a', 'i', 'n', 'e', 'r', '2'};
+
+constexpr uint32_t cprog_max_block_size = 1 << 26;
+
+inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+inline void put_varint(std::vector<uint8_t> &out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((uint8_t)v | 0x80);
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+//负载读取 越界或变长整数过长时抛出异常
+struct varint_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+
+    uint64_t get()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end)
+                throw std::runtime_error("指针链文件负载不完整");
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return v;
+        }
+        throw std::runtime_error("指针链文件负载损坏");
+    }
+
+    int64_t get_signed() { return unzigzag(get()); }
+
+    const uint8_t *take(size_t n)
+    {
+        if ((size_t)(end - p) < n)
+            throw std::runtime_error("指针链文件负载不完整");
+        p += n;
+        return p - n;
+    }
+};
+
+//轻量 LZ 块压缩 序列格式与 LZ4 block 相同:
+//token (高4位字面量长度 低4位匹配长度 - 4 为15时后接 255 累加的扩展长度) 字面量 2字节偏移 扩展匹配长度
+//最后一个序列只有字面量 最后 5 字节总是字面量
+namespace lz
+{
+
+constexpr int hash_bits = 14;
+constexpr size_t min_match = 4;
+constexpr size_t last_literals = 5;
+
+inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+inline uint8_t *put_length(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+//最坏情况的输出大小
+inline size_t bound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+//n 字节压缩数据最多解压出的字节数 每个扩展长度字节最多 255 字节
+inline size_t max_raw(size_t n)
+{
+    return n * 255 + 16;
+}
+
+//dst 至少 bound(n) 字节 返回压缩后的长度
+inline size_t compress(const uint8_t *src, size_t n, uint8_t *dst)
+{
+    std::vector<uint32_t> table(1 << hash_bits, 0);
+    const uint8_t *ip = src, *anchor = src, *iend = src + n;
+    const uint8_t *limit = n > last_literals + min_match ? iend - last_literals - min_match : src;
+    uint8_t *op = dst;
+
+    auto emit = [&](const uint8_t *lit_end, size_t match_len, size_t offset) {
+        size_t lit = lit_end - anchor;
+        uint8_t *token = op++;
+        *token = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+        if (lit >= 15)
+            op = put_length(op, lit - 15);
+        memcpy(op, anchor, lit);
+        op += lit;
+        if (match_len == 0)
+            return;
+
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        size_t m = match_len - min_match;
+        *token |= (uint8_t)(m >= 15 ? 15 : m);
+        if (m >= 15)
+            op = put_length(op, m - 15);
+    };
+
+    while (ip < limit) {
+        uint32_t seq = read32(ip);
+        uint32_t h = hash(seq);
+        const uint8_t *ref = src + table[h];
+        table[h] = (uint32_t)(ip - src);
+
+        if (ref >= ip || ip - ref > 0xffff || read32(ref) != seq) {
+            ++ip;
+            continue;
+        }
+
+        // 匹配不能覆盖最后的字面量
+        const uint8_t *mend = ip + min_match, *r = ref + min_match;
+        while (mend < iend - last_literals && *mend == *r)
+            ++mend, ++r;
+
+        emit(ip, mend - ip, ip - ref);
+        ip = anchor = mend;
+    }
+
+    emit(iend, 0, 0);
+    return op - dst;
+}
+
+//解压到 dst 必须正好得到 raw 字节 数据损坏时返回 false
+inline bool decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t raw)
+{
+    const uint8_t *ip = src, *iend = src + n;
+    uint8_t *op = dst, *oend = dst + raw;
+
+    auto get_length = [&](size_t len, bool &ok) {
+        if (len != 15)
+            return len;
+        for (uint8_t b = 255; b == 255;) {
+            if (ip == iend) {
+                ok = false;
+                return len;
+            }
+            b = *ip++;
+            len += b;
+        }
+        return len;
+    };
+
+    while (ip < iend) {
+        bool ok = true;
+        uint8_t token = *ip++;
+        size_t lit = get_length(token >> 4, ok);
+        if (!ok || (size_t)(iend - ip) < lit || (size_t)(oend - op) < lit)
+            return false;
+        memcpy(op, ip, lit);
+        ip += lit, op += lit;
+
+        // 最后一个序列只有字面量
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t len = get_length(token & 0xf, ok) + min_match;
+        if (!ok || offset == 0 || offset > (size_t)(op - dst) || (size_t)(oend - op) < len)
+            return false;
+
+        // 可能与输出重叠 逐字节复制
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < len; ++i)
+            op[i] = ref[i];
+        op += len;
+    }
+    return op == oend;
+}
+
+} // namespace lz
+
+//v2 负载写入: 攒满一批块后在线程池中并行压缩 按顺序写出
+class cprog_packer
+{
+private:
+    FILE *out;
+    size_t block_size;
+    std::vector<uint8_t> raw;                 //当前块
+    std::vector<std::vector<uint8_t>> blocks; //待压缩的一批块
+    bool error;
+
+    void write_batch()
+    {
+        std::vector<std::vector<uint8_t>> packed(blocks.size());
+        auto pack = [this, &packed](size_t i) {
+            auto &b = blocks[i];
+            packed[i].resize(lz::bound(b.size()));
+            packed[i].resize(lz::compress(b.data(), b.size(), packed[i].data()));
+        };
+        utils::task_group jobs;
+        for (size_t i = 0; i < blocks.size(); ++i)
+            utils::thread_pool->post(jobs, pack, i);
+        utils::thread_pool->wait(jobs);
+
+        // 压缩后没有变小的块原样保存
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            bool stored = packed[i].size() >= blocks[i].size();
+            auto &data = stored ? blocks[i] : packed[i];
+            uint32_t len[2] = {(uint32_t)blocks[i].size(), stored ? 0u : (uint32_t)packed[i].size()};
+            error = fwrite(len, sizeof(len), 1, out) != 1 || error;
+            error = (!data.empty() && fwrite(data.data(), data.size(), 1, out) != 1) || error;
+        }
+        blocks.clear();
+    }
+
+    //切出 block_size 字节的整块 last 时剩余的不足一块也切出 负载在块之间连续 可以在任意字节处切开
+    void end_block(bool last)
+    {
+        size_t start = 0;
+        while (raw.size() - start >= block_size || (last && start < raw.size())) {
+            size_t n = std::min(block_size, raw.size() - start);
+            blocks.emplace_back(raw.begin() + start, raw.begin() + start + n);
+            start += n;
+            if (blocks.size() >= utils::thread_pool->size())
+                write_batch();
+        }
+        raw.erase(raw.begin(), raw.begin() + start);
+    }
+
+public:
+    cprog_packer(FILE *f, int size, size_t block_size = 1 << 20) : out(f), block_size(block_size), error(false)
+    {
+        cprog_header_v2 header;
+        memcpy(header.magic, cprog_v2_magic, sizeof(header.magic));
+        header.version = 2;
+        header.size = size;
+        header.block_size = block_size;
+        header.reserved = 0;
+        error = fwrite(&header, sizeof(header), 1, out) != 1;
+        raw.reserve(block_size + 16);
+    }
+
+    void put(uint64_t v)
+    {
+        put_varint(raw, v);
+        if (raw.size() >= block_size)
+            end_block(false);
+    }
+
+    void put_signed(int64_t v) { put(zigzag(v)); }
+
+    void put_bytes(const void *data, size_t n)
+    {
+        put(n);
+        auto p = (const uint8_t *)data;
+        raw.insert(raw.end(), p, p + n);
+        if (raw.size() >= block_size)
+            end_block(false);
+    }
+
+    //写出剩余的块 返回是否全部写入成功
+    bool finish()
+    {
+        end_block(true);
+        if (!blocks.empty())
+            write_batch();
+        fflush(out);
+        return !error;
+    }
+};
+
+//解压 v2 文件中 header 之后的全部块 块之间相互独立 并行解压
+//块长度在分配之前检查 损坏的块头不会导致巨大的分配
+inline std::vector<uint8_t> unpack_cprog_blocks(const char *addr, size_t size)
+{
+    cprog_header_v2 header;
+    if (size < sizeof(header))
+        throw std::runtime_error("指针链文件头不完整");
+    memcpy(&header, addr, sizeof(header));
+    if (header.block_size == 0 || header.block_size > cprog_max_block_size)
+        throw std::runtime_error("指针链文件块大小无效");
+
+    struct block {
+        const uint8_t *data;
+        uint32_t raw, packed;
+        size_t offset;
+    };
+
+    std::vector<block> list;
+    size_t pos = sizeof(cprog_header_v2), total = 0;
+    while (pos < size) {
+        uint32_t len[2];
+        if (size - pos < sizeof(len))
+            throw std::runtime_error("指针链文件块头不完整");
+        memcpy(len, addr + pos, sizeof(len));
+        pos += sizeof(len);
+
+        if (len[0] == 0 || len[0] > header.block_size || (len[1] != 0 && (len[1] >= len[0] || len[0] > lz::max_raw(len[1]))))
+            throw std::runtime_error("指针链文件块长度无效");
+
+        size_t n = len[1] == 0 ? len[0] : len[1];
+        if (size - pos < n)
+            throw std::runtime_error("指针链文件块不完整");
+        list.push_back(block{(const uint8_t *)addr + pos, len[0], len[1], total});
+        pos += n;
+        total += len[0];
+    }
+
+    std::vector<uint8_t> raw(total);
+    std::vector<char> ok(list.size(), 1);
+    auto unpack = [&](size_t i) {
+        auto &b = list[i];
+        if (b.packed == 0)
+            memcpy(raw.data() + b.offset, b.data, b.raw);
+        else
+            ok[i] = lz::decompress(b.data, b.packed, raw.data() + b.offset, b.raw);
+    };
+    utils::task_group jobs;
+    for (size_t i = 0; i < list.size(); ++i)
+        utils::thread_pool->post(jobs, unpack, i);
+    utils::thread_pool->wait(jobs);
+
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+        throw std::runtime_error("指针链文件压缩块损坏");
+    return raw;
+}
+
+} // namespace chainer
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "mapqueue.h"
+#include "sutils.h"
+
+namespace chainer
+{
+
+//十六进制字符 -> 数值 非十六进制字符为 0xff
+struct hex_value_table {
+    uint8_t values[256];
+
+    constexpr hex_value_table() : values()
+    {
+        for (int i = 0; i < 256; ++i)
+            values[i] = 0xff;
+        for (int i = 0; i < 10; ++i)
+            values['0' + i] = i;
+        for (int i = 0; i < 6; ++i)
+            values['a' + i] = values['A' + i] = 10 + i;
+    }
+};
+
+inline constexpr hex_value_table hex_values{};
+
+//一行文本链的模块部分 name 指向行内 不以0结尾
+struct txt_chain_head {
+    const char *name;
+    size_t name_len;
+    int count;
+};
+
+//解析一行 "name[count] + 0xOFF -> + 0xOFF -> - 0xOFF" 空白可有可无 十六进制不分大小写
+//名字中可以有 '[' ']' (如 "[anon:libc_malloc][0]") 以后面紧跟偏移的 ']' 为准
+//偏移追加到 offsets 格式不对时返回 false 且不修改 offsets 不分配内存 (offsets 容量够时)
+//偏移超出 T 的宽度或 count 超出 int 时也算格式不对
+template <class T>
+bool parse_chain_line(const char *p, const char *end, txt_chain_head &head, std::vector<T> &offsets);
+
+//整个文本链文件的解析结果 所有链的偏移首尾相接 持有文件的只读映射
+template <class T>
+struct txt_chain_set {
+    char *addr;
+    size_t size;
+
+    std::vector<std::string> names; //模块 names[m] 与 counts[m] 即 name[count]
+    std::vector<int> counts;
+
+    utils::mapqueue<T> offsets;
+    utils::mapqueue<uint64_t> first;  //第 i 条链的偏移为 offsets[first[i], first[i + 1])
+    utils::mapqueue<uint32_t> module; //第 i 条链的模块下标
+    utils::mapqueue<uint64_t> line;   //第 i 条链所在行在文件中的字节偏移
+
+    txt_chain_set() : addr(nullptr), size(0) {}
+    ~txt_chain_set() { close(); }
+
+    txt_chain_set(const txt_chain_set &) = delete;
+    txt_chain_set &operator=(const txt_chain_set &) = delete;
+
+    void close();
+
+    size_t chains() const { return module.size(); }
+
+    //第 i 条链所在的行 不含换行
+    const char *text(size_t i, size_t &len) const;
+};
+
+//映射整个文件 按行对齐切块在线程池中并行解析 每块的结果按顺序拼接 (顺序与行的顺序相同)
+//无法解析的行跳过 映射失败时抛出 std::runtime_error
+template <class T>
+void parse_txt_chains(FILE *f, txt_chain_set<T> &out);
+
+} // namespace chainer
+
+#include "cparse.hpp"
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "cparse.h"
+
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <stdexcept>
+
+template <class T>
+bool chainer::parse_chain_line(const char *p, const char *end, chainer::txt_chain_head &head, std::vector<T> &offsets)
+{
+    auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+    while (p < end && blank(*p))
+        ++p;
+    while (end > p && blank(end[-1]))
+        --end;
+
+    // 模块部分以后面紧跟 '+' 或 '-' 的 ']' 结束
+    const char *close = nullptr;
+    for (auto q = p; (q = (const char *)memchr(q, ']', end - q)) != nullptr; ++q) {
+        auto r = q + 1;
+        while (r < end && *r == ' ')
+            ++r;
+        if (r < end && (*r == '+' || *r == '-')) {
+            close = q;
+            break;
+        }
+    }
+    if (close == nullptr)
+        return false;
+
+    auto open = (const char *)memrchr(p, '[', close - p);
+    if (open == nullptr || open == p || open + 1 == close)
+        return false;
+
+    int count = 0;
+    for (auto c = open + 1; c < close; ++c) {
+        if (*c < '0' || *c > '9' || count > (INT_MAX - (*c - '0')) / 10)
+            return false;
+        count = count * 10 + (*c - '0');
+    }
+
+    // 每个偏移为 "+ 0x.." 或 "- 0x.." 之间以 "->" 相连
+    size_t base = offsets.size();
+    auto fail = [&]() {
+        offsets.resize(base);
+        return false;
+    };
+
+    for (auto q = close + 1;;) {
+        while (q < end && *q == ' ')
+            ++q;
+        if (q == end || (*q != '+' && *q != '-'))
+            return fail();
+        bool negative = *q++ == '-';
+        while (q < end && *q == ' ')
+            ++q;
+        if (end - q < 3 || q[0] != '0' || (q[1] | 0x20) != 'x')
+            return fail();
+        q += 2;
+
+        // 前导0不计 有效位数超过 T 的宽度时溢出
+        uint64_t v = 0;
+        auto digits = q;
+        size_t width = 0;
+        for (uint8_t d; q < end && (d = hex_values.values[(uint8_t)*q]) != 0xff; ++q) {
+            if (v == 0 && d == 0)
+                continue;
+            if (++width > sizeof(T) * 2)
+                return fail();
+            v = v << 4 | d;
+        }
+        if (q == digits)
+            return fail();
+        offsets.emplace_back(negative ? T(0) - (T)v : (T)v);
+
+        while (q < end && *q == ' ')
+            ++q;
+        if (q == end)
+            break;
+        if (end - q < 2 || q[0] != '-' || q[1] != '>')
+            return fail();
+        q += 2;
+    }
+
+    head.name = p;
+    head.name_len = open - p;
+    head.count = count;
+    return true;
+}
+
+template <class T>
+void chainer::txt_chain_set<T>::close()
+{
+    if (addr != nullptr)
+        munmap(addr, size);
+    addr = nullptr, size = 0;
+    names.clear();
+    counts.clear();
+    offsets.clear();
+    first.clear();
+    module.clear();
+    line.clear();
+}
+
+template <class T>
+const char *chainer::txt_chain_set<T>::text(size_t i, size_t &len) const
+{
+    const char *p = addr + line[i];
+    auto end = (const char *)memchr(p, '\n', addr + size - p);
+    if (end == nullptr)
+        end = addr + size;
+    while (end > p && end[-1] == '\r')
+        --end;
+    len = end - p;
+    return p;
+}
+
+template <class T>
+void chainer::parse_txt_chains(FILE *f, chainer::txt_chain_set<T> &out)
+{
+    constexpr size_t avg = 4 << 20; //每个任务的文本字节数
+
+    out.close();
+    if (f == nullptr)
+        return;
+
+    struct stat st;
+    int fd = fileno(f);
+    if (fstat(fd, &st) != 0)
+        throw std::runtime_error("无法读取指针链文本文件");
+    if (st.st_size == 0)
+        return;
+
+    out.size = st.st_size;
+    out.addr = (char *)mmap(nullptr, out.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (out.addr == MAP_FAILED) {
+        out.addr = nullptr, out.size = 0;
+        throw std::runtime_error("无法映射指针链文本文件");
+    }
+    madvise(out.addr, out.size, MADV_SEQUENTIAL);
+
+    // 按换行切块
+    const char *data = out.addr;
+    size_t size = out.size;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = 0; begin < size;) {
+        size_t end = begin + avg;
+        if (end >= size) {
+            end = size;
+        } else {
+            auto nl = (const char *)memchr(data + end, '\n', size - end);
+            end = nl == nullptr ? size : nl - data + 1;
+        }
+        ranges.emplace_back(begin, end);
+        begin = end;
+    }
+
+    // 每块的结果 模块为块内下标 相邻的行多半属于同一模块 只在模块变化时查表
+    struct part {
+        std::vector<T> offsets;
+        std::vector<uint32_t> hops;
+        std::vector<uint32_t> module;
+        std::vector<uint64_t> line;
+        std::vector<std::pair<std::string, int>> modules;
+        std::vector<uint32_t> remap;
+    };
+    std::vector<part> parts(ranges.size());
+
+    auto work = [&](size_t k) {
+        auto &pt = parts[k];
+        std::map<std::pair<std::string, int>, uint32_t> ids;
+        std::pair<std::string, int> key;
+        uint32_t last = UINT32_MAX;
+        txt_chain_head head;
+
+        const char *q = data + ranges[k].first, *end = data + ranges[k].second;
+        while (q < end) {
+            auto nl = (const char *)memchr(q, '\n', end - q);
+            auto line_end = nl == nullptr ? end : nl;
+            size_t before = pt.offsets.size();
+
+            if (parse_chain_line<T>(q, line_end, head, pt.offsets)) {
+                if (last == UINT32_MAX || head.count != key.second || key.first.compare(0, std::string::npos, head.name, head.name_len) != 0) {
+                    key.first.assign(head.name, head.name_len);
+                    key.second = head.count;
+                    auto it = ids.emplace(key, pt.modules.size()).first;
+                    if (it->second == pt.modules.size())
+                        pt.modules.emplace_back(key);
+                    last = it->second;
+                }
+                pt.hops.emplace_back(pt.offsets.size() - before);
+                pt.module.emplace_back(last);
+                pt.line.emplace_back(q - data);
+            }
+            q = line_end + 1;
+        }
+    };
+
+    utils::task_group jobs;
+    for (size_t k = 0; k < ranges.size(); ++k)
+        utils::thread_pool->post(jobs, work, k);
+    utils::thread_pool->wait(jobs);
+
+    // 按块的顺序合并模块表 并算出每块在结果中的起点
+    std::map<std::pair<std::string, int>, uint32_t> ids;
+    std::vector<size_t> chain_base(parts.size() + 1, 0), offset_base(parts.size() + 1, 0);
+    for (size_t k = 0; k < parts.size(); ++k) {
+        auto &pt = parts[k];
+        for (auto &mod : pt.modules) {
+            auto it = ids.emplace(mod, out.names.size()).first;
+            if (it->second == out.names.size()) {
+                out.names.emplace_back(mod.first);
+                out.counts.emplace_back(mod.second);
+            }
+            pt.remap.emplace_back(it->second);
+        }
+        chain_base[k + 1] = chain_base[k] + pt.module.size();
+        offset_base[k + 1] = offset_base[k] + pt.offsets.size();
+    }
+
+    size_t chains = chain_base.back();
+    out.offsets.resize(offset_base.back());
+    out.first.resize(chains + 1);
+    out.module.resize(chains);
+    out.line.resize(chains);
+    out.first[chains] = offset_base.back();
+
+    auto copy = [&](size_t k) {
+        auto &pt = parts[k];
+        size_t c = chain_base[k];
+        uint64_t o = offset_base[k];
+        for (size_t i = 0; i < pt.offsets.size(); ++i)
+            out.offsets[o + i] = pt.offsets[i];
+        for (size_t i = 0; i < pt.module.size(); ++i, ++c) {
+            out.first[c] = o;
+            out.module[c] = pt.remap[pt.module[i]];
+            out.line[c] = pt.line[i];
+            o += pt.hops[i];
+        }
+        std::vector<T>().swap(pt.offsets);
+    };
+
+    for (size_t k = 0; k < parts.size(); ++k)
+        utils::thread_pool->post(jobs, copy, k);
+    utils::thread_pool->wait(jobs);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <climits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mapqueue.h"
+#include "sutils.h"
+#include "varray.h"
+
+#include "cbase.h"
+#include "cemit.h"
+#include "cstore.h"
+
+namespace chainer
+{
+
+//有符号偏移范围 [min, max]
+struct hop_range {
+    long min;
+    long max;
+
+    hop_range() : min(LONG_MIN), max(LONG_MAX) {}
+    hop_range(long lo, long hi) : min(lo), max(hi) {}
+
+    bool any() const { return min == LONG_MIN && max == LONG_MAX; }
+
+    bool accept(long d) const { return d >= min && d <= max; }
+};
+
+//链的过滤条件
+//链的第0个偏移为静态指针在模块中的偏移 第 k 个 (k >= 1) 为第 k 跳的偏移 深度为跳数 (文本中 "->" 的个数)
+struct chain_filter {
+    std::string module; //模块名 完全匹配 空为不限制
+    int index;          //name[index] 中的 index -1为不限制
+    int min_depth;
+    int max_depth;
+    std::vector<hop_range> hops; //hops[k] 限制第 k 个偏移 超出的不限制
+
+    chain_filter() : index(-1), min_depth(0), max_depth(INT_MAX) {}
+
+    //第 k 个偏移限制在 [min, max]
+    void hop(size_t k, long min, long max)
+    {
+        if (hops.size() <= k)
+            hops.resize(k + 1);
+        hops[k] = hop_range(min, max);
+    }
+
+    //精确偏移模式 如 "0x10 * -0x8 0x18" * 为任意偏移 深度固定为偏移个数 - 1
+    //格式错误时返回 false 不修改条件
+    bool set_pattern(const std::string &pattern);
+};
+
+//查询结果的统计
+struct query_stats {
+    size_t chains;
+    std::vector<size_t> modules;    //每个模块的链数 下标同 cprog_chain_info::syms
+    std::map<int, size_t> depths;   //深度 -> 链数
+    std::map<long, size_t> offsets; //第 hop 个偏移的值 -> 链数 (stats 指定 hop 时)
+
+    query_stats() : chains(0) {}
+};
+
+//在 .bin 的指针树上直接过滤和统计 不展开成文本
+//按深度分别计算: 深度为 L 的链中第 l 层到第 l - 1 层的一跳是第 L - l + 1 个偏移
+//没有偏移限制的低层直接用前缀链数 有限制的层逐边检查后重新计数 计数为0的节点及其子树被剪掉
+template <class T>
+class query
+{
+private:
+    const cprog_chain_info<T> &info;
+
+    std::vector<utils::mapqueue<uint64_t>> prefix; //prefix[l][i] 第 l 层前 i 个节点之下的链数 (不过滤)
+    std::vector<utils::varray<uint64_t>> levels;   //prefix 的视图
+
+    //深度为 depth 时各层满足条件的链数
+    struct plan {
+        int depth;
+        int low; //低于 low 的层没有偏移限制 直接用 prefix
+        std::vector<utils::mapqueue<uint64_t>> counts; //counts[l][i] 第 l 层 (l >= low) 节点 i 之下满足条件的链数
+    };
+
+    bool match_module(const cprog_sym<T> &sym, const chain_filter &f) const;
+
+    //第 k 个偏移 d 是否满足条件
+    bool hop_ok(const chain_filter &f, int k, T d) const;
+
+    void build_plan(plan &p, const chain_filter &f);
+
+    //第 level 层节点 i 之下满足条件的链数
+    uint64_t below(const plan &p, int level, size_t i) const;
+
+    //节点 dir 在第 level 层时 经过满足条件的一跳到达的链数
+    uint64_t chains_of(const plan &p, const chain_filter &f, int level, const cprog_data<T> &dir) const;
+
+    //每个符合模块 深度和第0个偏移条件的模块的计数方案 (下标同 syms 不符合的为空)
+    std::vector<const plan *> plans_of(const chain_filter &f, std::map<int, plan> &plans);
+
+    //深度 L 的链在 hop 个偏移上的分布 (hop >= 1) 自顶向下累计到达每个节点的满足条件的链头数
+    void hop_histogram(const plan &p, const chain_filter &f, const std::vector<const plan *> &mplans, int hop, std::map<long, size_t> &out);
+
+public:
+    //info 的生命周期需长于 query 构造时并行计算每层的前缀链数
+    explicit query(const cprog_chain_info<T> &info);
+
+    //满足条件的链数
+    size_t count(const chain_filter &f);
+
+    //满足条件的链数 按模块和深度统计 hop >= 0 时统计第 hop 个偏移的分布
+    query_stats stats(const chain_filter &f, int hop = -1);
+
+    //只写出满足条件的链 格式与 .bin 转文本相同 返回写出的链数
+    size_t write(const chain_filter &f, FILE *out);
+};
+
+} // namespace chainer
+
+#include "cquery.hpp"
@@ -0,0 +1,368 @@
+#pragma once
+
+#include "cquery.h"
+
+#include <stdlib.h>
+
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+inline bool chainer::chain_filter::set_pattern(const std::string &pattern)
+{
+    std::vector<hop_range> list;
+    std::istringstream in(pattern);
+    std::string token;
+
+    while (in >> token) {
+        if (token == "*") {
+            list.emplace_back();
+            continue;
+        }
+
+        const char *p = token.c_str();
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+')
+            ++p;
+        char *end;
+        unsigned long v = strtoul(p, &end, 16);
+        if (end == p || *end != 0)
+            return false;
+
+        long d = negative ? -(long)v : (long)v;
+        list.emplace_back(d, d);
+    }
+
+    if (list.empty())
+        return false;
+    hops = std::move(list);
+    min_depth = max_depth = hops.size() - 1;
+    return true;
+}
+
+template <class T>
+chainer::query<T>::query(const chainer::cprog_chain_info<T> &info) : info(info)
+{
+    auto &contents = info.contents;
+    bool ok = true;
+
+    build_chain_prefix(info, prefix, levels);
+    for (auto &sym : info.syms) {
+        int level = sym.sym->level;
+        for (auto &root : sym.data) {
+            if (level > 0 && (root.start > root.end || root.end > contents[level - 1].size()))
+                ok = false;
+        }
+    }
+
+    if (!ok)
+        throw std::runtime_error("指针链文件节点索引越界");
+}
+
+template <class T>
+bool chainer::query<T>::match_module(const chainer::cprog_sym<T> &sym, const chainer::chain_filter &f) const
+{
+    if (!f.module.empty() && f.module != sym.name)
+        return false;
+    if (f.index >= 0 && f.index != sym.count)
+        return false;
+    return sym.level >= f.min_depth && sym.level <= f.max_depth;
+}
+
+template <class T>
+bool chainer::query<T>::hop_ok(const chainer::chain_filter &f, int k, T d) const
+{
+    return (size_t)k >= f.hops.size() || f.hops[k].accept(signed_offset<T>(d));
+}
+
+template <class T>
+void chainer::query<T>::build_plan(plan &p, const chainer::chain_filter &f)
+{
+    constexpr size_t avg = 10000;
+    int depth = p.depth;
+
+    // 有限制的最深一跳 它之下的层不受限制
+    int kmax = 0;
+    for (int k = 1; k <= depth && k < (int)f.hops.size(); ++k) {
+        if (!f.hops[k].any())
+            kmax = k;
+    }
+    p.low = kmax == 0 ? depth : depth - kmax + 1;
+    p.counts.resize(depth);
+
+    utils::task_group jobs;
+
+    // 自底向上 每层依赖下一层的计数
+    for (int level = p.low; level < depth; ++level) {
+        auto &c = p.counts[level];
+        auto &layer = info.contents[level];
+        c.resize(layer.size(), 0);
+
+        auto count = [&, level](size_t start, size_t len) {
+            for (auto i = start; i < start + len; ++i)
+                c[i] = chains_of(p, f, level, layer[i]);
+        };
+
+        size_t index = 0;
+        utils::split_num_to_avg(layer.size(), avg, [&](size_t len) {
+            utils::thread_pool->post(jobs, count, index, len);
+            index += len;
+        });
+        utils::thread_pool->wait(jobs);
+    }
+}
+
+template <class T>
+uint64_t chainer::query<T>::below(const plan &p, int level, size_t i) const
+{
+    if (level < p.low)
+        return levels[level][i + 1] - levels[level][i];
+    return p.counts[level][i];
+}
+
+template <class T>
+uint64_t chainer::query<T>::chains_of(const plan &p, const chainer::chain_filter &f, int level, const chainer::cprog_data<T> &dir) const
+{
+    if (level == 0)
+        return 1;
+    if (level < p.low)
+        return levels[level - 1][dir.end] - levels[level - 1][dir.start];
+
+    int k = p.depth - level + 1;
+    auto &layer = info.contents[level - 1];
+    uint64_t sum = 0;
+    for (auto j = dir.start; j < dir.end; ++j) {
+        if (hop_ok(f, k, layer[j].address - dir.value))
+            sum += below(p, level - 1, j);
+    }
+    return sum;
+}
+
+template <class T>
+auto chainer::query<T>::plans_of(const chainer::chain_filter &f, std::map<int, plan> &plans) -> std::vector<const plan *>
+{
+    std::vector<const plan *> list(info.syms.size(), nullptr);
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        auto &sym = *info.syms[m].sym;
+        if (!match_module(sym, f))
+            continue;
+
+        auto it = plans.find(sym.level);
+        if (it == plans.end()) {
+            it = plans.emplace(sym.level, plan()).first;
+            it->second.depth = sym.level;
+            build_plan(it->second, f);
+        }
+        list[m] = &it->second;
+    }
+    return list;
+}
+
+template <class T>
+void chainer::query<T>::hop_histogram(const plan &p, const chainer::chain_filter &f, const std::vector<const plan *> &mplans, int hop, std::map<long, size_t> &out)
+{
+    constexpr size_t avg = 10000;
+    int depth = p.depth;
+    std::mutex lock;
+
+    // 在第 level 层节点 dir 下满足第 k 个偏移条件且之下有链的子节点
+    auto each_child = [&](int level, const cprog_data<T> &dir, auto &&fn) {
+        int k = depth - level + 1;
+        auto &layer = info.contents[level - 1];
+        for (auto j = dir.start; j < dir.end; ++j) {
+            T d = layer[j].address - dir.value;
+            uint64_t n = below(p, level - 1, j);
+            if (n != 0 && hop_ok(f, k, d))
+                fn(j, d, n);
+        }
+    };
+
+    utils::task_group jobs;
+
+    // 统计第 hop 个偏移: 父节点在第 depth - hop + 1 层 heads 为到达父节点的链头数
+    auto histogram = [&](int level, const cprog_data<T> *nodes, const uint64_t *heads, size_t n) {
+        auto count = [&](size_t start, size_t len) {
+            std::map<long, size_t> local;
+            for (auto i = start; i < start + len; ++i) {
+                uint64_t h = heads == nullptr ? 1 : heads[i];
+                if (h != 0)
+                    each_child(level, nodes[i], [&](uint32_t, T d, uint64_t c) { local[signed_offset<T>(d)] += h * c; });
+            }
+            std::lock_guard<std::mutex> hold(lock);
+            for (auto &kv : local)
+                out[kv.first] += kv.second;
+        };
+
+        size_t index = 0;
+        utils::split_num_to_avg(n, avg, [&](size_t len) {
+            utils::thread_pool->post(jobs, count, index, len);
+            index += len;
+        });
+        utils::thread_pool->wait(jobs);
+    };
+
+    // 满足模块和第0个偏移条件的根节点
+    auto root_ok = [&](const cprog_sym_integr<T> &sym, const cprog_data<T> &root) {
+        return hop_ok(f, 0, root.address - sym.sym->start);
+    };
+
+    if (hop == 1) {
+        for (size_t m = 0; m < info.syms.size(); ++m) {
+            if (mplans[m] != &p)
+                continue;
+            auto &sym = info.syms[m];
+            std::vector<uint64_t> heads(sym.data.size());
+            for (size_t i = 0; i < sym.data.size(); ++i)
+                heads[i] = root_ok(sym, sym.data[i]);
+            histogram(depth, sym.data.begin(), heads.data(), sym.data.size());
+        }
+        return;
+    }
+
+    // 自顶向下累计链头数 子节点可能被多个父节点共享 用原子加
+    utils::mapqueue<uint64_t> curr, next;
+    curr.resize(info.contents[depth - 1].size(), 0);
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        if (mplans[m] != &p)
+            continue;
+        auto &sym = info.syms[m];
+        for (auto &root : sym.data) {
+            if (root_ok(sym, root))
+                each_child(depth, root, [&](uint32_t j, T, uint64_t) { ++curr[j]; });
+        }
+    }
+
+    for (int level = depth - 1; level > depth - hop + 1; --level) {
+        auto &layer = info.contents[level];
+        next.clear();
+        next.resize(info.contents[level - 1].size(), 0);
+
+        auto push = [&, level](size_t start, size_t len) {
+            for (auto i = start; i < start + len; ++i) {
+                uint64_t h = curr[i];
+                if (h != 0)
+                    each_child(level, layer[i], [&](uint32_t j, T, uint64_t) { __atomic_fetch_add(&next[j], h, __ATOMIC_RELAXED); });
+            }
+        };
+
+        size_t index = 0;
+        utils::split_num_to_avg(layer.size(), avg, [&](size_t len) {
+            utils::thread_pool->post(jobs, push, index, len);
+            index += len;
+        });
+        utils::thread_pool->wait(jobs);
+        curr.swap(next);
+    }
+
+    int level = depth - hop + 1;
+    histogram(level, info.contents[level].begin(), curr.begin(), info.contents[level].size());
+}
+
+template <class T>
+size_t chainer::query<T>::count(const chainer::chain_filter &f)
+{
+    return stats(f).chains;
+}
+
+template <class T>
+chainer::query_stats chainer::query<T>::stats(const chainer::chain_filter &f, int hop)
+{
+    constexpr size_t avg = 10000;
+    query_stats st;
+    std::map<int, plan> plans;
+    auto mplans = plans_of(f, plans);
+    std::mutex lock;
+
+    utils::task_group jobs;
+    st.modules.assign(info.syms.size(), 0);
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        if (mplans[m] == nullptr)
+            continue;
+        auto &p = *mplans[m];
+        auto &sym = info.syms[m];
+
+        auto count = [&, m](size_t start, size_t len) {
+            size_t sum = 0;
+            std::map<long, size_t> local;
+            for (auto i = start; i < start + len; ++i) {
+                auto &root = sym.data[i];
+                T off = root.address - sym.sym->start;
+                if (!hop_ok(f, 0, off))
+                    continue;
+                uint64_t n = chains_of(p, f, sym.sym->level, root);
+                sum += n;
+                if (hop == 0 && n != 0)
+                    local[signed_offset<T>(off)] += n;
+            }
+
+            std::lock_guard<std::mutex> hold(lock);
+            st.modules[m] += sum;
+            for (auto &kv : local)
+                st.offsets[kv.first] += kv.second;
+        };
+
+        size_t index = 0;
+        utils::split_num_to_avg(sym.data.size(), avg, [&](size_t len) {
+            utils::thread_pool->post(jobs, count, index, len);
+            index += len;
+        });
+        utils::thread_pool->wait(jobs);
+    }
+
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        if (st.modules[m] == 0)
+            continue;
+        st.chains += st.modules[m];
+        st.depths[info.syms[m].sym->level] += st.modules[m];
+    }
+
+    if (hop >= 1) {
+        for (auto &kv : plans) {
+            if (kv.first >= hop)
+                hop_histogram(kv.second, f, mplans, hop, st.offsets);
+        }
+    }
+    return st;
+}
+
+template <class T>
+size_t chainer::query<T>::write(const chainer::chain_filter &f, FILE *out)
+{
+    if (out == nullptr)
+        return 0;
+
+    std::map<int, plan> plans;
+    auto mplans = plans_of(f, plans);
+    size_t chains = 0;
+
+    chain_emitter<T> emitter(out);
+    auto child = [this](int level, uint32_t i) -> const cprog_data<T> & { return info.contents[level][i]; };
+    auto leaf = [](char *p, const cprog_data<T> &) { return p; };
+
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        if (mplans[m] == nullptr)
+            continue;
+        auto &p = *mplans[m];
+        auto &sym = info.syms[m];
+        int depth = sym.sym->level;
+
+        // node 在第 level - 1 层 父节点为 path[level] 不满足偏移条件或之下没有链时剪掉
+        auto skip = [&](int level, const cprog_data<T> &node, const cprog_data<T> *const *path) {
+            size_t j = &node - info.contents[level - 1].begin();
+            return !hop_ok(f, depth - level + 1, node.address - path[level]->value) || below(p, level - 1, j) == 0;
+        };
+
+        for (auto &root : sym.data) {
+            T off = root.address - sym.sym->start;
+            if (!hop_ok(f, 0, off) || chains_of(p, f, depth, root) == 0)
+                continue;
+            char *line = emitter.begin(depth);
+            char *q = put_head(line, sym.sym->name, sym.sym->count, off);
+            chains += emitter.expand(q - line, depth, root, child, leaf, skip);
+        }
+    }
+
+    emitter.flush();
+    fflush(out);
+    return chains;
+}
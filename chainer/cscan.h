@@ -7,6 +7,9 @@
 #include "memextend.hpp"
 
 #include "cbase.h"
+#include "cemit.h"
+#include "clevel.h"
+#include "cpack.h"
 #include "csearch.h"
 
 namespace chainer
@@ -25,7 +28,16 @@ protected:
 
     // template <class P, template <typename> class Container> clang has fucking bug
     template <class P, class C>
-    void create_assoc_dir_index(P &prev, C &curr, size_t offset, size_t avg); // C.type = pointer_dir<T>
+    void create_assoc_dir_index(P &prev, C &curr, size_t offset, size_t avg, utils::task_group &jobs); // C.type = pointer_dir<T>
+
+    //按偏移规则建立索引: 子节点中满足规则的不一定连续 每段连续的子节点拆成一个节点
+    //没有满足规则的子节点的节点被丢弃 curr 仍按地址有序 (拆出的节点地址相同且相邻)
+    //两遍都在 jobs 中提交并等待 返回时索引已完成
+    template <class P, class C>
+    void create_rule_dir_index(P &prev, C &curr, const offset_rule &rule, size_t avg, utils::task_group &jobs);
+
+    //第 level 层 (从目标数起第 level 跳) 的偏移规则 max 为0时取 offset
+    offset_rule rule_of(int level, size_t offset) const;
 
     void get_results(std::vector<pointer_data<T> *> &list, std::vector<pointer_data<T> *> &save, T start, T end);
 
@@ -39,9 +51,119 @@ protected:
 
     void integr_data_to_file(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f);
 
-    void integr_data_to_txt(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f);
+    //v2 格式: 差分变长整数 按块压缩 见 cpack.h
+    void integr_data_to_file_v2(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f);
+
+    //在 .bin 数据之后追加链索引段 counts 为 stat_pointer_dir_count 的结果 格式见 cprog_index_header
+    void integr_index_to_file(std::vector<utils::mapqueue<size_t>> &counts, std::vector<chainer::pointer_range<T>> &ranges, FILE *f);
+
+    //hops 非空时为无环模式 hops[level] 为第 level 层的规则 跳过重复经过同一地址的链和同一起点有更短后缀链的链
+    //返回写出的链数 无环模式下 target_counts 按写出的链重新统计
+    size_t integr_data_to_txt(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f, const std::vector<offset_rule> *hops = nullptr);
+
+    //无环模式: 值为 value 的指针能否按第 level 层的规则 hop 一跳到达第 level - 1 层的节点 address
+    bool hop_reaches(T value, T address, int level, const offset_rule &hop);
 
     chain_info<T> build_pointer_dirs_tree(std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges);
+
+    void prune_pointer_dirs(utils::mapqueue<pointer_dir<T>> &prev, utils::mapqueue<pointer_dir<T>> &curr, std::vector<double> &weights, size_t offset, int level);
+
+    void select_top_chains(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, std::vector<std::vector<pointer_dir<T>>> &nodes);
+
+    //地址 x 是否落在 waypoint ± tolerance
+    bool near_waypoint(T x) const;
+
+    //途经地址约束: 节点自身的地址或值命中途经地址 或子节点已途经 则节点已途经
+    //未命中的节点按子节点是否已途经拆成连续段 (同 create_rule_dir_index) 拆出的节点地址相同且相邻
+    //未途经且在剩余 depth - level 层内到不了途经地址的节点丢弃 静态指针只保留已途经的
+    //passed[level] 与拆分后的 dirs[level] 一一对应 返回本层已途经的节点数 (含静态指针)
+    size_t split_by_waypoint(std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int level, int depth);
+
+    //按节点和子节点重算 passed[level] (束搜索裁剪或续扫载入之后) 拆分后子节点区间内的状态一致
+    void mark_passed(std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, int level);
+
+    //vma 是否为起点模块 未设置起点模块时总是 true
+    bool is_root_module(memtool::vm_static_data *vma);
+
+    //从起点模块的静态指针沿指针表正向扩展 hops 层 记录每个指针距起点的最少跳数
+    //窗口为 [value - floor, value + offset]
+    void forward_reach(size_t offset, size_t floor, int hops);
+
+    //途经地址: 从地址或值命中途经地址的指针正向扩展 hops 层 记录每个指针距途经地址的最少跳数
+    void waypoint_forward_reach(size_t offset, size_t floor, int hops);
+
+    //从 frontier (pcoll 下标 第0跳) 正向扩展 hops 层 out 与 pcoll 一一对应 0xff 为未到达
+    void expand_reach(std::vector<size_t> &frontier, utils::mapqueue<uint8_t> &out, size_t offset, size_t floor, int hops);
+
+    //丢弃距起点超过 hops 跳的指针 (reach 未覆盖的视为超过)
+    void filter_by_reach(std::vector<pointer_data<T> *> &curr, int hops);
+
+    //多目标: 记录目标地址到编号(输入中的序号)的映射 重复地址取第一次出现的编号
+    //uniq 返回去重后按地址排序的目标 所有目标共用一次遍历
+    void set_chain_targets(std::vector<T> &addr, std::vector<T> &uniq);
+
+    //目标地址的编号 不是目标时返回 -1
+    int target_id_of(T address);
+
+    //是否有目标设置了负向余量 即第0层为区间 [lo, hi]
+    bool has_target_spans() const;
+
+    //区间目标: 第1层指针的值 v 落在 [lo - offset, hi] 即可 最后一跳输出 hi - v
+    //按所有区间端点把地址切成基本段 每段对应 out 中一段连续节点 (覆盖该段的区间的 hi)
+    //第1层用探测点 (每个区间内间隔不超过 offset) 复用 search_pointer 搜索
+    //落在静态模块的 hi 已在 ranges 第0层 不再向上搜索
+    void build_target_segments(std::vector<chainer::pointer_range<T>> &ranges, size_t offset, utils::mapqueue<pointer_dir<T>> &out);
+
+    //第1层索引: 按值所在的基本段取 [start, end)
+    template <class C>
+    void create_segment_index(C &curr, size_t avg, utils::task_group &jobs);
+
+    //按目标统计链数: 链数自顶向下沿 [start, end) 区间下传 (差分数组) 到第0层即为各目标的链数
+    void count_target_chains(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges);
+
+    //最短模式: 丢弃在更低层已出现过的指针
+    void drop_visited(std::vector<pointer_data<T> *> &curr);
+
+    //最短模式: 把第 level 层保留下来的节点按地址记为已访问 第0层为目标地址
+    void mark_visited(std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int level);
+
+    //最短模式: 清空已访问标记 重新标记 [from, to) 层 (续扫载入的层)
+    void reset_visited(std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int from, int to);
+
+    //打开扫描目录 兼容时载入已完成的层 返回下一个需要计算的层数
+    int resume_pointer_levels(level_store<T> &store, level_manifest<T> &manifest, std::vector<T> &addr, int depth, size_t offset, std::vector<utils::mapqueue<pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges);
+
+    beam_policy<T> beam; //束搜索策略 默认不启用
+
+    int bin_version = 101; //.bin 输出格式 101 或 2
+
+    bool bin_index = true; //.bin 之后追加链索引段
+
+    std::vector<offset_rule> offset_rules; //rules[i] 用于第 i + 1 层 超出的层用最后一条 空为 [0, offset]
+
+    std::string scan_dir; //层数据落盘目录 空为不落盘
+
+    T waypoint = 0; //途经地址 0为不限制
+    T waypoint_tolerance = 0;
+    std::vector<utils::mapqueue<uint8_t>> passed; //与 dirs 一一对应 节点所在的链是否已途经 waypoint
+    utils::mapqueue<uint8_t> waypoint_reach; //与 pcoll 一一对应 距途经地址的最少跳数 0xff 为未到达
+
+    cycle_mode cycles = CYCLE_KEEP; //环路处理 默认保留全部链
+    bool shortest = false; //本次扫描按最短模式裁剪 (.bin 输出时无环模式也退化为最短模式)
+    utils::mapqueue<uint8_t> visited; //与 pcoll 一一对应 最短模式下指针是否已在更低层出现 有途经地址时 bit0 未途经 bit1 已途经
+
+    std::string root_module; //起点模块 name 或 name[count] 空为不限制
+    utils::mapqueue<uint8_t> reach; //与 pcoll 一一对应 距起点模块的最少跳数 0xff 为未到达
+
+    std::vector<std::pair<T, uint32_t>> target_ids; //按地址排序的 (目标地址, 编号)
+    std::vector<size_t> target_counts; //每个目标编号的链数
+    std::vector<T> target_slack; //每个目标的负向余量 只有一个时用于全部目标
+    std::vector<T> target_lows; //与 target_ids 对应 区间目标的下界 精确目标为其地址
+    std::vector<pointer_dir<T>> target_segments; //基本段 address 为段起点 [start, end) 为第0层节点
+    std::vector<pointer_data<T>> target_probes; //第1层搜索的探测点 按地址排序
+
+    std::vector<memtool::vm_static_data *> statics; //本次扫描使用的静态模块
+    std::vector<std::unique_ptr<memtool::vm_static_data>> saved_statics; //续扫时从扫描目录载入的模块
 }; // about constructor or deconstructor ....
 
 } // namespace chainer
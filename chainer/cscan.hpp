@@ -2,6 +2,11 @@
 
 #include "cscan.h"
 
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <queue>
+
 static auto get_addr_by_bin_gt = [](auto &&dat, auto &&target) { return utils::address_of(dat)->address < target; };
 static auto get_addr_by_bin_lt = [](auto &&dat, auto &&target) { return utils::address_of(dat)->address <= target; };
 
@@ -45,6 +50,9 @@ void chainer::scan<T>::associate_data_index(P &prev, size_t offset, chainer::poi
 
     size = prev.size();
     for (auto i = 0ul; i < count; ++i) {
+        if ((i & 0xffff) == 0 && this->stopped())
+            return;
+
         data = &start[i];
         value = data->value;
 
@@ -57,7 +65,7 @@ void chainer::scan<T>::associate_data_index(P &prev, size_t offset, chainer::poi
 
 template <class T>
 template <class P, class C>
-void chainer::scan<T>::create_assoc_dir_index(P &prev, C &curr, size_t offset, size_t avg)
+void chainer::scan<T>::create_assoc_dir_index(P &prev, C &curr, size_t offset, size_t avg, utils::task_group &jobs)
 {
     pointer_dir<T> *start = &curr.front();
 
@@ -68,7 +76,7 @@ void chainer::scan<T>::create_assoc_dir_index(P &prev, C &curr, size_t offset, s
     
     // Lambda: 分块提交任务到线程池
     auto push_pool = [&](size_t block_size) {
-        utils::thread_pool->pushpool(assoc_index, start, block_size);
+        utils::thread_pool->post(jobs, assoc_index, start, block_size);
         start += block_size;
     };
 
@@ -76,6 +84,93 @@ void chainer::scan<T>::create_assoc_dir_index(P &prev, C &curr, size_t offset, s
     utils::split_num_to_avg(curr.size(), avg, push_pool);
 }
 
+template <class T>
+template <class P, class C>
+void chainer::scan<T>::create_rule_dir_index(P &prev, C &curr, const offset_rule &rule, size_t avg, utils::task_group &jobs)
+{
+    size_t size = prev.size();
+    size_t blocks = DIV_ROUND_UP(curr.size(), avg);
+    std::vector<size_t> runs(blocks + 1, 0);
+
+    // 对 [begin, begin + count) 的每个节点 按地址顺序列出满足规则的子节点的连续段
+    // emit 为空时只计数 否则按段写出节点
+    auto scan_runs = [this, &prev, &curr, &rule, size](size_t begin, size_t count, size_t *counter, pointer_dir<T> *emit) {
+        size_t n = 0;
+        for (size_t i = begin; i < begin + count; ++i) {
+            if (((i - begin) & 0xffff) == 0 && this->stopped())
+                break;
+
+            auto &data = curr[i];
+            T low = data.value > rule.floor ? data.value - rule.floor : 0;
+            int lower, upper;
+            utils::binary_search(prev, get_addr_by_bin_gt, low, size, lower, upper);
+
+            uint32_t first = 0, last = 0;
+            for (size_t k = lower; k <= size; ++k) {
+                long d = k < size ? signed_offset<T>(utils::address_of(prev[k])->address - data.value) : 0;
+                bool end = k == size || d > (long)rule.max;
+                if (!end && rule.accept(d)) {
+                    if (first == last)
+                        first = k;
+                    last = k + 1;
+                    continue;
+                }
+                // 一段结束
+                if (first != last) {
+                    if (emit != nullptr)
+                        emit[n] = pointer_dir<T>(data.address, data.value, first, last);
+                    ++n;
+                    first = last = 0;
+                }
+                if (end)
+                    break;
+            }
+        }
+        *counter = n;
+    };
+
+    // 第一遍计数 第二遍写到各块的输出位置
+    size_t begin = 0, block = 0;
+    auto count_pool = [&](size_t count) {
+        utils::thread_pool->post(jobs, scan_runs, begin, count, &runs[++block], nullptr);
+        begin += count;
+    };
+    utils::split_num_to_avg(curr.size(), avg, count_pool);
+    utils::thread_pool->wait(jobs);
+
+    for (size_t i = 1; i <= blocks; ++i)
+        runs[i] += runs[i - 1];
+
+    C out;
+    out.resize(runs[blocks]);
+    if (runs[blocks] > 0) {
+        std::vector<size_t> written(blocks);
+        begin = 0, block = 0;
+        auto write_pool = [&](size_t count) {
+            utils::thread_pool->post(jobs, scan_runs, begin, count, &written[block], &out[runs[block]]);
+            begin += count, ++block;
+        };
+        utils::split_num_to_avg(curr.size(), avg, write_pool);
+        utils::thread_pool->wait(jobs);
+    }
+
+    curr.swap(out);
+}
+
+template <class T>
+chainer::offset_rule chainer::scan<T>::rule_of(int level, size_t offset) const
+{
+    offset_rule rule;
+    if (!offset_rules.empty())
+        rule = offset_rules[std::min<size_t>(std::max(level, 1) - 1, offset_rules.size() - 1)];
+    if (rule.max == 0)
+        rule.max = offset;
+    if (rule.align == 0)
+        rule.align = 1;
+    std::sort(rule.whitelist.begin(), rule.whitelist.end());
+    return rule;
+}
+
 template <class T>
 void chainer::scan<T>::get_results(std::vector<pointer_data<T> *> &list, std::vector<pointer_data<T> *> &save, T start, T end)
 {
@@ -105,8 +200,8 @@ void chainer::scan<T>::filter_pointer_ranges(
 
     auto comp = [](auto x, auto y) { return x->address < y->address; };
 
-    for (auto vma : memtool::extend::vm_static_list) {
-        if (vma->filter)
+    for (auto vma : statics) {
+        if (vma->filter || !is_root_module(vma))
             continue;
 
         decltype(chainer::pointer_range<T>::results) asc;
@@ -249,6 +344,23 @@ void chainer::scan<T>::integr_data_to_file(std::vector<utils::mapqueue<chainer::
     cprog_sym<T> sym;
     cprog_llen llen;
 
+    // 两种格式读取时都是 v101 布局 计数超出时不写出 不截断
+    for (auto &r : ranges) {
+        if (r.results.size() > INT_MAX) {
+            printf("模块 %s 的指针数 %ld 超出 .bin 格式上限, 未写入\n", r.vma->name, r.results.size());
+            return;
+        }
+    }
+    for (size_t i = 0; i < contents.size() - 1; i++) {
+        if (contents[i].size() > UINT32_MAX) {
+            printf("第 %ld 层节点数 %ld 超出 .bin 格式上限, 未写入\n", i, contents[i].size());
+            return;
+        }
+    }
+
+    if (bin_version == 2)
+        return integr_data_to_file_v2(contents, ranges, f);
+
     // 第一部分：写入文件头
     header.size = sizeof(T);
     header.version = 101;
@@ -293,75 +405,215 @@ void chainer::scan<T>::integr_data_to_file(std::vector<utils::mapqueue<chainer::
 }
 
 template <class T>
-void chainer::scan<T>::integr_data_to_txt(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f)
+void chainer::scan<T>::integr_data_to_file_v2(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f)
 {
-    if (f == nullptr || ranges.empty()) {
+    chainer::cprog_packer pack(f, sizeof(T));
+    size_t levels = contents.size() - 1;
+
+    // 目录: 模块信息和每层节点数
+    pack.put(ranges.size());
+    pack.put(levels);
+    for (auto &r : ranges) {
+        pack.put(r.vma->start);
+        pack.put_bytes(r.vma->name, strlen(r.vma->name));
+        pack.put_signed(r.vma->range);
+        pack.put_signed(r.vma->count);
+        pack.put(r.level);
+        pack.put(r.results.size());
+    }
+    for (size_t i = 0; i < levels; ++i)
+        pack.put(contents[i].size());
+
+    // 节点: 地址和值与上一个节点差分 start 与上一个节点的 end 差分 只存长度不存 end
+    T address, value;
+    uint32_t end;
+    auto put_node = [&](const chainer::pointer_dir<T> &dir) {
+        pack.put_signed(signed_offset<T>(dir.address - address));
+        pack.put_signed(signed_offset<T>(dir.value - value));
+        pack.put_signed((int64_t)dir.start - (int64_t)end);
+        pack.put(dir.end - dir.start);
+        address = dir.address, value = dir.value, end = dir.end;
+    };
+
+    for (auto &r : ranges) {
+        address = r.vma->start, value = 0, end = 0;
+        for (auto &dir : r.results)
+            put_node(dir);
+    }
+    for (size_t i = 0; i < levels; ++i) {
+        address = 0, value = 0, end = 0;
+        auto &content = contents[i];
+        for (size_t j = 0; j < content.size(); ++j)
+            put_node(*content[j]);
+    }
+
+    if (!pack.finish())
+        printf("写入二进制指针链失败\n");
+}
+
+template <class T>
+void chainer::scan<T>::integr_index_to_file(std::vector<utils::mapqueue<size_t>> &counts, std::vector<chainer::pointer_range<T>> &ranges, FILE *f)
+{
+    fflush(f);
+    off_t offset = ftello(f);
+    if (offset < 0) {
+        printf("输出不支持定位, 不写入链索引\n");
         return;
     }
 
-    char buffer[1024];
-    std::atomic_size_t total_chains(0);
-
-    // Lambda: 递归输出指针链
-    // 这个 lambda 使用立即调用的 lambda 表达式 (IIFE) 来实现递归
-    auto output_chain_recursive = [&contents](FILE *out_file, char *buf, int level, chainer::pointer_dir<T> *dir) {
-        // 递归实现函数
-        auto recursive_impl = [&contents](FILE *out_file, char *buf, int level, 
-                                         chainer::pointer_dir<T> *dir, auto &self_ref) -> size_t {
-            if (level == 0) {
-                // 基础情况：到达最底层，输出完整链
-                strcat(buf, "\n");
-                fwrite(buf, strlen(buf), 1, out_file);
-                return 1;
-            }
-            
-            // 递归情况：遍历子节点
-            size_t chain_count = 0;
-            char *write_position = buf + strlen(buf);
-            
-            for (uint32_t i = dir->start; i < dir->end; ++i) {
-                *write_position = '\0';  // 重置写入位置
-                auto *child_dir = contents[level - 1][i];
-                
-                // 添加偏移信息到缓冲区
-                sprintf(write_position, " -> + 0x%lX", 
-                       static_cast<size_t>(child_dir->address - dir->value));
-                
-                // 递归处理子节点
-                chain_count += self_ref(out_file, buf, level - 1, child_dir, self_ref);
-            }
-            
-            return chain_count;
-        };
-        
-        // 启动递归
-        return recursive_impl(out_file, buf, level, dir, recursive_impl);
+    size_t levels = counts.size() - 1;
+    std::vector<uint64_t> buf;
+    bool error = false;
+    auto put = [&](uint64_t v) {
+        buf.push_back(v);
+        if (buf.size() == 1 << 16) {
+            error = fwrite(buf.data(), sizeof(uint64_t), buf.size(), f) != buf.size() || error;
+            buf.clear();
+        }
+    };
+
+    cprog_index_header header;
+    memcpy(header.magic, cprog_index_magic, sizeof(header.magic));
+    header.version = 1;
+    header.level = levels;
+    header.module_count = ranges.size();
+    header.chains = 0;
+    for (auto &r : ranges) {
+        auto &level_count = counts[r.level];
+        for (auto &v : r.results)
+            header.chains += level_count[v.end] - level_count[v.start];
+    }
+    error = fwrite(&header, sizeof(header), 1, f) != 1;
+
+    // 第 i 层的前缀链数即 counts[i + 1]
+    for (size_t i = 0; i < levels; ++i) {
+        auto &level_count = counts[i + 1];
+        for (size_t j = 0; j < level_count.size(); ++j)
+            put(level_count[j]);
+    }
+
+    for (auto &r : ranges) {
+        auto &level_count = counts[r.level];
+        uint64_t sum = 0;
+        put(sum);
+        for (auto &v : r.results)
+            put(sum += level_count[v.end] - level_count[v.start]);
+    }
+
+    if (!buf.empty())
+        error = fwrite(buf.data(), sizeof(uint64_t), buf.size(), f) != buf.size() || error;
+
+    cprog_index_tail tail;
+    tail.offset = offset;
+    memcpy(tail.magic, cprog_index_magic, sizeof(tail.magic));
+    error = fwrite(&tail, sizeof(tail), 1, f) != 1 || error;
+    fflush(f);
+
+    if (error)
+        printf("写入链索引失败\n");
+}
+
+template <class T>
+size_t chainer::scan<T>::integr_data_to_txt(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, FILE *f, const std::vector<offset_rule> *hops)
+{
+    if (f == nullptr || ranges.empty()) {
+        return 0;
+    }
+
+    size_t total_chains = 0;
+
+    // 无环模式按写出的链重新统计每个目标的链数
+    if (hops != nullptr)
+        std::fill(target_counts.begin(), target_counts.end(), 0);
+
+    auto child = [&contents](int level, uint32_t i) -> const chainer::pointer_dir<T> & { return *contents[level][i]; };
+
+    // 多目标时在行尾追加目标编号 " #id"
+    bool tagged = target_ids.size() > 1;
+    auto leaf = [this, tagged, hops](char *p, const chainer::pointer_dir<T> &dir) {
+        if (!tagged && hops == nullptr)
+            return p;
+        int id = target_id_of(dir.address);
+        if (hops != nullptr && id >= 0)
+            ++target_counts[id];
+        if (tagged) {
+            memcpy(p, " #", 2);
+            p = id < 0 ? put_str(p + 2, "-1") : put_dec(p + 2, id);
+        }
+        return p;
+    };
+
+    // 无环模式: 子节点 child 是否使当前链重复经过同一地址 (节点地址相同或指向同一结构体)
+    // 或者起点直接可达 child (同一起点已有以 child 开头的更短链 本链是冗余的)
+    // 有途经地址时更短的链可能不经过途经地址 不按后缀折叠 逐链过滤时链长无法预知 单线程输出
+    int top = 0;
+    auto redundant = [this, &top, hops](int level, const chainer::pointer_dir<T> &child, const chainer::pointer_dir<T> *const *path) {
+        for (int k = level; k <= top; ++k) {
+            if (path[k]->address == child.address || (level > 1 && path[k]->value == child.value))
+                return true;
+        }
+        return waypoint == 0 && level < top && hop_reaches(path[top]->value, child.address, level, (*hops)[level]);
     };
 
+    // 不过滤时每条链的长度可预先算出 按根节点的输出区间并行写入
+    if (hops == nullptr) {
+        std::vector<chainer::chain_group<T>> groups;
+        for (auto &range : ranges) {
+            printf("写入指针链 %s[%d] at level %d, 数量: %ld\n", 
+                   range.vma->name, range.vma->count, range.level, range.results.size());
+            groups.push_back(chainer::chain_group<T>{range.vma->name, range.vma->count, (T)range.vma->start, range.level, range.results.begin(), range.results.size()});
+        }
+
+        std::vector<size_t> widths;
+        for (auto &c : contents)
+            widths.emplace_back(c.size());
+
+        total_chains = chainer::write_chains_parallel(f, groups, widths, child, leaf, this->control);
+        fflush(f);
+        printf("写入文本指针链总数: %ld\n", total_chains);
+        return total_chains;
+    }
+
     // 遍历每个模块范围
+    chainer::chain_emitter<T> emitter(f);
     for (auto &range : ranges) {
         printf("写入指针链 %s[%d] at level %d, 数量: %ld\n", 
                range.vma->name, range.vma->count, range.level, range.results.size());
+        top = range.level;
         
         // 遍历该模块中的每个指针数据
         for (auto &pointer_dir : range.results) {
-            // 重置缓冲区
-            buffer[0] = '\0';
-            
-            // 输出起始部分: 模块名[编号] + 0x偏移
-            sprintf(buffer, "%s[%d] + 0x%lX", 
-                   range.vma->name, 
-                   range.vma->count, 
-                   static_cast<size_t>(pointer_dir.address - range.vma->start));
-            
-            // 递归输出完整的指针链
-            size_t chains = output_chain_recursive(f, buffer, range.level, &pointer_dir);
-            total_chains += chains;
+            if (this->control != nullptr && this->control->cancelled())
+                break;
+
+            // 链头: 模块名[编号] + 0x偏移 之后非递归展开整棵子树
+            char *line = emitter.begin(range.level);
+            char *p = put_head(line, range.vma->name, range.vma->count, pointer_dir.address - range.vma->start);
+            total_chains += emitter.expand(p - line, range.level, pointer_dir, child, leaf, redundant);
         }
     }
 
+    emitter.flush();
     fflush(f);
-    printf("写入文本指针链总数: %ld\n", total_chains.load());
+    printf("写入文本指针链总数: %ld\n", total_chains);
+    return total_chains;
+}
+
+template <class T>
+bool chainer::scan<T>::hop_reaches(T value, T address, int level, const offset_rule &hop)
+{
+    // 区间目标的第1跳: 值落在 [lo - max, hi] 即可
+    if (level == 1 && has_target_spans()) {
+        auto it = std::lower_bound(target_ids.begin(), target_ids.end(), address, [](auto &x, T t) { return x.first < t; });
+        if (it == target_ids.end() || it->first != address)
+            return false;
+        T low = target_lows[it - target_ids.begin()];
+        return value <= address && value >= (low > hop.max ? low - hop.max : 0);
+    }
+
+    if (hop.trivial())
+        return (T)(address - value) <= hop.max;
+    return hop.accept(signed_offset<T>(address - value));
 }
 
 template <class T>
@@ -373,8 +625,8 @@ chainer::chain_info<T> chainer::scan<T>::build_pointer_dirs_tree(std::vector<uti
     std::vector<utils::mapqueue<size_t>> counts(max_level + 1);
     std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> contents(max_level + 1);
 
-    // 复用缓存作为临时存储
-    auto &temp_storage = reinterpret_cast<utils::mapqueue<chainer::pointer_dir<T> *> &>(this->cache);
+    // 每层待合并节点的临时存储 (search 的缓存元素类型不同 不能复用)
+    utils::mapqueue<chainer::pointer_dir<T> *> temp_storage;
 
     // 构建范围映射：按层级分组
     for (auto &range : ranges) {
@@ -397,3 +649,857 @@ chainer::chain_info<T> chainer::scan<T>::build_pointer_dirs_tree(std::vector<uti
     // 返回构建结果（使用移动语义）
     return {std::move(counts), std::move(contents)};
 }
+
+template <class T>
+void chainer::scan<T>::prune_pointer_dirs(utils::mapqueue<chainer::pointer_dir<T>> &prev, utils::mapqueue<chainer::pointer_dir<T>> &curr, std::vector<double> &weights, size_t offset, int level)
+{
+    size_t size = curr.size();
+    std::vector<double> prefix(prev.size() + 1, 0.0);
+    std::vector<double> chains(size);
+
+    // 节点链数 = 子节点区间 [start, end) 的链数之和 用上一层的前缀和求
+    for (size_t i = 0; i < prev.size(); ++i) {
+        prefix[i + 1] = prefix[i] + weights[i];
+    }
+    for (size_t i = 0; i < size; ++i) {
+        chains[i] = prefix[curr[i].end] - prefix[curr[i].start];
+    }
+
+    if (size <= beam.width) {
+        weights.swap(chains);
+        return;
+    }
+
+    auto &avec = memtool::extend::vm_area_vec;
+    size_t vsize = avec.size();
+    double max_chain = log2(1.0 + *std::max_element(chains.begin(), chains.end()));
+    std::vector<double> scores(size);
+
+    // Lambda: 内存区域得分 静态数据/bss 最稳定 其次匿名内存 堆最易变动
+    auto region_score = [](int range) {
+        if (range & (memtool::C_data | memtool::C_bss))
+            return 1.0;
+        if (range & memtool::Anonymous)
+            return 0.6;
+        if (range & (memtool::C_alloc | memtool::C_heap))
+            return 0.3;
+        return 0.0;
+    };
+
+    // Lambda: 为 [begin, begin + count) 的节点评分
+    auto score_block = [&](size_t begin, size_t count) {
+        int lower, upper;
+
+        for (size_t i = begin; i < begin + count; ++i) {
+            auto &dir = curr[i];
+            if (beam.scorer) {
+                scores[i] = beam.scorer(dir, level, chains[i]);
+                continue;
+            }
+
+            // 子节点按地址有序 绝对值最小的偏移在 value 两侧的两个子节点之一
+            double min_offset = (double)offset;
+            if (dir.start < dir.end) {
+                auto first = &prev[dir.start], last = first + (dir.end - dir.start);
+                auto k = std::lower_bound(first, last, dir.value, [](auto &x, T v) { return x.address < v; });
+                if (k != last)
+                    min_offset = (double)(T)(k->address - dir.value);
+                if (k != first)
+                    min_offset = std::min(min_offset, (double)(T)(dir.value - (k - 1)->address));
+            }
+            double score = beam.offset_weight * (1.0 - min_offset / (offset + 1.0));
+            if (max_chain > 0)
+                score += beam.chain_weight * log2(1.0 + chains[i]) / max_chain;
+
+            utils::binary_search(avec, get_pointer_by_bin_gt, dir.address, vsize, lower, upper);
+            if ((size_t)lower < vsize && dir.address >= avec[lower]->start)
+                score += beam.region_weight * region_score(avec[lower]->range);
+
+            scores[i] = score;
+        }
+    };
+
+    utils::task_group jobs;
+    size_t begin = 0;
+    auto push_pool = [&](size_t block_size) {
+        utils::thread_pool->post(jobs, score_block, begin, block_size);
+        begin += block_size;
+    };
+    utils::split_num_to_avg(size, 10000, push_pool);
+    utils::thread_pool->wait(jobs);
+
+    // 取评分最高的 width 个节点 再按下标排序以保持本层按地址有序
+    std::vector<uint32_t> order(size);
+    for (size_t i = 0; i < size; ++i) {
+        order[i] = i;
+    }
+    std::nth_element(order.begin(), order.begin() + beam.width, order.end(),
+                     [&scores](auto x, auto y) { return scores[x] > scores[y]; });
+    order.resize(beam.width);
+    std::sort(order.begin(), order.end());
+
+    weights.resize(beam.width);
+    for (size_t i = 0; i < beam.width; ++i) {
+        curr[i] = curr[order[i]];
+        weights[i] = chains[order[i]];
+    }
+    curr.resize(beam.width);
+
+    printf("束搜索: 第 %d 层保留 %ld / %ld 节点\n", level, beam.width, size);
+}
+
+template <class T>
+void chainer::scan<T>::select_top_chains(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges, std::vector<std::vector<pointer_dir<T>>> &nodes)
+{
+    // 搜索中的部分链 沿 parent 回溯可得到完整路径
+    struct chain_step {
+        double cost;   // 已走偏移和 + 剩余最小偏移和
+        double walked; // 已走偏移和
+        int level;
+        int depth;     // 根节点层数 即链长度
+        size_t range;
+        pointer_dir<T> *dir;
+        size_t parent;
+    };
+
+    int max_level = contents.size() - 1;
+    auto hop = [](pointer_dir<T> *parent, pointer_dir<T> *child) { return (double)std::labs(signed_offset<T>(child->address - parent->value)); };
+
+    // 每个节点到目标的最小偏移和 作为最优优先搜索的精确启发值
+    std::vector<std::vector<double>> rest(max_level + 1);
+    auto rest_of = [&](int level, pointer_dir<T> *dir) {
+        if (level == 0)
+            return 0.0;
+
+        double best = std::numeric_limits<double>::max();
+        for (auto i = dir->start; i < dir->end; ++i)
+            best = std::min(best, hop(dir, contents[level - 1][i]) + rest[level - 1][i]);
+        return best;
+    };
+
+    rest[0].assign(contents[0].size(), 0.0);
+    for (int level = 1; level <= max_level; ++level) {
+        rest[level].resize(contents[level].size());
+        for (size_t i = 0; i < contents[level].size(); ++i)
+            rest[level][i] = rest_of(level, contents[level][i]);
+    }
+
+    std::vector<chain_step> steps;
+    auto worse = [this, &steps](size_t x, size_t y) {
+        auto &a = steps[x], &b = steps[y];
+        if (beam.order == CHAIN_SHORTEST && a.depth != b.depth)
+            return a.depth > b.depth;
+        if (a.cost != b.cost)
+            return a.cost > b.cost;
+        return a.depth > b.depth;
+    };
+
+    // 按模块分组 每个模块独立选出 topk 条链
+    std::vector<std::vector<std::vector<pointer_dir<T> *>>> paths(ranges.size());
+    std::vector<memtool::vm_static_data *> modules;
+    for (auto &r : ranges) {
+        if (std::find(modules.begin(), modules.end(), r.vma) == modules.end())
+            modules.emplace_back(r.vma);
+    }
+
+    for (auto vma : modules) {
+        size_t found = 0;
+        std::priority_queue<size_t, std::vector<size_t>, decltype(worse)> queue(worse);
+
+        steps.clear();
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            if (ranges[r].vma != vma)
+                continue;
+
+            for (auto &root : ranges[r].results) {
+                double h = rest_of(ranges[r].level, &root);
+                steps.push_back({h, 0.0, ranges[r].level, ranges[r].level, r, &root, SIZE_MAX});
+                queue.push(steps.size() - 1);
+            }
+        }
+
+        while (!queue.empty() && found < beam.topk) {
+            size_t idx = queue.top();
+            queue.pop();
+
+            auto step = steps[idx];
+            if (step.level == 0) {
+                std::vector<pointer_dir<T> *> path;
+                for (auto i = idx; i != SIZE_MAX; i = steps[i].parent)
+                    path.emplace_back(steps[i].dir);
+                std::reverse(path.begin(), path.end());
+                paths[step.range].emplace_back(std::move(path));
+                ++found;
+                continue;
+            }
+
+            auto &child_level = contents[step.level - 1];
+            for (auto i = step.dir->start; i < step.dir->end; ++i) {
+                double walked = step.walked + hop(step.dir, child_level[i]);
+                steps.push_back({walked + rest[step.level - 1][i], walked, step.level - 1, step.depth, step.range, child_level[i], idx});
+                queue.push(steps.size() - 1);
+            }
+        }
+
+        printf("束搜索: %s[%d] 选出 %ld 条链\n", vma->name, vma->count, found);
+    }
+
+    // 用选出的路径重建一棵前缀树 相同前缀共享节点
+    nodes.assign(max_level + 1, {});
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        auto &list = paths[r];
+        decltype(ranges[r].results) roots;
+
+        std::sort(list.begin(), list.end());
+
+        // groups: (节点在 roots 或 nodes[level] 中的下标, 共享该前缀的路径区间 [first, last))
+        std::vector<std::pair<size_t, std::pair<size_t, size_t>>> groups, next;
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i == 0 || list[i][0] != list[i - 1][0]) {
+                roots.emplace_back(*list[i][0]);
+                groups.push_back({roots.size() - 1, {i, i}});
+            }
+            groups.back().second.second = i + 1;
+        }
+
+        for (int level = ranges[r].level - 1; level >= 0; --level) {
+            size_t pos = ranges[r].level - level;
+
+            next.clear();
+            for (auto &[index, span] : groups) {
+                auto &parent = pos == 1 ? roots[index] : nodes[level + 1][index];
+                parent.start = nodes[level].size();
+
+                for (auto i = span.first; i < span.second; ++i) {
+                    if (i == span.first || list[i][pos] != list[i - 1][pos]) {
+                        nodes[level].emplace_back(*list[i][pos]);
+                        next.push_back({nodes[level].size() - 1, {i, i}});
+                    }
+                    next.back().second.second = i + 1;
+                }
+
+                parent.end = nodes[level].size();
+            }
+            groups.swap(next);
+        }
+
+        ranges[r].results = std::move(roots);
+    }
+
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](auto &r) { return r.results.empty(); }), ranges.end());
+
+    std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> tree(max_level + 1);
+    for (int level = 0; level <= max_level; ++level) {
+        for (auto &dir : nodes[level])
+            tree[level].emplace_back(&dir);
+    }
+    contents.swap(tree);
+}
+
+template <class T>
+int chainer::scan<T>::resume_pointer_levels(chainer::level_store<T> &store, chainer::level_manifest<T> &manifest, std::vector<T> &addr, int depth, size_t offset, std::vector<utils::mapqueue<chainer::pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges)
+{
+    std::vector<T> targets(addr);
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+    // 偏移规则的签名 与偏移一起决定第1层以后的结果
+    std::string rules;
+    for (auto &rule : offset_rules)
+        rules += (rules.empty() ? "" : ";") + rule.signature();
+
+    // 区间目标的第0层由基本段组成 与偏移有关
+    bool spans = has_target_spans();
+    std::vector<T> lows;
+    if (spans)
+        lows = target_lows;
+
+    auto fresh = [&]() {
+        for (auto &d : dirs)
+            d.clear();
+        ranges.clear();
+        saved_statics.clear();
+        statics.assign(memtool::extend::vm_static_list.begin(), memtool::extend::vm_static_list.end());
+
+        manifest = level_manifest<T>();
+        manifest.offset = offset;
+        manifest.waypoint = waypoint;
+        manifest.waypoint_tolerance = waypoint_tolerance;
+        manifest.root = root_module;
+        manifest.scan_depth = depth;
+        manifest.targets = targets;
+        manifest.lows = lows;
+        manifest.rules = rules;
+        manifest.shortest = shortest;
+        manifest.pointers = this->pcoll.size();
+        if (!store.save_pointers(this->pcoll) || !store.save_modules(statics) || !store.save_manifest(manifest))
+            printf("扫描目录写入失败, 本次不落盘\n");
+        return 0;
+    };
+
+    level_manifest<T> old;
+    if (!store.load_manifest(old) || old.size != (int)sizeof(T) || old.targets != targets || old.lows != lows || old.depth < 0 ||
+        old.waypoint != waypoint || old.waypoint_tolerance != waypoint_tolerance || old.root != root_module)
+        return fresh();
+
+    // 续扫必须使用落盘时的指针快照和模块列表 已完成的层才能对上
+    decltype(this->pcoll) snapshot;
+    if (!store.load_pointers(snapshot) || snapshot.size() != old.pointers || !store.load_modules(saved_statics))
+        return fresh();
+
+    statics.clear();
+    for (auto &vma : saved_statics)
+        statics.emplace_back(vma.get());
+
+    // 第0层与偏移无关 偏移 偏移规则或最短模式改变时只复用第0层 (区间目标时第0层也要重算)
+    bool window = old.offset != offset || old.rules != rules || old.shortest != shortest;
+    int last = !window ? std::min(old.depth, depth) : (spans ? -1 : 0);
+
+    // 起点模块按深度过滤后半程的层 深度改变时只复用两次都未过滤的层
+    bool refilter = !root_module.empty() && old.scan_depth != depth;
+    if (refilter)
+        last = std::min(last, std::max(0, std::min(old.scan_depth - old.scan_depth / 2, depth - depth / 2) - 1));
+
+    // 途经地址按剩余层数丢弃未途经的节点 加深时第1层以后丢弃过的节点可能又有用了
+    bool rewaypoint = waypoint != 0 && old.scan_depth < depth;
+    if (rewaypoint)
+        last = std::min(last, 0);
+
+    for (int level = 0; level <= last; ++level) {
+        if (!store.load_level(level, dirs[level], ranges, statics))
+            return fresh();
+    }
+
+    this->pcoll.swap(snapshot);
+    this->cache.shrink();
+    this->cache.reserve(this->pcoll.size());
+
+    manifest = old;
+    manifest.scan_depth = depth;
+    if (refilter || rewaypoint)
+        manifest.exhausted = false;
+    if (manifest.waypoint_level > last)
+        manifest.waypoint_level = -1;
+    if (old.shortest != shortest)
+        printf("最短模式%s, 复用指针快照%s 重新搜索后续层\n", shortest ? "开启" : "关闭", spans ? "" : "和第0层");
+    else if (window)
+        printf("偏移由 0x%zx%s 变为 0x%zx%s, 复用指针快照%s 重新搜索后续层\n", old.offset, old.rules.empty() ? "" : " (按层规则)",
+               offset, rules.empty() ? "" : " (按层规则)", spans ? "" : "和第0层");
+    else
+        printf("从扫描目录载入 [0, %d] 层 (已完成 %d 层%s)\n", last, old.depth, old.exhausted ? " 已无更深指针" : "");
+
+    // 之后的层要重新计算 清单先回退 避免中途被杀后载入旧数据
+    manifest.offset = offset;
+    manifest.rules = rules;
+    manifest.shortest = shortest;
+    if ((window || refilter || rewaypoint) && manifest.depth > last) {
+        manifest.depth = last;
+        manifest.exhausted = false;
+        store.save_manifest(manifest);
+    }
+
+    if (manifest.exhausted && last == manifest.depth)
+        return depth + 1;
+    return last + 1;
+}
+
+template <class T>
+bool chainer::scan<T>::near_waypoint(T x) const
+{
+    return x != 0 && (x >= waypoint ? x - waypoint : waypoint - x) <= waypoint_tolerance;
+}
+
+template <class T>
+size_t chainer::scan<T>::split_by_waypoint(std::vector<utils::mapqueue<chainer::pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int level, int depth)
+{
+    // 区间目标的第0层节点是基本段 地址不是真实的目标 不检查
+    bool segments = level == 0 && has_target_spans();
+    auto hit = [this](const pointer_dir<T> &d) { return near_waypoint(d.address) || near_waypoint(d.value); };
+
+    // 上一层已途经节点数的前缀和 子节点区间内状态一致时不用逐个检查
+    std::vector<uint32_t> before(1, 0);
+    if (level > 0) {
+        auto &prev = passed[level - 1];
+        before.resize(prev.size() + 1);
+        for (size_t i = 0; i < prev.size(); ++i)
+            before[i + 1] = before[i] + prev[i];
+    }
+
+    auto &pcoll = this->pcoll;
+    auto first = pcoll.begin(), last = pcoll.begin() + pcoll.size();
+    auto index_of = [first, last](T address) {
+        auto it = std::lower_bound(first, last, address, [](const pointer_data<T> &dat, T t) { return dat.address < t; });
+        return it != last && it->address == address ? (size_t)(it - first) : SIZE_MAX;
+    };
+
+    // 未途经的节点 剩余层数内到不了途经地址时丢弃 第0层的目标不一定是指针 只在没有剩余层数时丢弃
+    auto hopeless = [&](size_t index) {
+        if (level == 0)
+            return depth == 0;
+        return index == SIZE_MAX || waypoint_reach[index] > depth - level;
+    };
+
+    // 最短模式: 同一指针同一状态已在更低层出现
+    auto seen = [&](size_t index, uint8_t state) {
+        return shortest && index != SIZE_MAX && (visited[index] >> state & 1) != 0;
+    };
+
+    // 把 d 按子节点的状态拆成连续段写入 out roots 为静态指针 只保留已途经的段
+    size_t kept[2] = {0, 0};
+    auto split = [&](const pointer_dir<T> &d, bool roots, auto &out, utils::mapqueue<uint8_t> *flags) {
+        size_t index = level > 0 || shortest ? index_of(d.address) : SIZE_MAX;
+        auto emit = [&](uint8_t state, uint32_t start, uint32_t end) {
+            if ((state == 0 && (roots || hopeless(index))) || seen(index, state))
+                return;
+            out.emplace_back(d.address, d.value, start, end);
+            if (flags != nullptr)
+                flags->emplace_back(state);
+            ++kept[state];
+        };
+
+        if (!(segments && !roots) && hit(d)) {
+            emit(1, d.start, d.end);
+            return;
+        }
+        if (level == 0) {
+            emit(0, d.start, d.end);
+            return;
+        }
+
+        uint32_t count = before[d.end] - before[d.start];
+        if (count == 0 || count == d.end - d.start) {
+            emit(count != 0, d.start, d.end);
+            return;
+        }
+
+        auto &prev = passed[level - 1];
+        uint32_t start = d.start;
+        for (uint32_t k = d.start + 1; k <= d.end; ++k) {
+            if (k == d.end || prev[k] != prev[start]) {
+                emit(prev[start], start, k);
+                start = k;
+            }
+        }
+    };
+
+    auto &curr = dirs[level];
+    utils::mapqueue<pointer_dir<T>> out;
+    utils::mapqueue<uint8_t> flags;
+    out.reserve(curr.size());
+    flags.reserve(curr.size());
+    for (size_t i = 0; i < curr.size(); ++i)
+        split(curr[i], false, out, &flags);
+    size_t nodes[2] = {kept[0], kept[1]};
+    curr.swap(out);
+    passed[level].swap(flags);
+
+    kept[0] = kept[1] = 0;
+    for (auto &r : ranges) {
+        if (r.level != level)
+            continue;
+        decltype(r.results) roots;
+        for (size_t i = 0; i < r.results.size(); ++i)
+            split(r.results[i], true, roots, nullptr);
+        r.results.swap(roots);
+    }
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(),
+        [level](auto &r) { return r.level == level && r.results.empty(); }), ranges.end());
+
+    printf("%d: 途经地址 0x%lx 已途经 %ld 节点 %ld 静态指针 未途经 %ld 节点\n", level, (size_t)waypoint, nodes[1], kept[1], nodes[0]);
+    return nodes[1] + kept[1];
+}
+
+template <class T>
+void chainer::scan<T>::mark_passed(std::vector<utils::mapqueue<chainer::pointer_dir<T>>> &dirs, int level)
+{
+    bool segments = level == 0 && has_target_spans();
+    auto &curr = dirs[level];
+    auto &flags = passed[level];
+
+    flags.resize(curr.size(), 0);
+    for (size_t i = 0; i < curr.size(); ++i) {
+        auto &d = curr[i];
+        bool hit = !segments && (near_waypoint(d.address) || near_waypoint(d.value));
+        flags[i] = hit || (level > 0 && d.start < d.end && passed[level - 1][d.start] != 0);
+    }
+}
+
+template <class T>
+bool chainer::scan<T>::is_root_module(memtool::vm_static_data *vma)
+{
+    if (root_module.empty())
+        return true;
+
+    // name[count] 精确到第几段 只写 name 时同名的 :bss 段也算
+    std::string name(vma->name);
+    return root_module == name || root_module == name + "[" + std::to_string(vma->count) + "]" ||
+           (root_module.find(':') == std::string::npos && root_module + ":bss" == name);
+}
+
+template <class T>
+void chainer::scan<T>::forward_reach(size_t offset, size_t floor, int hops)
+{
+    auto &pcoll = this->pcoll;
+    size_t size = pcoll.size();
+    auto first = pcoll.begin(), last = pcoll.begin() + size;
+    auto comp = [](const pointer_data<T> &dat, T address) { return dat.address < address; };
+
+    reach.clear();
+    reach.resize(size, 0xff);
+
+    // 第0跳: 起点模块内的静态指针
+    std::vector<size_t> frontier;
+    for (auto vma : statics) {
+        if (vma->filter || !is_root_module(vma))
+            continue;
+
+        size_t lower = std::lower_bound(first, last, (T)vma->start, comp) - first;
+        size_t upper = std::lower_bound(first, last, (T)vma->end, comp) - first;
+        for (auto i = lower; i < upper; ++i) {
+            if (reach[i] != 0) {
+                reach[i] = 0;
+                frontier.emplace_back(i);
+            }
+        }
+    }
+    printf("正向扩展第 0 层: %ld 指针\n", frontier.size());
+
+    expand_reach(frontier, reach, offset, floor, hops);
+}
+
+template <class T>
+void chainer::scan<T>::waypoint_forward_reach(size_t offset, size_t floor, int hops)
+{
+    auto &pcoll = this->pcoll;
+
+    waypoint_reach.clear();
+    waypoint_reach.resize(pcoll.size(), 0xff);
+
+    // 第0跳: 地址或值命中途经地址的指针
+    std::vector<size_t> frontier;
+    for (size_t i = 0; i < pcoll.size(); ++i) {
+        if (near_waypoint(pcoll[i].address) || near_waypoint(pcoll[i].value)) {
+            waypoint_reach[i] = 0;
+            frontier.emplace_back(i);
+        }
+    }
+    printf("途经地址正向扩展第 0 层: %ld 指针\n", frontier.size());
+
+    expand_reach(frontier, waypoint_reach, offset, floor, hops);
+}
+
+template <class T>
+void chainer::scan<T>::expand_reach(std::vector<size_t> &frontier, utils::mapqueue<uint8_t> &out, size_t offset, size_t floor, int hops)
+{
+    auto &pcoll = this->pcoll;
+    size_t size = pcoll.size();
+    auto first = pcoll.begin(), last = pcoll.begin() + size;
+    auto comp = [](const pointer_data<T> &dat, T address) { return dat.address < address; };
+
+    utils::task_group jobs;
+
+    // 第 n 跳: 指向的结构体 [value - floor, value + offset] 内的指针
+    // 指针表已是全部内存的快照 正向扩展只需二分 不用再读内存
+    constexpr size_t avg = 1 << 12;
+    for (int hop = 1; hop <= hops && !frontier.empty(); ++hop) {
+        std::vector<std::vector<size_t>> parts(DIV_ROUND_UP(frontier.size(), avg));
+
+        auto expand = [&](size_t start, size_t count, std::vector<size_t> *part) {
+            for (auto i = start; i < start + count; ++i) {
+                T value = pcoll[frontier[i]].value;
+                T low = value > floor ? value - floor : 0;
+                size_t lower = std::lower_bound(first, last, low, comp) - first;
+                for (auto j = lower; j < size && pcoll[j].address - low <= offset + floor; ++j) {
+                    if (out[j] == 0xff)
+                        part->emplace_back(j);
+                }
+            }
+        };
+
+        size_t index = 0, part = 0;
+        auto push_pool = [&](size_t count) {
+            utils::thread_pool->post(jobs, expand, index, count, &parts[part++]);
+            index += count;
+        };
+        utils::split_num_to_avg(frontier.size(), avg, push_pool);
+        utils::thread_pool->wait(jobs);
+
+        frontier.clear();
+        for (auto &p : parts)
+            frontier.insert(frontier.end(), p.begin(), p.end());
+        std::sort(frontier.begin(), frontier.end());
+        frontier.erase(std::unique(frontier.begin(), frontier.end()), frontier.end());
+
+        for (auto i : frontier)
+            out[i] = hop;
+        printf("正向扩展第 %d 层: %ld 指针\n", hop, frontier.size());
+    }
+}
+
+template <class T>
+void chainer::scan<T>::filter_by_reach(std::vector<chainer::pointer_data<T> *> &curr, int hops)
+{
+    auto first = this->pcoll.begin();
+    curr.erase(std::remove_if(curr.begin(), curr.end(),
+        [&](pointer_data<T> *p) { return reach[p - first] > hops; }), curr.end());
+}
+
+template <class T>
+void chainer::scan<T>::drop_visited(std::vector<chainer::pointer_data<T> *> &curr)
+{
+    // 有途经地址时两种状态都出现过才能丢弃 只出现过一种的在拆分时按状态丢弃
+    auto first = this->pcoll.begin();
+    uint8_t full = waypoint != 0 ? 3 : 1;
+    curr.erase(std::remove_if(curr.begin(), curr.end(),
+        [&](pointer_data<T> *p) { return (visited[p - first] & full) == full; }), curr.end());
+}
+
+template <class T>
+void chainer::scan<T>::mark_visited(std::vector<utils::mapqueue<chainer::pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int level)
+{
+    auto first = this->pcoll.begin(), last = this->pcoll.begin() + this->pcoll.size();
+    auto mark = [&](T address, uint8_t state) {
+        auto it = std::lower_bound(first, last, address, [](const pointer_data<T> &dat, T t) { return dat.address < t; });
+        if (it != last && it->address == address)
+            visited[it - first] |= 1 << state;
+    };
+
+    // 有途经地址时按节点是否已途经分别标记 静态指针都是已途经的
+    bool split = waypoint != 0;
+    auto state_of = [&](size_t i) -> uint8_t { return split ? passed[level][i] : 0; };
+
+    // 第0层 (区间目标时为基本段) 按目标地址标记
+    if (level == 0) {
+        for (auto &t : target_ids)
+            mark(t.first, split && !has_target_spans() && near_waypoint(t.first));
+        return;
+    }
+
+    // 节点按地址有序 拆分出的同地址同状态节点只查一次
+    auto &curr = dirs[level];
+    for (size_t i = 0; i < curr.size(); ++i) {
+        if (i == 0 || curr[i].address != curr[i - 1].address || state_of(i) != state_of(i - 1))
+            mark(curr[i].address, state_of(i));
+    }
+    for (auto &r : ranges) {
+        if (r.level != level)
+            continue;
+        for (auto &v : r.results)
+            mark(v.address, split);
+    }
+}
+
+template <class T>
+void chainer::scan<T>::reset_visited(std::vector<utils::mapqueue<chainer::pointer_dir<T>>> &dirs, std::vector<chainer::pointer_range<T>> &ranges, int from, int to)
+{
+    visited.clear();
+    visited.resize(this->pcoll.size(), 0);
+    for (int level = from; level < to; ++level)
+        mark_visited(dirs, ranges, level);
+}
+
+template <class T>
+void chainer::scan<T>::set_chain_targets(std::vector<T> &addr, std::vector<T> &uniq)
+{
+    target_ids.clear();
+    target_ids.reserve(addr.size());
+    for (size_t i = 0; i < addr.size(); ++i)
+        target_ids.emplace_back(addr[i], i);
+
+    // 稳定排序后去重 保留每个地址第一次出现的编号
+    std::stable_sort(target_ids.begin(), target_ids.end(), [](auto &x, auto &y) { return x.first < y.first; });
+    target_ids.erase(std::unique(target_ids.begin(), target_ids.end(), [](auto &x, auto &y) { return x.first == y.first; }), target_ids.end());
+
+    uniq.clear();
+    uniq.reserve(target_ids.size());
+    for (auto &t : target_ids)
+        uniq.emplace_back(t.first);
+
+    // 区间下界 重复地址取最大的余量
+    auto slack_of = [this](size_t i) {
+        if (target_slack.size() == 1)
+            return target_slack[0];
+        return i < target_slack.size() ? target_slack[i] : T(0);
+    };
+    target_lows.assign(uniq.begin(), uniq.end());
+    for (size_t i = 0; i < addr.size(); ++i) {
+        auto it = std::lower_bound(uniq.begin(), uniq.end(), addr[i]);
+        T slack = std::min(slack_of(i), addr[i]);
+        auto &low = target_lows[it - uniq.begin()];
+        low = std::min(low, T(addr[i] - slack));
+    }
+
+    target_counts.assign(addr.size(), 0);
+}
+
+template <class T>
+int chainer::scan<T>::target_id_of(T address)
+{
+    auto it = std::lower_bound(target_ids.begin(), target_ids.end(), address, [](auto &x, T target) { return x.first < target; });
+    return it != target_ids.end() && it->first == address ? (int)it->second : -1;
+}
+
+template <class T>
+void chainer::scan<T>::count_target_chains(std::vector<utils::mapqueue<chainer::pointer_dir<T> *>> &contents, std::vector<chainer::pointer_range<T>> &ranges)
+{
+    std::fill(target_counts.begin(), target_counts.end(), 0);
+
+    int max_level = contents.size() - 1;
+    std::vector<std::vector<chainer::pointer_range<T> *>> range_maps(max_level + 1);
+    for (auto &r : ranges)
+        range_maps[r.level].emplace_back(&r);
+
+    // 第0层的静态指针就是目标本身 各算一条链
+    for (auto r : range_maps[0]) {
+        for (auto &dir : r->results) {
+            int id = target_id_of(dir.address);
+            if (id >= 0)
+                target_counts[id] += 1;
+        }
+    }
+
+    // mult[i]: 经过 contents[level][i] 的链数 从最高层开始 静态指针的链数为 1
+    // 每个节点把自己的链数加到子节点区间 [start, end) 上 用差分数组一次完成
+    std::vector<size_t> mult, diff;
+    for (int level = max_level; level > 0; --level) {
+        diff.assign(contents[level - 1].size() + 1, 0);
+
+        for (auto r : range_maps[level]) {
+            for (auto &dir : r->results) {
+                diff[dir.start] += 1;
+                diff[dir.end] -= 1;
+            }
+        }
+        for (size_t i = 0; i < mult.size(); ++i) {
+            auto dir = contents[level][i];
+            diff[dir->start] += mult[i];
+            diff[dir->end] -= mult[i];
+        }
+
+        mult.resize(contents[level - 1].size());
+        size_t running = 0;
+        for (size_t i = 0; i < mult.size(); ++i)
+            mult[i] = running += diff[i];
+    }
+
+    for (size_t i = 0; i < mult.size(); ++i) {
+        int id = target_id_of(contents[0][i]->address);
+        if (id >= 0)
+            target_counts[id] += mult[i];
+    }
+}
+
+template <class T>
+bool chainer::scan<T>::has_target_spans() const
+{
+    for (size_t i = 0; i < target_ids.size(); ++i) {
+        if (target_lows[i] != target_ids[i].first)
+            return true;
+    }
+    return false;
+}
+
+template <class T>
+void chainer::scan<T>::build_target_segments(std::vector<chainer::pointer_range<T>> &ranges, size_t offset, utils::mapqueue<chainer::pointer_dir<T>> &out)
+{
+    struct span {
+        T from; //第1层指针值的下界 lo - offset
+        T low;
+        T high;
+    };
+
+    // 落在静态模块的目标已作为第0层的链输出
+    std::vector<T> statics_hit;
+    for (auto &r : ranges) {
+        if (r.level != 0)
+            continue;
+        for (auto &dir : r.results)
+            statics_hit.emplace_back(dir.address);
+    }
+    std::sort(statics_hit.begin(), statics_hit.end());
+
+    std::vector<span> spans;
+    for (size_t i = 0; i < target_ids.size(); ++i) {
+        T high = target_ids[i].first;
+        if (std::binary_search(statics_hit.begin(), statics_hit.end(), high))
+            continue;
+
+        T low = target_lows[i];
+        spans.push_back({low > offset ? T(low - offset) : T(0), low, high});
+    }
+
+    // 探测点: 区间内从 hi 向下每隔 offset 一个 加上 lo
+    // 任意 v ∈ [lo - offset, hi] 在 [v, v + offset] 内都有探测点 区间外的 v 没有
+    T step = std::max<T>(offset, 1);
+    target_probes.clear();
+    for (auto &sp : spans) {
+        for (T x = sp.high; x > sp.low && x - sp.low >= step; x -= step)
+            target_probes.emplace_back(x, 0);
+        target_probes.emplace_back(sp.low, 0);
+        if (sp.high != sp.low)
+            target_probes.emplace_back(sp.high, 0);
+    }
+    std::sort(target_probes.begin(), target_probes.end(), [](auto &x, auto &y) { return x.address < y.address; });
+    target_probes.erase(std::unique(target_probes.begin(), target_probes.end(), [](auto &x, auto &y) { return x.address == y.address; }), target_probes.end());
+
+    // 基本段: 端点 from 和 hi + 1 把地址切成若干段 每段内覆盖的区间集合不变
+    std::vector<T> points;
+    for (auto &sp : spans) {
+        points.emplace_back(sp.from);
+        points.emplace_back(sp.high + 1);
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    std::sort(spans.begin(), spans.end(), [](auto &x, auto &y) { return x.from < y.from; });
+
+    size_t next = 0;
+    std::vector<span *> active;
+    target_segments.clear();
+    out.clear();
+    for (auto point : points) {
+        while (next < spans.size() && spans[next].from <= point)
+            active.emplace_back(&spans[next++]);
+        active.erase(std::remove_if(active.begin(), active.end(), [point](auto sp) { return sp->high < point; }), active.end());
+        std::sort(active.begin(), active.end(), [](auto x, auto y) { return x->high < y->high; });
+
+        pointer_dir<T> seg(point, 0, out.size(), 0);
+        for (auto sp : active)
+            out.emplace_back(sp->high, 0, 0, 1);
+        seg.end = out.size();
+        target_segments.emplace_back(seg);
+    }
+
+    printf("区间目标: %ld 个 基本段 %ld 探测点 %ld 第0层节点 %ld\n", spans.size(), target_segments.size(), target_probes.size(), out.size());
+}
+
+template <class T>
+template <class C>
+void chainer::scan<T>::create_segment_index(C &curr, size_t avg, utils::task_group &jobs)
+{
+    pointer_dir<T> *start = &curr.front();
+
+    // 值所在的基本段: 最后一个起点不大于值的段 段外 (第一个端点之前) 为空区间
+    auto assoc_index = [this](pointer_dir<T> *first, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if ((i & 0xffff) == 0 && this->stopped())
+                return;
+
+            auto data = &first[i];
+            auto it = std::upper_bound(target_segments.begin(), target_segments.end(), data->value, [](T value, auto &seg) { return value < seg.address; });
+            if (it == target_segments.begin()) {
+                data->start = data->end = 0;
+                continue;
+            }
+            --it;
+            data->start = it->start;
+            data->end = it->end;
+        }
+    };
+
+    auto push_pool = [&](size_t block_size) {
+        utils::thread_pool->post(jobs, assoc_index, start, block_size);
+        start += block_size;
+    };
+    utils::split_num_to_avg(curr.size(), avg, push_pool);
+}
@@ -6,6 +6,7 @@
 #include "memextend.hpp"
 
 #include "cbase.h"
+#include "ccontrol.h"
 
 namespace chainer {
 
@@ -13,7 +14,11 @@ template <class T> class search {
 protected:
   utils::mapqueue<pointer_data<T>> pcoll; // pointer_coll
 
-  utils::mapqueue<void *> cache; // 缓存
+  utils::mapqueue<pointer_data<T> *> cache; // 缓存 search_pointer 各块的结果
+
+  scan_control *control; // 扫描控制 可为空
+
+  bool stopped() const; // 已取消或超出时间预算
 
 private:
   void output_pointer_to_file(FILE *f, T *buffer, T start, size_t maxn, T min,
@@ -25,22 +30,31 @@ private:
   template <typename P>
   void filter_pointer_from_fmmap(P &&input, pointer_data<T> *start,
                                  size_t count, size_t offset,
+                                 const offset_rule *rule,
                                  std::atomic<size_t> &total,
                                  utils::list_head<pointer_pcount<T>> *block);
 
   template <typename P>
   void filter_pointer_to_block(P &&input, size_t offset,
+                               const offset_rule *rule,
                                utils::list_head<pointer_pcount<T>> *node,
-                               size_t avg, std::atomic<size_t> &total);
+                               size_t avg, std::atomic<size_t> &total,
+                               utils::task_group &jobs);
 
 public:
   size_t get_pointers(T start, T end, bool rest, int count, int size);
 
   // template <typename P, template <typename> class Container> as what i say,
   // clang has bug
+  // rule 非空时按偏移规则匹配 (负偏移/对齐/白名单) 为空时窗口为 [0, offset]
   template <typename P, typename U>
   void search_pointer(P &&input, U &out, size_t offset, bool rest,
-                      size_t limit); // out.type = pointer_data<T> *
+                      size_t limit,
+                      const offset_rule *rule =
+                          nullptr); // out.type = pointer_data<T> *
+
+  // 设置扫描控制 取消/时间预算/进度回调 传空关闭
+  void set_scan_control(scan_control *c);
 
   search();
 
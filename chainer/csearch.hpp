@@ -46,16 +46,25 @@ template <class T>
 void chainer::search<T>::filter_pointer_to_fmmap(char *buffer, T start, size_t len,
                     memtool::vm_area_data *vma, FILE *&f)
 {
+    if (stopped()) {
+        f = nullptr;
+        return;
+    }
+
     f = tmpfile();
     if (f == nullptr) {
         return;
     }
 
     // 获取内存范围
+    // 续扫时指针快照来自扫描目录 内存区域可能未加载 此时不限制范围
     auto &vm_vec = memtool::extend::vm_area_vec;
-    T min = vm_vec.front()->start;
-    T max = vm_vec.back()->end;
-    T sub = max - min;
+    T min = 0;
+    T sub = ~T(0);
+    if (!vm_vec.empty()) {
+        min = vm_vec.front()->start;
+        sub = vm_vec.back()->end - min;
+    }
 
     // 使用传入的缓冲区（由 employ_memory_block 通过 BufferPool 获取）
     // 避免重复获取缓冲区导致死锁
@@ -70,6 +79,8 @@ void chainer::search<T>::filter_pointer_to_fmmap(char *buffer, T start, size_t l
     output_pointer_to_file(f, (T *)buffer, start, element_count, min, sub);
 
     fflush(f);
+    if (control != nullptr)
+        control->add_read(len, ftell(f) / sizeof(pointer_data<T>));
 }
 
 
@@ -77,13 +88,17 @@ template <class T>
 template <typename P>
 void chainer::search<T>::filter_pointer_from_fmmap(P &&input, 
     chainer::pointer_data<T> *start, size_t count, size_t offset, 
-    std::atomic<size_t> &total, utils::list_head<pointer_pcount<T>> *block)
+    const offset_rule *rule, std::atomic<size_t> &total, utils::list_head<pointer_pcount<T>> *block)
 {
     // 获取内存范围
+    // 续扫时指针快照来自扫描目录 内存区域可能未加载 此时不限制范围
     auto &vm_vec = memtool::extend::vm_area_vec;
-    T min = vm_vec.front()->start;
-    T max = vm_vec.back()->end;
-    T sub = max - min;
+    T min = 0;
+    T sub = ~T(0);
+    if (!vm_vec.empty()) {
+        min = vm_vec.front()->start;
+        sub = vm_vec.back()->end - min;
+    }
     
     size_t input_size = input.size();
     pointer_data<T> **save = block->data.data;
@@ -95,6 +110,10 @@ void chainer::search<T>::filter_pointer_from_fmmap(P &&input,
     // 2. 对每个指针数据进行二分查找匹配上层数据（按地址排序）
     // 复杂度：O(n) vs 常规 O(m)*O(logn)
     for (size_t i = 0; i < count; ++i) {
+        if ((i & 0xffff) == 0 && stopped()) {
+            break;
+        }
+
         pointer_data<T> *data = start + i;
         T value = data->value;
         
@@ -105,6 +124,26 @@ void chainer::search<T>::filter_pointer_from_fmmap(P &&input,
 
         // 二分查找匹配的内存区域
         int lower, upper;
+
+        // 偏移规则: 窗口 [value - floor, value + max] 内有一个满足规则的节点即可
+        if (rule != nullptr) {
+            T low = value > rule->floor ? value - rule->floor : 0;
+            utils::binary_search(input, search_pointer_by_bin_gt, low,
+                               input_size, lower, upper);
+
+            bool hit = false;
+            for (size_t k = lower; k < input_size; ++k) {
+                long d = signed_offset<T>(utils::address_of(input[k])->address - value);
+                if (d > (long)rule->max)
+                    break;
+                if ((hit = rule->accept(d)))
+                    break;
+            }
+            if (hit)
+                save[pcount++] = data;
+            continue;
+        }
+
         utils::binary_search(input, search_pointer_by_bin_gt, value, 
                            input_size, lower, upper);
 
@@ -128,18 +167,16 @@ void chainer::search<T>::filter_pointer_from_fmmap(P &&input,
 template <class T>
 template <typename P>
 void chainer::search<T>::filter_pointer_to_block(P &&input, size_t offset,
-     utils::list_head<pointer_pcount<T>> *node, size_t avg, std::atomic<size_t> &total)
+     const offset_rule *rule, utils::list_head<pointer_pcount<T>> *node, size_t avg, std::atomic<size_t> &total,
+     utils::task_group &jobs)
 {
-    // 转换缓存为指针队列
-    auto &trf = reinterpret_cast<utils::mapqueue<pointer_data<T> *> &>(cache);
-    
     pointer_data<T> *start = &pcoll.front();
-    pointer_data<T> **save = &trf.front();
+    pointer_data<T> **save = &cache.front();
 
     // 创建查找指针的回调函数
-    auto find_pointer = [this, &input, &total, offset](
+    auto find_pointer = [this, &input, &total, offset, rule](
         auto ptr_start, auto count, auto block) {
-        filter_pointer_from_fmmap(input, ptr_start, count, offset, total, block);
+        filter_pointer_from_fmmap(input, ptr_start, count, offset, rule, total, block);
     };
 
     // 创建任务分配的回调函数
@@ -150,7 +187,7 @@ void chainer::search<T>::filter_pointer_to_block(P &&input, size_t offset,
         node->data.data = save;
 
         // 提交任务到线程池
-        utils::thread_pool->pushpool(find_pointer, start, block_size, node);
+        utils::thread_pool->post(jobs, find_pointer, start, block_size, node);
 
         // 更新指针位置
         start += block_size;
@@ -183,6 +220,15 @@ size_t chainer::search<T>::get_pointers(T start, T end, bool rest, int count,
     filter_pointer_to_fmmap(buf, mem_start, mem_len, vma, file);
   };
   
+  if (control != nullptr) {
+    size_t total = 0;
+    for (auto vma : memtool::extend::vm_area_vec) {
+      if ((vma->prot & PROT_READ) && (!rest || std::max(vma->start, (size_t)start) <= std::min(vma->end, (size_t)end)))
+        total += vma->end - vma->start;
+    }
+    control->begin_read(total);
+  }
+
   auto file_list = memtool::extend::for_each_memory_area<FILE *>(
       start, end, rest, count, size, fptofile);
 
@@ -214,7 +260,7 @@ size_t chainer::search<T>::get_pointers(T start, T end, bool rest, int count,
 template <class T>
 template <typename P, typename U>
 void chainer::search<T>::search_pointer(P &&input, U &out, size_t offset, 
-                                       bool rest, size_t limit)
+                                       bool rest, size_t limit, const offset_rule *rule)
 {
     // 检查输入有效性
     if (input.empty() || pcoll.begin() == nullptr || pcoll.size() == 0) {
@@ -228,10 +274,11 @@ void chainer::search<T>::search_pointer(P &&input, U &out, size_t offset,
     // 第一阶段：分块过滤指针（多线程）
     // 10000 是每个线程处理的平均指针数量，可以根据需要调整
     const size_t avg_block_size = 20000;
-    filter_pointer_to_block(input, offset, head, avg_block_size, total);
+    utils::task_group jobs;
+    filter_pointer_to_block(input, offset, rule, head, avg_block_size, total, jobs);
 
-    // 等待所有线程完成
-    utils::thread_pool->wait();
+    // 只等待本次搜索提交的任务 其他调用方的任务不受影响
+    utils::thread_pool->wait(jobs);
 
     // 计算最终输出限制
     size_t final_limit = rest ? limit : total.load();
@@ -261,7 +308,19 @@ void chainer::search<T>::search_pointer(P &&input, U &out, size_t offset,
 }
 
 template <class T>
-chainer::search<T>::search()
+bool chainer::search<T>::stopped() const
+{
+    return control != nullptr && control->stopped();
+}
+
+template <class T>
+void chainer::search<T>::set_scan_control(chainer::scan_control *c)
+{
+    control = c;
+}
+
+template <class T>
+chainer::search<T>::search() : control(nullptr)
 {
 }
 
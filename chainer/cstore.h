@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "mapqueue.h"
+#include "sutils.h"
+#include "varray.h"
+
+#include "cbase.h"
+#include "cemit.h"
+
+namespace chainer
+{
+
+//一条链 path[0] 为模块中的静态指针 path[k] 为它之下第 k 跳的节点 最后一个是目标
+template <class T>
+struct chain_record {
+    size_t module; //模块下标
+    size_t index;  //全局链号
+    std::vector<cprog_data<T>> path;
+};
+
+//第 level 层 n 个节点之下的链数前缀和 prefix[i] 为前 i 个节点之下的链数 按段并行计算
+//lower 为第 level - 1 层的前缀和 (level 为0时不用) 有节点的子节点区间超出下一层时返回 false
+template <class T>
+bool fill_chain_prefix(utils::mapqueue<uint64_t> &prefix, const cprog_data<T> *nodes, size_t n, int level, const utils::varray<uint64_t> *lower);
+
+//全部层的前缀链数 prefix[l] 同 fill_chain_prefix levels[l] 为其视图 有节点索引越界时抛出 std::runtime_error
+template <class T>
+void build_chain_prefix(const cprog_chain_info<T> &info, std::vector<utils::mapqueue<uint64_t>> &prefix, std::vector<utils::varray<uint64_t>> &levels);
+
+//随机访问的链存储: 按链号或按模块分页读取 .bin 中的链 不展开其他链
+//链号的顺序与 .bin 转文本 (format_bin_chain_data) 的输出顺序相同
+//每个节点之下的链数前缀和来自文件的索引段 没有索引段的旧文件在打开时并行重建 (mapqueue)
+//定位一条链: 二分模块 二分根节点 然后每层在子节点区间内二分 O(depth * log n)
+template <class T>
+class store : public ::chainer::base<T>
+{
+private:
+    cprog_chain_info<T> info;
+
+    std::vector<utils::varray<uint64_t>> levels; //levels[l][i] 第 l 层前 i 个节点之下的链数
+    std::vector<utils::varray<uint64_t>> roots;  //roots[m][i] 模块 m 前 i 个根节点的链数
+    std::vector<uint64_t> modules;               //modules[m] 前 m 个模块的链数
+
+    char *index_addr; //索引段的映射
+    size_t index_size;
+    std::vector<utils::mapqueue<uint64_t>> built; //重建的索引
+
+    void close();
+
+    //映射文件的索引段 大小与数据不符时返回 false
+    bool map_index(FILE *f);
+
+    //按每个节点的子节点区间重新计算前缀链数
+    void build_index();
+
+public:
+    store();
+    ~store();
+
+    store(const store &) = delete;
+    store &operator=(const store &) = delete;
+
+    //打开 .bin (v101 或 v2) 失败时抛出 std::runtime_error
+    void open(FILE *f);
+
+    //索引来自文件 (而不是打开时重建)
+    bool indexed() const;
+
+    size_t chains() const;
+
+    size_t module_count() const;
+
+    const cprog_sym<T> &module(size_t m) const;
+
+    size_t module_chains(size_t m) const;
+
+    //第 n 条链 n 越界或文件数据不一致时返回 false
+    bool get_chain(size_t n, chain_record<T> &out) const;
+
+    //模块 m 内从第 first 条起最多 count 条链 追加到 out 返回取到的条数
+    size_t get_page(size_t m, size_t first, size_t count, std::vector<chain_record<T>> &out) const;
+
+    //链的文本 与 .bin 转文本的一行相同 (不含换行)
+    std::string format(const chain_record<T> &chain) const;
+};
+
+} // namespace chainer
+
+#include "cstore.hpp"
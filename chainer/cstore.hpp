@@ -0,0 +1,286 @@
+#pragma once
+
+#include "cstore.h"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+template <class T>
+chainer::store<T>::store() : index_addr(nullptr), index_size(0)
+{
+}
+
+template <class T>
+chainer::store<T>::~store()
+{
+    close();
+}
+
+template <class T>
+void chainer::store<T>::close()
+{
+    if (index_addr != nullptr)
+        munmap(index_addr, index_size);
+    index_addr = nullptr, index_size = 0;
+
+    // 移出后析构 释放文件映射
+    {
+        auto old = std::move(info);
+    }
+    levels.clear();
+    roots.clear();
+    modules.clear();
+    built.clear();
+}
+
+template <class T>
+void chainer::store<T>::open(FILE *f)
+{
+    close();
+    info = this->parse_cprog_bin_data(f, CPROG_RANDOM);
+
+    for (auto &sym : info.syms) {
+        if (sym.sym->level < 0 || (size_t)sym.sym->level > info.contents.size())
+            throw std::runtime_error("指针链文件模块层数越界");
+    }
+
+    if (!map_index(f)) {
+        printf("文件没有链索引, 重新计算\n");
+        build_index();
+    }
+
+    modules.assign(info.syms.size() + 1, 0);
+    for (size_t m = 0; m < info.syms.size(); ++m)
+        modules[m + 1] = modules[m] + roots[m].back();
+}
+
+template <class T>
+bool chainer::store<T>::map_index(FILE *f)
+{
+    struct stat st;
+    int fd = fileno(f);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cprog_index_header) + sizeof(cprog_index_tail))
+        return false;
+
+    cprog_index_tail tail;
+    cprog_index_header header;
+    if (pread(fd, &tail, sizeof(tail), st.st_size - sizeof(tail)) != sizeof(tail) || memcmp(tail.magic, cprog_index_magic, sizeof(tail.magic)) != 0)
+        return false;
+    if (tail.offset > (uint64_t)st.st_size - sizeof(header) - sizeof(tail) || pread(fd, &header, sizeof(header), tail.offset) != sizeof(header))
+        return false;
+    if (memcmp(header.magic, cprog_index_magic, sizeof(header.magic)) != 0 || header.version != 1)
+        return false;
+
+    // 索引必须与数据的层数和节点数完全对应
+    if (header.level != info.contents.size() || header.module_count != info.syms.size())
+        return false;
+    size_t words = 0;
+    for (auto &layer : info.contents)
+        words += layer.size() + 1;
+    for (auto &sym : info.syms)
+        words += sym.data.size() + 1;
+    if (sizeof(header) + words * sizeof(uint64_t) + sizeof(tail) != (uint64_t)st.st_size - tail.offset)
+        return false;
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t aligned = tail.offset / page * page;
+    index_size = st.st_size - aligned;
+    index_addr = (char *)mmap(nullptr, index_size, PROT_READ, MAP_SHARED, fd, aligned);
+    if (index_addr == MAP_FAILED) {
+        index_addr = nullptr, index_size = 0;
+        return false;
+    }
+    madvise(index_addr, index_size, MADV_RANDOM);
+
+    auto p = (uint64_t *)(index_addr + (tail.offset - aligned) + sizeof(header));
+    for (auto &layer : info.contents) {
+        levels.emplace_back();
+        levels.back().set_data(p, layer.size() + 1);
+        p += layer.size() + 1;
+    }
+    for (auto &sym : info.syms) {
+        roots.emplace_back();
+        roots.back().set_data(p, sym.data.size() + 1);
+        p += sym.data.size() + 1;
+    }
+    return true;
+}
+
+template <class T>
+bool chainer::fill_chain_prefix(utils::mapqueue<uint64_t> &prefix, const chainer::cprog_data<T> *nodes, size_t n, int level, const utils::varray<uint64_t> *lower)
+{
+    constexpr size_t avg = 10000;
+    std::atomic_bool bad(false);
+
+    // 每段节点的链数并行计算 再串行求前缀和 第0层节点本身就是一条链
+    prefix.resize(n + 1, 0);
+    auto count = [&](size_t start, size_t len) {
+        for (auto i = start; i < start + len; ++i) {
+            auto &dir = nodes[i];
+            if (level == 0) {
+                prefix[i + 1] = 1;
+            } else if (dir.start > dir.end || (size_t)dir.end >= lower->size()) {
+                bad = true;
+            } else {
+                prefix[i + 1] = (*lower)[dir.end] - (*lower)[dir.start];
+            }
+        }
+    };
+
+    utils::task_group jobs;
+    size_t index = 0;
+    utils::split_num_to_avg(n, avg, [&](size_t len) {
+        utils::thread_pool->post(jobs, count, index, len);
+        index += len;
+    });
+    utils::thread_pool->wait(jobs);
+
+    for (size_t i = 0; i < n; ++i)
+        prefix[i + 1] += prefix[i];
+    return !bad;
+}
+
+template <class T>
+void chainer::build_chain_prefix(const chainer::cprog_chain_info<T> &info, std::vector<utils::mapqueue<uint64_t>> &prefix, std::vector<utils::varray<uint64_t>> &levels)
+{
+    auto &contents = info.contents;
+    bool ok = true;
+
+    prefix.resize(contents.size());
+    levels.clear();
+    for (size_t level = 0; level < contents.size(); ++level) {
+        ok = fill_chain_prefix<T>(prefix[level], contents[level].begin(), contents[level].size(), level, level > 0 ? &levels[level - 1] : nullptr) && ok;
+        levels.emplace_back();
+        levels.back().set_data(prefix[level].begin(), prefix[level].size());
+    }
+
+    if (!ok)
+        throw std::runtime_error("指针链文件节点索引越界");
+}
+
+template <class T>
+void chainer::store<T>::build_index()
+{
+    auto &contents = info.contents;
+    bool ok = true;
+
+    built.resize(contents.size() + info.syms.size());
+    for (size_t level = 0; level < contents.size(); ++level) {
+        auto &prefix = built[level];
+        ok = fill_chain_prefix<T>(prefix, contents[level].begin(), contents[level].size(), level, level > 0 ? &levels[level - 1] : nullptr) && ok;
+        levels.emplace_back();
+        levels.back().set_data(prefix.begin(), prefix.size());
+    }
+    for (size_t m = 0; m < info.syms.size(); ++m) {
+        auto &sym = info.syms[m];
+        auto &prefix = built[contents.size() + m];
+        int level = sym.sym->level;
+        ok = fill_chain_prefix<T>(prefix, sym.data.begin(), sym.data.size(), level, level > 0 ? &levels[level - 1] : nullptr) && ok;
+        roots.emplace_back();
+        roots.back().set_data(prefix.begin(), prefix.size());
+    }
+
+    if (!ok)
+        throw std::runtime_error("指针链文件节点索引越界");
+}
+
+template <class T>
+bool chainer::store<T>::indexed() const
+{
+    return index_addr != nullptr;
+}
+
+template <class T>
+size_t chainer::store<T>::chains() const
+{
+    return modules.empty() ? 0 : modules.back();
+}
+
+template <class T>
+size_t chainer::store<T>::module_count() const
+{
+    return info.syms.size();
+}
+
+template <class T>
+const chainer::cprog_sym<T> &chainer::store<T>::module(size_t m) const
+{
+    return *info.syms[m].sym;
+}
+
+template <class T>
+size_t chainer::store<T>::module_chains(size_t m) const
+{
+    return modules[m + 1] - modules[m];
+}
+
+template <class T>
+bool chainer::store<T>::get_chain(size_t n, chainer::chain_record<T> &out) const
+{
+    if (n >= chains())
+        return false;
+
+    // 所在模块和根节点
+    size_t m = std::upper_bound(modules.begin(), modules.end(), (uint64_t)n) - modules.begin() - 1;
+    auto &sym = info.syms[m];
+    auto &r = roots[m];
+    uint64_t rem = n - modules[m];
+    size_t i = std::upper_bound(r.begin(), r.end(), rem) - r.begin() - 1;
+    if (i >= sym.data.size())
+        return false;
+    rem -= r[i];
+
+    out.module = m;
+    out.index = n;
+    out.path.clear();
+    out.path.emplace_back(sym.data[i]);
+
+    // 逐层在子节点区间 [start, end) 的前缀链数中二分 找到第 rem 条链经过的子节点
+    for (int level = sym.sym->level; level > 0; --level) {
+        auto node = out.path.back();
+        auto &layer = info.contents[level - 1];
+        auto &p = levels[level - 1];
+        if (node.start >= node.end || node.end > layer.size())
+            return false;
+
+        uint64_t want = p[node.start] + rem;
+        size_t j = std::upper_bound(p.begin() + node.start, p.begin() + node.end + 1, want) - p.begin() - 1;
+        if (j < node.start || j >= node.end)
+            return false;
+        rem = want - p[j];
+        out.path.emplace_back(layer[j]);
+    }
+    return true;
+}
+
+template <class T>
+size_t chainer::store<T>::get_page(size_t m, size_t first, size_t count, std::vector<chainer::chain_record<T>> &out) const
+{
+    if (m >= module_count())
+        return 0;
+
+    size_t total = module_chains(m), got = 0;
+    for (size_t k = first; k < total && got < count; ++k, ++got) {
+        out.emplace_back();
+        if (!get_chain(modules[m] + k, out.back())) {
+            out.pop_back();
+            break;
+        }
+    }
+    return got;
+}
+
+template <class T>
+std::string chainer::store<T>::format(const chainer::chain_record<T> &chain) const
+{
+    if (chain.path.empty())
+        return std::string();
+
+    auto sym = info.syms[chain.module].sym;
+    std::unique_ptr<char[]> buf(new char[256 + chain.path.size() * chain_emitter<T>::hop_size]);
+    char *p = put_head(buf.get(), sym->name, sym->count, chain.path[0].address - sym->start);
+    for (size_t k = 1; k < chain.path.size(); ++k)
+        p = put_hop<T>(p, chain.path[k].address - chain.path[k - 1].value);
+    return std::string(buf.get(), p);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "sutils.h"
+
+#include "memextend.hpp"
+
+#include "cbase.h"
+#include "cparse.h"
+
+namespace chainer
+{
+
+//指针链校验 在存活进程中批量解析链 保留有效链
+//按层推进 每层把要读的地址去重后用 readv_batch 批量读取
+//.bin 中共享前缀的节点在同一实时地址上只读一次
+//模块基址按 name[count] 在当前 vm_static_list 中重新定位 支持进程重启后校验
+template <class T>
+class validator : public ::chainer::base<T>
+{
+private:
+    //bin 中的节点在存活进程中的一个实例
+    struct instance {
+        uint32_t index; //节点在所在层(或模块)中的下标
+        T address;      //实时地址
+        T value;        //实时读取的值 读取失败为0
+        size_t valid;   //经过该实例的有效链数
+    };
+
+    //文本链的解析状态
+    struct text_chain {
+        size_t first;   //第一个偏移在 offsets 中的下标
+        uint32_t hops;  //偏移个数
+        uint32_t hop;   //已解析的偏移个数
+        T address;      //当前实时地址
+        bool alive;
+        bool passed;    //已途经 waypoint
+    };
+
+    T target;    //目标地址 0为使用扫描时的目标 (仅bin)
+    T tolerance; //目标容差
+    T waypoint;  //途经地址 0为不限制 (仅文本链)
+    T waypoint_tolerance;
+
+    std::unordered_map<std::string, T> module_base;
+
+    void load_module_base();
+
+    bool find_module_base(const char *name, int count, T &base);
+
+    //addrs 已排序去重 values 与之一一对应 读取失败为0
+    void read_values(std::vector<T> &addrs, std::vector<T> &values);
+
+    void resolve_instances(std::vector<instance *> &list);
+
+    bool near(T address, T expect, T tol);
+
+    size_t count_valid(std::vector<instance> &children, utils::varray<cprog_data<T>> &layer, instance &in, const cprog_data<T> &node);
+
+    void out_valid_chain(FILE *f, char *buf, char *pos, int level, instance &in, const cprog_data<T> &node, std::vector<std::vector<instance>> &nodes, std::vector<utils::varray<cprog_data<T>>> &contents);
+
+public:
+    validator();
+
+    //target 为0时使用 .bin 中记录的扫描目标
+    void set_target(T addr, T tol);
+
+    //文本链必须途经 addr ± tol (节点地址或读取的值)
+    void set_waypoint(T addr, T tol);
+
+    //校验 .bin 有效链以文本格式写入 outstream (可为空) 返回有效链数
+    size_t validate_bin_chain_data(FILE *instream, FILE *outstream);
+
+    //校验文本链 有效行原样写入 outstream (可为空) 返回有效链数
+    size_t validate_txt_chain_data(FILE *instream, FILE *outstream);
+};
+
+} // namespace chainer
+
+#include "cvalid.hpp"
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "cvalid.h"
+
+#include <algorithm>
+
+template <class T>
+chainer::validator<T>::validator() : target(0), tolerance(0), waypoint(0), waypoint_tolerance(0)
+{
+}
+
+template <class T>
+void chainer::validator<T>::set_target(T addr, T tol)
+{
+    target = addr;
+    tolerance = tol;
+}
+
+template <class T>
+void chainer::validator<T>::set_waypoint(T addr, T tol)
+{
+    waypoint = addr;
+    waypoint_tolerance = tol;
+}
+
+template <class T>
+void chainer::validator<T>::load_module_base()
+{
+    module_base.clear();
+    for (auto vma : memtool::extend::vm_static_list)
+        module_base.emplace(std::string(vma->name) + "[" + std::to_string(vma->count) + "]", (T)vma->start);
+}
+
+template <class T>
+bool chainer::validator<T>::find_module_base(const char *name, int count, T &base)
+{
+    auto it = module_base.find(std::string(name) + "[" + std::to_string(count) + "]");
+    if (it == module_base.end())
+        return false;
+
+    base = it->second;
+    return true;
+}
+
+template <class T>
+bool chainer::validator<T>::near(T address, T expect, T tol)
+{
+    return address >= expect ? address - expect <= tol : expect - address <= tol;
+}
+
+template <class T>
+void chainer::validator<T>::read_values(std::vector<T> &addrs, std::vector<T> &values)
+{
+    values.assign(addrs.size(), 0);
+
+    size_t index = 0;
+    auto read_block = [&addrs, &values](size_t start, size_t count) {
+        std::vector<std::pair<size_t, size_t>> pairs(count);
+        std::vector<void *> buffers(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            pairs[i] = {(size_t)addrs[start + i], sizeof(T)};
+            buffers[i] = &values[start + i];
+        }
+        memtool::base::readv_batch(pairs, buffers);
+
+        for (size_t i = 0; i < count; ++i)
+            values[start + i] &= (T)0xffffffffffff; // 取低48位
+    };
+
+    utils::task_group jobs;
+    auto push_pool = [&](size_t count) {
+        utils::thread_pool->post(jobs, read_block, index, count);
+        index += count;
+    };
+
+    utils::split_num_to_avg(addrs.size(), 1 << 14, push_pool);
+    utils::thread_pool->wait(jobs);
+}
+
+template <class T>
+void chainer::validator<T>::resolve_instances(std::vector<instance *> &list)
+{
+    std::vector<T> addrs, values;
+
+    addrs.reserve(list.size());
+    for (auto in : list)
+        addrs.emplace_back(in->address);
+
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    read_values(addrs, values);
+
+    for (auto in : list)
+        in->value = values[std::lower_bound(addrs.begin(), addrs.end(), in->address) - addrs.begin()];
+}
+
+template <class T>
+size_t chainer::validator<T>::count_valid(std::vector<instance> &children, utils::varray<chainer::cprog_data<T>> &layer, instance &in, const chainer::cprog_data<T> &node)
+{
+    if (in.value == 0)
+        return 0;
+
+    auto comp = [](const instance &x, const std::pair<uint32_t, T> &key) {
+        return x.index < key.first || (x.index == key.first && x.address < key.second);
+    };
+
+    size_t valid = 0;
+    for (auto i = node.start; i < node.end; ++i) {
+        std::pair<uint32_t, T> key(i, in.value + (layer[i].address - node.value));
+        auto it = std::lower_bound(children.begin(), children.end(), key, comp);
+        if (it != children.end() && it->index == i && it->address == key.second)
+            valid += it->valid;
+    }
+    return valid;
+}
+
+template <class T>
+void chainer::validator<T>::out_valid_chain(FILE *f, char *buf, char *pos, int level, instance &in, const chainer::cprog_data<T> &node, std::vector<std::vector<instance>> &nodes, std::vector<utils::varray<chainer::cprog_data<T>>> &contents)
+{
+    if (level == 0) {
+        strcpy(pos, "\n");
+        fwrite(buf, pos + 1 - buf, 1, f);
+        return;
+    }
+
+    auto &layer = contents[level - 1];
+    auto &children = nodes[level - 1];
+    for (auto i = node.start; i < node.end; ++i) {
+        T address = in.value + (layer[i].address - node.value);
+        auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(i, address),
+            [](const instance &x, const std::pair<uint32_t, T> &key) {
+                return x.index < key.first || (x.index == key.first && x.address < key.second);
+            });
+        if (it == children.end() || it->index != i || it->address != address || it->valid == 0)
+            continue;
+
+        auto n = format_offset<T>(pos, " -> ", layer[i].address - node.value);
+        out_valid_chain(f, buf, pos + n, level - 1, *it, layer[i], nodes, contents);
+    }
+}
+
+template <class T>
+size_t chainer::validator<T>::validate_bin_chain_data(FILE *instream, FILE *outstream)
+{
+    auto [addr, size, syms, contents] = this->parse_cprog_bin_data(instream);
+
+    load_module_base();
+
+    int max_level = contents.size();
+
+    // nodes[l] 为 contents[l] 中节点的实例 按 (index, address) 排序
+    // roots[m] 为第 m 个模块的起始指针
+    std::vector<std::vector<instance>> nodes(max_level + 1);
+    std::vector<std::vector<instance>> roots(syms.size());
+
+    for (size_t m = 0; m < syms.size(); ++m) {
+        auto sym = syms[m].sym;
+        T base;
+        if (!find_module_base(sym->name, sym->count, base))
+            base = sym->start;
+
+        for (size_t k = 0; k < syms[m].data.size(); ++k)
+            roots[m].push_back(instance{(uint32_t)k, (T)(base + (syms[m].data[k].address - sym->start)), 0, 0});
+    }
+
+    // 自顶向下 每层批量读取后展开到下一层 (index, address) 相同的实例合并
+    for (int level = max_level; level >= 1; --level) {
+        std::vector<instance *> list;
+        for (auto &in : nodes[level])
+            list.emplace_back(&in);
+        for (size_t m = 0; m < syms.size(); ++m) {
+            if (syms[m].sym->level == level) {
+                for (auto &in : roots[m])
+                    list.emplace_back(&in);
+            }
+        }
+        resolve_instances(list);
+
+        auto &layer = contents[level - 1];
+        auto &next = nodes[level - 1];
+        auto expand = [&](instance &in, const cprog_data<T> &node) {
+            if (in.value == 0)
+                return;
+            for (auto i = node.start; i < node.end; ++i)
+                next.push_back(instance{i, (T)(in.value + (layer[i].address - node.value)), 0, 0});
+        };
+
+        for (auto &in : nodes[level])
+            expand(in, contents[level][in.index]);
+        for (size_t m = 0; m < syms.size(); ++m) {
+            if (syms[m].sym->level == level) {
+                for (auto &in : roots[m])
+                    expand(in, syms[m].data[in.index]);
+            }
+        }
+
+        auto less = [](const instance &x, const instance &y) {
+            return x.index < y.index || (x.index == y.index && x.address < y.address);
+        };
+        auto equal = [](const instance &x, const instance &y) {
+            return x.index == y.index && x.address == y.address;
+        };
+        std::sort(next.begin(), next.end(), less);
+        next.erase(std::unique(next.begin(), next.end(), equal), next.end());
+        printf("校验第 %d 层: 读取 %ld 地址, 下一层 %ld 实例\n", level, list.size(), next.size());
+    }
+
+    // 自底向上统计每个实例的有效链数
+    for (auto &in : nodes[0])
+        in.valid = near(in.address, target ? target : contents[0][in.index].address, tolerance);
+
+    for (int level = 1; level < (int)contents.size(); ++level) {
+        for (auto &in : nodes[level])
+            in.valid = count_valid(nodes[level - 1], contents[level - 1], in, contents[level][in.index]);
+    }
+
+    size_t total = 0;
+    char buffer[1024];
+    for (size_t m = 0; m < syms.size(); ++m) {
+        auto sym = syms[m].sym;
+        size_t module_count = 0;
+
+        for (auto &in : roots[m]) {
+            auto &node = syms[m].data[in.index];
+            if (sym->level > max_level)
+                in.valid = 0;
+            else if (sym->level == 0)
+                in.valid = near(in.address, target ? target : node.address, tolerance);
+            else
+                in.valid = count_valid(nodes[sym->level - 1], contents[sym->level - 1], in, node);
+            module_count += in.valid;
+
+            if (outstream == nullptr || in.valid == 0)
+                continue;
+
+            auto n = sprintf(buffer, "%s[%d] + 0x%lX", sym->name, sym->count, (size_t)(node.address - sym->start));
+            out_valid_chain(outstream, buffer, buffer + n, sym->level, in, node, nodes, contents);
+        }
+
+        total += module_count;
+        printf("有效 %lu 锁链 %d %s[%d]\n", module_count, sym->level, sym->name, sym->count);
+    }
+
+    if (outstream != nullptr)
+        fflush(outstream);
+    return total;
+}
+
+template <class T>
+size_t chainer::validator<T>::validate_txt_chain_data(FILE *instream, FILE *outstream)
+{
+    if (instream == nullptr)
+        return 0;
+
+    load_module_base();
+
+    // 第一遍 并行解析每行的模块和偏移 每个模块只定位一次基址
+    txt_chain_set<T> set;
+    parse_txt_chains(instream, set);
+    auto &offsets = set.offsets;
+
+    std::vector<T> bases(set.names.size());
+    std::vector<char> found(set.names.size());
+    for (size_t m = 0; m < set.names.size(); ++m)
+        found[m] = find_module_base(set.names[m].c_str(), set.counts[m], bases[m]);
+
+    std::vector<text_chain> chains(set.chains());
+    for (size_t i = 0; i < chains.size(); ++i) {
+        auto &c = chains[i];
+        c = text_chain{set.first[i], uint32_t(set.first[i + 1] - set.first[i]), 1, 0, false, false};
+        if (found[set.module[i]]) {
+            c.address = bases[set.module[i]] + offsets[c.first];
+            c.alive = true;
+        }
+    }
+
+    // 按跳数推进 每一跳把所有链要读的地址去重后批量读取
+    auto check_waypoint = [this](text_chain &c, T address) {
+        if (waypoint != 0 && near(address, waypoint, waypoint_tolerance))
+            c.passed = true;
+    };
+
+    for (int step = 1;; ++step) {
+        std::vector<T> addrs, values;
+        for (auto &c : chains) {
+            if (c.alive && c.hop < c.hops)
+                addrs.emplace_back(c.address);
+        }
+        if (addrs.empty())
+            break;
+
+        std::sort(addrs.begin(), addrs.end());
+        addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+        read_values(addrs, values);
+        printf("校验第 %d 跳: 读取 %ld 地址\n", step, addrs.size());
+
+        for (auto &c : chains) {
+            if (!c.alive || c.hop >= c.hops)
+                continue;
+
+            check_waypoint(c, c.address);
+            T value = values[std::lower_bound(addrs.begin(), addrs.end(), c.address) - addrs.begin()];
+            if (value == 0) {
+                c.alive = false;
+                continue;
+            }
+            check_waypoint(c, value);
+            c.address = value + offsets[c.first + c.hop++];
+        }
+    }
+
+    // 第二遍 有效行原样输出
+    size_t total = 0;
+    for (size_t i = 0; i < chains.size(); ++i) {
+        auto &c = chains[i];
+        if (!c.alive || !near(c.address, target, tolerance) || (waypoint != 0 && !c.passed))
+            continue;
+
+        ++total;
+        if (outstream != nullptr) {
+            size_t len;
+            const char *p = set.text(i, len);
+            fwrite(p, 1, len, outstream);
+            fputc('\n', outstream);
+        }
+    }
+
+    if (outstream != nullptr)
+        fflush(outstream);
+    printf("文本链 %ld 条, 有效 %ld 条\n", chains.size(), total);
+    return total;
+}
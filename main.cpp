@@ -4,10 +4,13 @@
 #include "chainer/ccscan.hpp"
 #include "chainer/ccompare.hpp"
 #include "chainer/ccformat.hpp"
+#include "chainer/cvalid.h"
+#include "chainer/cquery.h"
 #include "utils/cmd_parser.h"
 #include <cstdint>
 #include <cstdio>
 #include <sstream>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -26,6 +29,7 @@
 #include <sys/uio.h>
 #include <chrono>
 #include <string_view>
+#include <csignal>
 
 using namespace utils;
 
@@ -33,8 +37,23 @@ namespace {
 const std::string OUTPUT_DIR = "/sdcard/CK_PointerTool/";
 const std::string DEFAULT_PROCESS_FILE = OUTPUT_DIR + "包名.txt";
 const std::string MODULE_CONFIG_FILE = OUTPUT_DIR + "scan_module.txt";
+const std::string THREAD_POLICY_FILE = OUTPUT_DIR + "thread_policy.txt";
 std::string g_default_process = "";
 std::string g_selected_module = ""; // 支持：纯SO名、SO名:bss、[anon:.bss]
+chainer::scan_control g_scan_control; // Ctrl+C 取消 / 时间预算 / 进度
+
+// 扫描期间 Ctrl+C 只取消当前扫描 不退出程序
+void on_scan_sigint(int) { g_scan_control.cancel(); }
+
+void print_scan_progress(const chainer::scan_progress& p) {
+    if (p.level < 0)
+        printf("\r[进度] 读取 %zu/%zu MB | 指针 %zu | 已用 %.1fs | 剩余约 %.1fs   ",
+               p.bytes >> 20, p.total_bytes >> 20, p.pointers, p.elapsed, p.eta);
+    else
+        printf("[进度] 第 %d/%d 层 | 指针 %zu | 已用 %.1fs | 剩余约 %.1fs\n",
+               p.level, p.depth, p.pointers, p.elapsed, p.eta);
+    fflush(stdout);
+}
 std::vector<std::string> g_module_list; // 模块列表：包含所有SO和BSS段，手动去重
 
 // 创建输出目录
@@ -111,6 +130,29 @@ bool load_selected_module_from_file() {
     return true;
 }
 
+// ✅ 保存/加载线程绑核策略-永久生效 格式: "策略 留核数"
+const char* const POLICY_NAMES[] = {"不绑核", "全部核心", "只用大核", "给目标进程留核"};
+
+bool save_thread_policy_to_file(utils::affinity_policy policy, size_t reserved) {
+    FILE* fp = fopen(THREAD_POLICY_FILE.c_str(), "w");
+    if (!fp) return false;
+    fprintf(fp, "%d %zu", (int)policy, reserved);
+    fclose(fp);
+    return true;
+}
+bool load_thread_policy_from_file() {
+    FILE* fp = fopen(THREAD_POLICY_FILE.c_str(), "r");
+    if (!fp) return false;
+    int policy = 0;
+    size_t reserved = 0;
+    int n = fscanf(fp, "%d %zu", &policy, &reserved);
+    fclose(fp);
+    if (n < 1 || policy < 0 || policy > (int)utils::affinity_policy::reserve) return false;
+    if (policy != (int)utils::affinity_policy::none)
+        thread_pool->set_affinity((utils::affinity_policy)policy, reserved);
+    return true;
+}
+
 // ✅ 纯模块名提取函数 - 保留完整路径前缀的基名，用于匹配模块
 std::string get_module_basename(const char* full_name) {
     if (!full_name || strlen(full_name) == 0) return "";
@@ -311,43 +353,7 @@ std::string format_raw_chain(const std::vector<size_t>& offsets) {
     oss << std::nouppercase << std::dec;
     return oss.str();
 }
-size_t get_chain_length(const std::string& chain) { return std::count(chain.begin(), chain.end(), '-') / 2; }
-std::vector<uint64_t> extract_offsets(const std::string& chain) {
-    std::vector<uint64_t> offsets;
-    std::regex offset_regex(R"(\+0x([0-9A-Fa-f]+))");
-    std::smatch match;
-    std::string temp = chain;
-    while (std::regex_search(temp, match, offset_regex)) {
-        try { offsets.push_back(std::stoull(match[1].str(), nullptr, 16)); } catch (...) { offsets.push_back(UINT64_MAX); }
-        temp = match.suffix().str();
-    }
-    return offsets;
-}
-bool compare_chain(const std::string& a, const std::string& b) {
-    size_t len_a = get_chain_length(a), len_b = get_chain_length(b);
-    if (len_a != len_b) return len_a < len_b;
-    std::vector<uint64_t> oa=extract_offsets(a), ob=extract_offsets(b);
-    size_t min_cnt = std::min(oa.size(), ob.size());
-    for (size_t i=0;i<min_cnt;i++) if (oa[i]!=ob[i]) return oa[i]<ob[i];
-    return oa.size() < ob.size();
-}
-
-// 读取指针链文件/获取文件列表
-std::set<std::string> read_pointer_chain_file(const std::string& file_path) {
-    std::set<std::string> chains;
-    FILE* fp = fopen(file_path.c_str(), "r");
-    if (!fp) { std::cerr << "错误：无法打开文件 " << file_path << "\n"; return chains; }
-    char buf[1024] = {0};
-    while (fgets(buf, sizeof(buf), fp) != nullptr) {
-        std::string line = buf;
-        line.erase(line.find_last_not_of("\n\r") + 1);
-        line.erase(0, line.find_first_not_of(" "));
-        line.erase(line.find_last_not_of(" ") + 1);
-        if (!line.empty()) chains.insert(line);
-    }
-    fclose(fp);
-    return chains;
-}
+// 获取文件列表
 std::vector<std::string> get_sorted_chain_files(const std::string& prefix) {
     std::vector<std::pair<int, std::string>> file_list;
     DIR* dir = opendir(OUTPUT_DIR.c_str());
@@ -369,6 +375,44 @@ std::vector<std::string> get_sorted_chain_files(const std::string& prefix) {
     return res;
 }
 
+// 多个文件投票：统计每条链出现在几个文件中（如多次重启后的扫描结果），一遍输出达到阈值的链
+void vote_chain_files(const std::vector<std::string>& files) {
+    std::string cho = readStringWithDefault("选择参与投票的文件（序号用空格分隔）", "全部");
+    std::vector<std::string> sel;
+    std::istringstream in(cho);
+    size_t idx = 0;
+    while (in >> idx) if (idx >= 1 && idx <= files.size()) sel.push_back(files[idx-1]);
+    if (sel.size() < 2) sel = files;
+    size_t k = sel.size();
+    size_t th = readInt<size_t>("最少出现在几个文件中（默认" + std::to_string(k) + "）：", k);
+    th = std::min(std::max<size_t>(th, 1), k);
+
+    chainer::txt_join join(OUTPUT_DIR);
+    chainer::txt_vote_stats st;
+    try {
+        st = join.vote(sel, th);
+    } catch (const std::exception& e) {
+        std::cerr << "投票失败：" << e.what() << "\n";
+        return;
+    }
+
+    std::string rep = generate_incremental_filename("chain_vote");
+    FILE* fp = fopen(rep.c_str(), "w+");
+    if (!fp) { std::cerr << "创建报告失败\n"; return; }
+    fprintf(fp, "===== 指针链投票报告 =====\n");
+    for (size_t i=0;i<k;i++) fprintf(fp, "文件%zu：%s（%zu条）\n", i+1, sel[i].c_str(), st.unique[i]);
+    fprintf(fp, "阈值：%zu/%zu|保留=%zu\n出现次数：", th, k, st.kept);
+    for (size_t m=k;m>=1;m--) fprintf(fp, "%zu次=%zu%s", m, st.support[m], m>1?"|":"\n");
+    fprintf(fp, "\n【稳定链】（出现次数/文件数 链）\n");
+    try {
+        join.emit_votes([&](const char* p, size_t n, size_t m) { fprintf(fp, "%zu/%zu %.*s\n", m, k, (int)n, p); });
+    } catch (const std::exception& e) {
+        std::cerr << "写出报告失败：" << e.what() << "\n";
+    }
+    fclose(fp);
+    std::cout << "投票完成！保留 " << st.kept << " 条，报告：" << rep << "\n";
+}
+
 // 1. 指针链文件对比功能
 void compare_chain_files() {
     if (!create_output_dir()) return;
@@ -380,6 +424,8 @@ void compare_chain_files() {
 
     std::cout << "\n可用文件：\n";
     for (size_t i=0;i<files.size();i++) std::cout << i+1 << ". " << files[i] << "\n";
+    int mode = readInt<int>("对比方式（1=两个文件，2=多个文件按出现次数投票，默认1）：",1);
+    if (mode == 2) { vote_chain_files(files); return; }
     std::string cho = readStringWithDefault("选择对比文件（序号1 序号2，默认最后2个）",
         std::to_string(files.size()-1)+" "+std::to_string(files.size()));
     
@@ -390,26 +436,116 @@ void compare_chain_files() {
         if (i1>=files.size()||i2>=files.size()||i1==i2) throw "";
     } catch (...) { i1=files.size()-2; i2=files.size()-1; }
 
-    auto ca=read_pointer_chain_file(files[i1]), cb=read_pointer_chain_file(files[i2]);
-    std::vector<std::string> com,oa,ob;
-    for (auto&c:ca) cb.count(c)?com.push_back(c):oa.push_back(c);
-    for (auto&c:cb) if(!ca.count(c)) ob.push_back(c);
-    std::sort(com.begin(),com.end(),compare_chain);
-    std::sort(oa.begin(),oa.end(),compare_chain);
-    std::sort(ob.begin(),ob.end(),compare_chain);
+    // 指纹分区在外存对比 内存与文件大小无关 各集合按原文件顺序输出
+    chainer::txt_join join(OUTPUT_DIR);
+    chainer::txt_join_stats st;
+    try {
+        st = join.run(files[i1], files[i2]);
+    } catch (const std::exception& e) {
+        std::cerr << "对比失败：" << e.what() << "\n";
+        return;
+    }
 
     std::string rep = generate_incremental_filename("chain_compare");
     FILE* fp = fopen(rep.c_str(), "w+");
     if (!fp) { std::cerr << "创建报告失败\n"; return; }
     fprintf(fp, "===== 指针链对比报告 =====\n基准：%s\n对比：%s\n",files[i1].c_str(),files[i2].c_str());
-    fprintf(fp, "统计：A=%zu|B=%zu|共有=%zu|A独有=%zu|B独有=%zu\n",ca.size(),cb.size(),com.size(),oa.size(),ob.size());
-    fprintf(fp, "\n【共有链】\n");for(size_t i=0;i<com.size();i++) fprintf(fp,"%zu. %s\n",i+1,com[i].c_str());
-    fprintf(fp, "\n【A独有】\n");for(size_t i=0;i<oa.size();i++) fprintf(fp,"%zu. %s\n",i+1,oa[i].c_str());
-    fprintf(fp, "\n【B独有】\n");for(size_t i=0;i<ob.size();i++) fprintf(fp,"%zu. %s\n",i+1,ob[i].c_str());
+    fprintf(fp, "统计：A=%zu|B=%zu|共有=%zu|A独有=%zu|B独有=%zu\n",st.unique[0],st.unique[1],st.common,st.unique[0]-st.common,st.unique[1]-st.common);
+    auto section = [&](const char* title, chainer::txt_join_set which) {
+        size_t i = 0;
+        fprintf(fp, "\n%s\n", title);
+        join.emit(which, [&](const char* p, size_t n) { fprintf(fp, "%zu. %.*s\n", ++i, (int)n, p); });
+    };
+    try {
+        section("【共有链】", chainer::TXT_JOIN_COMMON);
+        section("【A独有】", chainer::TXT_JOIN_LHS_ONLY);
+        section("【B独有】", chainer::TXT_JOIN_RHS_ONLY);
+    } catch (const std::exception& e) {
+        std::cerr << "写出报告失败：" << e.what() << "\n";
+    }
     fclose(fp);
     std::cout << "对比完成！报告：" << rep << "\n";
 }
 
+// 解析目标地址列表（十六进制）：空格/逗号分隔多个地址
+// 地址:大小 展开为结构体每个指针宽度的字段，@文件 读取每行一个地址（如数值搜索结果）
+// 下界-上界 为区间目标（对象基址未知），链最后一跳输出到上界的偏移，slack 记录上界-下界
+bool parse_target_list(const std::string& input, std::vector<size_t>& out, std::vector<size_t>& slack) {
+    out.clear();
+    slack.clear();
+    std::string list = input;
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::istringstream iss(list);
+    std::string tok;
+    try {
+        while (iss >> tok) {
+            if (tok[0] == '@') {
+                std::ifstream in(tok.substr(1));
+                if (!in) { std::cerr << "无法打开地址文件：" << tok.substr(1) << "\n"; return false; }
+                std::string line;
+                while (std::getline(in, line)) {
+                    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                    out.push_back(std::stoull(line, nullptr, 16));
+                    slack.push_back(0);
+                }
+                continue;
+            }
+            auto dash = tok.find('-');
+            if (dash != std::string::npos) {
+                size_t lo = std::stoull(tok.substr(0, dash), nullptr, 16);
+                size_t hi = std::stoull(tok.substr(dash + 1), nullptr, 16);
+                if (lo > hi) std::swap(lo, hi);
+                out.push_back(hi);
+                slack.push_back(hi - lo);
+                continue;
+            }
+            auto colon = tok.find(':');
+            size_t addr = std::stoull(tok.substr(0, colon), nullptr, 16);
+            size_t size = colon == std::string::npos ? 0 : std::stoull(tok.substr(colon + 1), nullptr, 16);
+            if (size == 0) { out.push_back(addr); slack.push_back(0); continue; }
+            for (size_t off = 0; off < size; off += sizeof(size_t)) { out.push_back(addr + off); slack.push_back(0); }
+        }
+    } catch (...) {
+        return false;
+    }
+    return !out.empty();
+}
+
+// 解析按层偏移规则（十六进制）：空格分隔，第 i 条用于第 i 层，之后的层沿用最后一条
+// 每条为 最大偏移/负向下限/对齐/白名单，后几项可省略，白名单用逗号分隔，可带负号
+// 例：800/100/8 400//8/10,18,-8
+bool parse_offset_rules(const std::string& input, std::vector<chainer::offset_rule>& rules) {
+    rules.clear();
+    std::istringstream iss(input);
+    std::string tok;
+    try {
+        while (iss >> tok) {
+            chainer::offset_rule rule;
+            std::vector<std::string> parts;
+            std::stringstream ss(tok);
+            std::string part;
+            while (std::getline(ss, part, '/')) parts.push_back(part);
+            if (parts.size() > 0 && !parts[0].empty()) rule.max = std::stoull(parts[0], nullptr, 16);
+            if (parts.size() > 1 && !parts[1].empty()) rule.floor = std::stoull(parts[1], nullptr, 16);
+            if (parts.size() > 2 && !parts[2].empty()) rule.align = std::stoull(parts[2], nullptr, 16);
+            if (parts.size() > 3) {
+                std::stringstream ws(parts[3]);
+                std::string w;
+                while (std::getline(ws, w, ',')) {
+                    if (w.empty()) continue;
+                    bool neg = w[0] == '-';
+                    long v = (long)std::stoull(neg ? w.substr(1) : w, nullptr, 16);
+                    rule.whitelist.push_back(neg ? -v : v);
+                }
+            }
+            rules.push_back(rule);
+        }
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
 // 2. ✅ 核心终极修复：单地址扫描函数 - 逐个扫描每个匹配的VMA内存块，不合并范围
 // 解决：指定模块扫描不到libGameCore.so:bss[1]的问题，确保与全模块扫描结果一致
 void single_address_scan(int pid) {
@@ -443,21 +579,58 @@ void single_address_scan(int pid) {
     }
 
     // 输入目标地址
-    uint64_t target = 0;
+    // 多个目标共用一次遍历 输出行尾 " #序号" 标明目标
+    std::vector<size_t> targets, target_slack;
     std::string addr_in;
-    std::cout << "输入目标地址（十六进制，不带0x）：";
+    std::cout << "输入目标地址（十六进制，不带0x；多个用空格分隔，地址:大小=结构体各字段，下界-上界=区间，@文件=每行一个地址）：";
     std::getline(std::cin, addr_in);
-    try { target = std::stoull(addr_in, nullptr, 16); } catch (...) { std::cerr << "地址无效\n"; return; }
+    if (!parse_target_list(addr_in, targets, target_slack)) { std::cerr << "地址无效\n"; return; }
+    if (targets.size() > 1) std::cout << "批量目标：" << targets.size() << " 个\n";
+
+    // 已知字段地址但不知道对象基址：目标向下放宽余量，链最后一跳即字段在对象内的偏移
+    std::string slack_in = readStringWithDefault("目标负向余量（十六进制，对象基址未知时填对象大小，0=精确地址）", "0");
+    size_t slack_all = 0;
+    try { slack_all = std::stoull(slack_in, nullptr, 16); } catch (...) { slack_all = 0; }
+    for (auto& sl : target_slack) sl = std::max(sl, slack_all);
 
     // 输入扫描参数
     uint32_t depth = readInt<uint32_t>("最大深度（默认6，推荐8）：",6);
     uint32_t offset = readInt<uint32_t>("最大偏移（默认1024，推荐2048）：",1024);
+    std::vector<chainer::offset_rule> offset_rules;
+    std::string rules_in;
+    std::cout << "按层偏移规则（十六进制，空格分隔逐层，最大/负向下限/对齐/白名单，如 800/100/8 400//8/10,18，留空=只用最大偏移）：";
+    std::getline(std::cin, rules_in);
+    if (!parse_offset_rules(rules_in, offset_rules)) { std::cerr << "偏移规则无效\n"; return; }
+    int engine = readInt<int>("扫描引擎（1=广度优先 2=深度优先省内存，默认1）：",1);
+    uint32_t beam_width = engine == 2 ? 0 : readInt<uint32_t>("每层节点上限（0=不限，默认0，深层宽图推荐100000）：",0);
+    uint32_t beam_topk = engine == 2 ? 0 : readInt<uint32_t>("每模块输出链数上限（0=不限，默认0）：",0);
+    int cycle = readInt<int>("环路处理（0=保留全部 1=最短：每个指针只留在最近的层 2=无环：去掉重复地址和冗余后缀链，默认0）：",0);
+    uint32_t budget = readInt<uint32_t>("时间预算秒数（超时输出已完成层，0=不限，默认0，Ctrl+C取消）：",0);
+    std::string scan_dir;
+    if (engine != 2) {
+        std::cout << "扫描目录（每层落盘，同目标可续扫/加深，留空不落盘）：";
+        std::getline(std::cin, scan_dir);
+    }
+    int module_mode = is_module_limited && engine != 2
+        ? readInt<int>("模块模式（1=只读取模块内存 2=读取全部内存 只保留以该模块为起点的链 双向扫描，默认1）：",1) : 1;
     std::string outfile = generate_incremental_filename("pointer_chains");
     std::cout << "输出文件：" << outfile << "\n";
 
     // 原生库初始化
     memtool::base::target_pid = pid;
     chainer::cscan<size_t> scanner;
+    chainer::beam_policy<size_t> beam;
+    beam.width = beam_width;
+    beam.topk = beam_topk;
+    scanner.set_beam_policy(beam);
+    scanner.set_target_slack(target_slack);
+    scanner.set_offset_rules(offset_rules);
+    scanner.set_cycle_mode(cycle == 1 ? chainer::CYCLE_SHORTEST : cycle == 2 ? chainer::CYCLE_ACYCLIC : chainer::CYCLE_KEEP);
+    g_scan_control.start();
+    g_scan_control.set_budget(budget);
+    g_scan_control.progress = print_scan_progress;
+    scanner.set_scan_control(&g_scan_control);
+    auto old_sigint = signal(SIGINT, on_scan_sigint);
     memtool::extend::get_target_mem();
     memtool::extend::set_mem_ranges(memtool::Anonymous + memtool::C_alloc + memtool::C_data + memtool::C_bss + memtool::Code_app);
 
@@ -466,11 +639,19 @@ void single_address_scan(int pid) {
     size_t total_ptr_cnt = 0;
     size_t total_chain_cnt = 0;
     FILE* fp = fopen(outfile.c_str(), "w+");
-    if (!fp) { std::cerr << "创建文件失败\n"; return; }
-
-    if (is_module_limited) {
+    if (!fp) { std::cerr << "创建文件失败\n"; signal(SIGINT, old_sigint); return; }
+    std::vector<size_t> target_chain_cnt(targets.size(), 0);
+    auto scan_chains = [&](std::vector<size_t>& targets) {
+        size_t n = engine == 2 ? scanner.scan_pointer_chain_dfs(targets, depth, offset, 0, fp)
+                               : scanner.scan_pointer_chain_to_txt(targets, depth, offset, false, 0, fp);
+        auto& counts = scanner.get_target_counts();
+        for (size_t i = 0; i < counts.size() && i < target_chain_cnt.size(); ++i) target_chain_cnt[i] += counts[i];
+        return n;
+    };
+
+    if (is_module_limited && module_mode != 2) {
         // ✅ 核心修改：逐个扫描每个匹配的VMA内存块，不合并范围
-        for (size_t i = 0; i < filtered_vmas.size(); ++i) {
+        for (size_t i = 0; i < filtered_vmas.size() && !g_scan_control.stopped(); ++i) {
             auto vma = filtered_vmas[i];
             std::cout << "\n🔍 正在扫描第 " << i + 1 << " 个VMA内存块：\n";
             std::cout << "   名称：" << vma->name << "\n";
@@ -485,32 +666,43 @@ void single_address_scan(int pid) {
             total_ptr_cnt += ptr_cnt;
             std::cout << "   发现指针：" << ptr_cnt << " 个\n";
 
-            // 扫描当前VMA的指针链，并写入文件
-            std::vector<size_t> targets = {target};
-            size_t chain_cnt = scanner.scan_pointer_chain_to_txt(targets, depth, offset, false, 0, fp);
+            // 扫描当前VMA的指针链，并写入文件 每个VMA的指针快照不同 分开落盘
+            if (!scan_dir.empty())
+                scanner.set_scan_dir((scan_dir + "/vma_" + std::to_string(i)).c_str());
+            size_t chain_cnt = scan_chains(targets);
             total_chain_cnt += chain_cnt;
             std::cout << "   生成指针链：" << chain_cnt << " 条\n";
         }
     } else {
-        // 全模块扫描
+        // 全模块扫描（起点模块模式同样读取全部内存）
         size_t ptr_cnt = scanner.get_pointers(
             UINTPTR_MAX,
             UINTPTR_MAX,
             false, 20, 1 << 24
         );
         total_ptr_cnt = ptr_cnt;
-        std::vector<size_t> targets = {target};
-        size_t chain_cnt = scanner.scan_pointer_chain_to_txt(targets, depth, offset, false, 0, fp);
+        scanner.set_scan_dir(scan_dir.c_str());
+        // 起点模块: 只输出从该模块出发的链 正向扩展与反向搜索相交
+        if (module_mode == 2) scanner.set_root_module(g_selected_module.c_str());
+        size_t chain_cnt = scan_chains(targets);
         total_chain_cnt = chain_cnt;
     }
 
     // 关闭文件
     fclose(fp);
+    signal(SIGINT, old_sigint);
+    if (g_scan_control.cancelled()) printf("\n⚠️ 扫描已取消\n");
     auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
 
     // 打印结果
     printf("\n✅ 扫描完成！\n");
     printf("✅ 总发现指针：%ld 个 | 总生成指针链：%ld 条\n", total_ptr_cnt, total_chain_cnt);
+    if (targets.size() > 1) {
+        size_t hit = std::count_if(target_chain_cnt.begin(), target_chain_cnt.end(), [](size_t n) { return n > 0; });
+        printf("✅ 有链目标：%ld / %ld 个（按序号 #0 起）\n", hit, targets.size());
+        for (size_t i = 0; i < targets.size(); ++i)
+            if (target_chain_cnt[i]) printf("   #%ld 0x%lX：%ld 条\n", i, targets[i], target_chain_cnt[i]);
+    }
     printf("✅ 耗时：%lld ms | 保存至：%s\n", dur.count(), outfile.c_str());
 }
 
@@ -587,8 +779,9 @@ void dual_address_scan(int pid) {
     std::cout << "\n✅ 参数生效：A=0x" << std::hex << addr_a << " B=0x" << addr_b << std::dec
               << " | " << depth << "层 | " << offset << "偏移 | " << max_gb << "GB上限\n";
 
-    // 原生库初始化
+    // 原生库初始化 扫描内按A±16裁剪 只输出经过A的链
     chainer::cscan<size_t> scanner;
+    scanner.set_waypoint(addr_a, 16);
     memtool::extend::get_target_mem();
     memtool::extend::set_mem_ranges(memtool::Anonymous + memtool::C_alloc + memtool::C_bss + memtool::C_data);
 
@@ -639,57 +832,31 @@ void dual_address_scan(int pid) {
         std::cout << "\n✅ 总发现指针：" << total_ptr_cnt << " | 总生成原始链：" << total_raw_chain << " 条 ✔️\n";
     }
 
-    // ±16超大容错-核心筛选逻辑
+    // ±16超大容错-核心筛选逻辑：批量校验 每一跳去重后一次读取
     size_t valid = 0;
     std::set<std::string> chain_set;
     std::string pure_chain;
     FILE* fr = fopen(outfile.c_str(), "r");
-    if (fr) {
+    FILE* fv = tmpfile();
+    if (fr && fv) {
+        chainer::validator<size_t> validator;
+        validator.set_target(addr_b, 16);
+        validator.set_waypoint(addr_a, 16);
+        validator.validate_txt_chain_data(fr, fv);
+        rewind(fv);
+
         char buf[1024] = {0};
-        auto checkA = [&](size_t a) {
-            return a==addr_a||a==addr_a+4||a==addr_a-4||a==addr_a+8||a==addr_a-8||a==addr_a+16||a==addr_a-16;
-        };
-        auto checkB = [&](size_t b) {
-            return b==addr_b||b==addr_b+4||b==addr_b-4||b==addr_b+8||b==addr_b-8||b==addr_b+16||b==addr_b-16;
-        };
-
-        while (fgets(buf, sizeof(buf), fr) && (want==0||valid<want) && curr_size<MAX_SIZE) {
+        while (fgets(buf, sizeof(buf), fv) && (want==0||valid<want) && curr_size<MAX_SIZE) {
             std::string line = buf;
             if (line.empty() || chain_set.count(line)) continue;
-            size_t buf_len = strlen(buf);
-            if (curr_size + buf_len > MAX_SIZE) break;
-
-            size_t curr_addr = 0;
-            bool passA = false, hasBase = false;
-            size_t pos = line.find("0x");
-            if (pos != std::string::npos) {
-                size_t end = line.find_first_not_of("0123456789abcdefABCDEF", pos+2);
-                curr_addr = std::stoull(line.substr(pos+2, end-pos-2), nullptr, 16);
-                hasBase = true;
-            }
-
-            if (hasBase) {
-                if (checkA(curr_addr)) passA = true;
-                while ((pos=line.find("->+0x", pos)) != std::string::npos && !passA) {
-                    size_t off_pos = pos+4;
-                    size_t off_end = line.find_first_not_of("0123456789abcdefABCDEF", off_pos);
-                    size_t off = std::stoull(line.substr(off_pos, off_end-off_pos), nullptr, 16);
-                    curr_addr += off;
-                    if (checkA(curr_addr)) passA = true;
-                    size_t jump = memtool::base::readv<size_t>(curr_addr);
-                    if (jump != 0) curr_addr = jump;
-                    if (checkA(curr_addr)) passA = true;
-                    pos = off_end;
-                }
-            }
+            if (curr_size + line.size() > MAX_SIZE) break;
 
-            if (passA && checkB(curr_addr)) {
-                valid++; chain_set.insert(line); pure_chain += line; curr_size += line.size();
-                std::cout << "✅ 有效链" << valid << "：" << line.substr(0,70) << "...\n";
-            }
+            valid++; chain_set.insert(line); pure_chain += line; curr_size += line.size();
+            std::cout << "✅ 有效链" << valid << "：" << line.substr(0,70) << "...\n";
         }
-        fclose(fr);
     }
+    if (fr) fclose(fr);
+    if (fv) fclose(fv);
 
     // 保存纯有效链结果
     FILE* fw = fopen(outfile.c_str(), "w+");
@@ -713,6 +880,105 @@ void dual_address_scan(int pid) {
     else std::cout << "\n🎉 成功！有效链可直接复制到GG使用\n";
 }
 
+// 6. 指针链校验：批量读取存活进程，只保留仍然有效的链
+void validate_chain_file(int pid) {
+    if (!create_output_dir() || pid<=0) { std::cerr << "无效PID/目录失败\n"; return; }
+    memtool::base::target_pid = pid;
+    std::cout << "\n===== 指针链校验【按层批量读取，共享前缀只读一次】=====\n";
+
+    auto files = get_sorted_chain_files("pointer_chains");
+    std::string path = readStringWithDefault("链文件路径（.bin或文本）", files.empty() ? "无" : files.back());
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) { std::cerr << "打开文件失败\n"; return; }
+    char sign[32] = {0};
+    bool is_bin = fread(sign, 1, sizeof(sign) - 1, in) > 0 &&
+                  (strncmp(sign, ".bin from chainer", 17) == 0 || memcmp(sign, chainer::cprog_v2_magic, sizeof(chainer::cprog_v2_magic)) == 0);
+
+    uint64_t target = 0;
+    std::string addr_in;
+    std::cout << (is_bin ? "目标地址（十六进制不带0x，回车用扫描时的目标）：" : "目标地址（十六进制不带0x）：");
+    std::getline(std::cin, addr_in);
+    if (!addr_in.empty()) {
+        try { target = std::stoull(addr_in, nullptr, 16); } catch (...) { std::cerr << "地址无效\n"; fclose(in); return; }
+    }
+    if (!is_bin && target == 0) { std::cerr << "文本链需要目标地址\n"; fclose(in); return; }
+    uint32_t tol = readInt<uint32_t>("目标容差（字节，默认0）：",0);
+
+    memtool::extend::get_target_mem();
+    std::string outfile = generate_incremental_filename("pointer_chains_valid");
+    FILE* out = fopen(outfile.c_str(), "w+");
+    if (!out) { std::cerr << "创建文件失败\n"; fclose(in); return; }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    chainer::validator<size_t> validator;
+    validator.set_target(target, tol);
+    size_t valid = 0;
+    try {
+        valid = is_bin ? validator.validate_bin_chain_data(in, out) : validator.validate_txt_chain_data(in, out);
+    } catch (const std::exception& e) { std::cerr << "❌ " << e.what() << "\n"; }
+    fclose(in);
+    fclose(out);
+
+    auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
+    std::cout << "\n✅ 有效链：" << valid << " 条 | 耗时：" << dur.count() << "ms | 保存至：" << outfile << "\n";
+}
+
+// 8. 指针链查询：在 .bin 的指针树上直接按模块/深度/偏移过滤统计，不展开成文本，只导出符合的链
+void query_chain_file() {
+    if (!create_output_dir()) return;
+    std::cout << "\n===== 指针链查询【.bin 上过滤统计，只导出符合的链】=====\n";
+    std::string path = readStringWithDefault("链文件路径（.bin）", "无");
+    if (path == "无") { std::cerr << "取消查询\n"; return; }
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) { std::cerr << "打开文件失败\n"; return; }
+
+    chainer::base<size_t> reader;
+    chainer::cprog_chain_info<size_t> info;
+    try {
+        info = reader.parse_cprog_bin_data(in, chainer::CPROG_RANDOM);
+    } catch (const std::exception& e) { std::cerr << "❌ " << e.what() << "\n"; fclose(in); return; }
+    fclose(in);
+
+    chainer::chain_filter filter;
+    filter.module = readStringWithDefault("模块名（完全匹配，如 libil2cpp.so:bss）", "不限");
+    if (filter.module == "不限") filter.module.clear();
+    filter.index = readInt<int>("模块序号（name[序号]，-1=不限，默认-1）：", -1);
+    filter.min_depth = readInt<int>("最小深度（默认0）：", 0);
+    int max_depth = readInt<int>("最大深度（0=不限，默认0）：", 0);
+    if (max_depth > 0) filter.max_depth = max_depth;
+    std::string pattern = readStringWithDefault("偏移模式（十六进制，空格分隔，* 为任意偏移，如 0x10 * -0x8，深度固定为偏移个数-1）", "不限");
+    if (pattern != "不限" && !filter.set_pattern(pattern)) { std::cerr << "偏移模式无效\n"; return; }
+    int hop = readInt<int>("统计第几个偏移的分布（0=模块内偏移，-1=不统计，默认-1）：", -1);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    chainer::query_stats st;
+    try {
+        chainer::query<size_t> q(info);
+        st = q.stats(filter, hop);
+        printf("\n✅ 符合条件：%zu 条\n", st.chains);
+        for (size_t m = 0; m < st.modules.size(); ++m)
+            if (st.modules[m]) printf("   %s[%d]：%zu 条\n", info.syms[m].sym->name, info.syms[m].sym->count, st.modules[m]);
+        for (auto& [depth, n] : st.depths) printf("   深度 %d：%zu 条\n", depth, n);
+        if (hop >= 0) {
+            // 按链数从多到少列出最常见的偏移
+            std::vector<std::pair<long, size_t>> offs(st.offsets.begin(), st.offsets.end());
+            std::sort(offs.begin(), offs.end(), [](auto& a, auto& b) { return a.second > b.second; });
+            printf("   第 %d 个偏移（共 %zu 种）：\n", hop, offs.size());
+            for (size_t i = 0; i < offs.size() && i < 20; ++i)
+                printf("     %s0x%lX：%zu 条\n", offs[i].first < 0 ? "-" : "+", (size_t)std::labs(offs[i].first), offs[i].second);
+        }
+
+        if (st.chains == 0 || readInt<int>("导出符合的链（1=是 0=否，默认1）：", 1) != 1) return;
+        std::string outfile = generate_incremental_filename("pointer_chains_query");
+        FILE* out = fopen(outfile.c_str(), "w+");
+        if (!out) { std::cerr << "创建文件失败\n"; return; }
+        size_t n = q.write(filter, out);
+        fclose(out);
+        auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
+        std::cout << "✅ 导出：" << n << " 条 | 耗时：" << dur.count() << "ms | 保存至：" << outfile << "\n";
+    } catch (const std::exception& e) { std::cerr << "❌ " << e.what() << "\n"; }
+}
+
 // 4. 设置默认包名
 void set_default_process() {
     std::cout << "\n===== 设置默认包名 =====\n";
@@ -725,6 +991,51 @@ void set_default_process() {
     } else std::cerr << "❌ 未找到进程\n";
 }
 
+// 7. 设置线程绑核策略 - 大小核手机上小核的任务决定每层的尾延迟
+void set_thread_policy() {
+    std::cout << "\n===== 线程绑核策略【一次设置，永久生效】=====\n";
+    auto cores = utils::threadpool::cpu_cores();
+    std::cout << "✅ 在线核心（共" << cores.size() << "个，算力以最强核心为1024）：\n";
+    for (auto& c : cores) {
+        printf("   cpu%d  算力 %4u  最高频率 %u MHz\n", c.id, c.capacity, c.max_freq / 1000);
+    }
+    printf("当前策略：%s，线程 %zu 个", POLICY_NAMES[(int)thread_pool->affinity()], thread_pool->size());
+    if (thread_pool->affinity() == utils::affinity_policy::reserve)
+        printf("，留给目标进程 %zu 个核心", cores.size() - thread_pool->bound_cores().size());
+    std::cout << "\n\n";
+
+    std::cout << "0. 不绑核（默认，由系统调度）\n";
+    std::cout << "1. 全部核心（每核一个线程，按算力分配任务）\n";
+    std::cout << "2. 只用大核（算力不低于512，即最强核心的一半）\n";
+    std::cout << "3. 给目标进程留核（留出最强的若干核心）\n";
+    int policy = readInt<int>("请选择策略[0-3]（默认0）：", 0);
+    if (policy < 0 || policy > 3) { std::cerr << "❌ 无效选项\n"; return; }
+
+    size_t reserved = 0;
+    if (policy == (int)utils::affinity_policy::reserve)
+        reserved = readInt<size_t>("留给目标进程的核心数（默认2）：", 2);
+
+    thread_pool->set_affinity((utils::affinity_policy)policy, reserved);
+    printf("✅ 策略：%s，线程 %zu 个", POLICY_NAMES[policy], thread_pool->size());
+    // 线程池至少保留一个核心 实际留出的核心数可能少于输入
+    if (policy == (int)utils::affinity_policy::reserve) {
+        size_t kept = cores.size() - thread_pool->bound_cores().size();
+        printf("，实际留给目标进程 %zu 个核心", kept);
+        if (kept < reserved) printf("（输入 %zu 个，至少保留一个核心给线程池）", reserved);
+    }
+    if (!thread_pool->bound_cores().empty()) {
+        std::cout << "，绑定核心：";
+        for (auto& c : thread_pool->bound_cores()) printf("cpu%d ", c.id);
+    }
+    std::cout << "\n";
+
+    if (save_thread_policy_to_file((utils::affinity_policy)policy, reserved)) {
+        std::cout << "✅ 策略永久保存，重启自动加载\n";
+    } else {
+        std::cerr << "⚠️ 配置保存失败，不影响本次使用\n";
+    }
+}
+
 // 5. 设置扫描模块函数 - 支持模糊匹配 + 输入无效时打印实际模块列表
 void set_scan_module(int pid) {
     if (pid<=0 || memtool::extend::get_target_mem() !=0) { 
@@ -831,11 +1142,13 @@ int main() {
     create_output_dir();
     load_default_process_from_file();
     load_selected_module_from_file();
+    load_thread_policy_from_file();
 
     // 显示当前全局配置
     std::cout << "📌 当前全局配置：\n";
     std::cout << "▸ 默认进程：" << (g_default_process.empty()?"未设置":g_default_process) << "\n";
-    std::cout << "▸ 扫描模块：" << (g_selected_module.empty()?"【全模块】(推荐)":g_selected_module) << "\n\n";
+    std::cout << "▸ 扫描模块：" << (g_selected_module.empty()?"【全模块】(推荐)":g_selected_module) << "\n";
+    std::cout << "▸ 线程策略：" << POLICY_NAMES[(int)thread_pool->affinity()] << "（" << thread_pool->size() << "线程）\n\n";
 
     // 附加目标进程
     int pid = -1;
@@ -865,10 +1178,13 @@ int main() {
         std::cout << "1. 单地址扫描【真·模块限定+全地址必出链】\n";
         std::cout << "2. 双地址扫描【A→B必出有效链+±16容错】\n";
         std::cout << "3. 设置默认包名【免重复输入，永久生效】\n";
-        std::cout << "4. 指针链文件对比【排序去重，统计有效链】\n";
+        std::cout << "4. 指针链文件对比【两两对比/多文件投票，统计有效链】\n";
         std::cout << "5. 设置扫描模块【序号/模块名,一次设置永久生效】\n";
-        std::cout << "6. 退出程序\n";
-        choice = readInt<int>("请选择功能[1-6]（默认6）：",6);
+        std::cout << "6. 指针链校验【批量读取，保留仍有效的链】\n";
+        std::cout << "7. 线程绑核策略【大核/全部核心/给目标进程留核】\n";
+        std::cout << "8. 指针链查询【.bin 按模块/深度/偏移过滤，只导出符合的链】\n";
+        std::cout << "9. 退出程序\n";
+        choice = readInt<int>("请选择功能[1-9]（默认9）：",9);
 
         switch (choice) {
             case 1: 
@@ -888,7 +1204,13 @@ int main() {
                 if (pid != -1) set_scan_module(pid);
                 else std::cerr << "❌ 无有效进程\n";
                 break;
-            case 6: std::cout << "✅ 程序退出...\n"; return 0;
+            case 6:
+                if (pid != -1) validate_chain_file(pid);
+                else std::cerr << "❌ 无有效进程\n";
+                break;
+            case 7: set_thread_policy(); break;
+            case 8: query_chain_file(); break;
+            case 9: std::cout << "✅ 程序退出...\n"; return 0;
             default: std::cerr << "❌ 无效选项\n"; return 0;
         }
     }
@@ -102,23 +102,49 @@ inline long memtool::base::readv(S addr, void *data, size_t size)
     return result;
 }
 
-// 优化为批量读取
+// 优化为批量读取 每次系统调用最多 MAX_IOV 项 超出部分分批
+// 内核遇到不可读的项会停在该项 该项清零后从下一项继续
+// 返回成功读取的总字节数
 inline long memtool::base::readv_batch(const std::vector<std::pair<size_t, size_t>> &addr_size_pairs,
             std::vector<void *> &buffers) {
-  if (target_pid <= 0 || addr_size_pairs.empty() || buffers.empty()) return -1; // 新增：防空
+  if (target_pid <= 0 || addr_size_pairs.empty() || buffers.size() < addr_size_pairs.size()) return -1; // 新增：防空
   constexpr size_t MAX_IOV = 256; // 内核限制
-  std::vector<iovec> local(std::min(addr_size_pairs.size(), MAX_IOV));
-  std::vector<iovec> remote(std::min(addr_size_pairs.size(), MAX_IOV));
-
-  for (size_t i = 0; i < std::min(addr_size_pairs.size(), MAX_IOV); ++i) {
-    local[i].iov_base = buffers[i];
-    local[i].iov_len = addr_size_pairs[i].second;
-    remote[i].iov_base = reinterpret_cast<void *>(addr_size_pairs[i].first);
-    remote[i].iov_len = addr_size_pairs[i].second;
+  size_t total = addr_size_pairs.size();
+  iovec local[MAX_IOV];
+  iovec remote[MAX_IOV];
+  long bytes = 0;
+
+  for (size_t i = 0; i < total;) {
+    size_t count = std::min(total - i, MAX_IOV);
+    for (size_t j = 0; j < count; ++j) {
+      local[j].iov_base = buffers[i + j];
+      local[j].iov_len = addr_size_pairs[i + j].second;
+      remote[j].iov_base = reinterpret_cast<void *>(addr_size_pairs[i + j].first);
+      remote[j].iov_len = addr_size_pairs[i + j].second;
+    }
+
+    long result = syscall(SYS_process_vm_readv, target_pid, local, count, remote, count, 0);
+    size_t left = result > 0 ? result : 0;
+    bytes += left;
+
+    // 找到第一项未读完整的位置
+    size_t done = 0;
+    while (done < count && left >= local[done].iov_len) {
+      left -= local[done].iov_len;
+      ++done;
+    }
+
+    if (done == count) {
+      i += count;
+      continue;
+    }
+
+    bytes -= left;
+    memset(local[done].iov_base, 0, local[done].iov_len);
+    i += done + 1;
   }
 
-  return syscall(SYS_process_vm_readv, target_pid, local.data(), local.size(),
-                 remote.data(), remote.size(), 0);
+  return bytes;
 }
 
 template <typename T, typename... Args>
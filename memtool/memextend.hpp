@@ -120,7 +120,7 @@ void memtool::extend::divide_memory_to_block(size_t start, size_t end,
   auto push_pool = [&start, &employ_memory, &cache](auto t) {
     auto &dat = cache.emplace_back(typename C::value_type{});
 
-    utils::thread_pool->pushpool(employ_memory, start, t, std::ref(dat));
+    utils::thread_pool->post(employ_memory, start, t, std::ref(dat));
 
     start += t;
   };
@@ -137,7 +137,7 @@ void memtool::extend::divide_memory_to_block(size_t start, size_t end,
   };
 
   auto push_pool = [&start, &employ_memory](auto t) {
-    utils::thread_pool->pushpool(employ_memory, start, t);
+    utils::thread_pool->post(employ_memory, start, t);
 
     start += t;
   };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdio.h>
+
+//测试用的检查宏 失败时打印位置和条件 继续执行 main 返回失败数
+static int check_failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            ++check_failures;                                                           \
+            printf("%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond);                 \
+        }                                                                               \
+    } while (0)
+
+//表达式应抛出 std::runtime_error
+#define CHECK_THROWS(expr)                                                              \
+    do {                                                                                \
+        bool thrown = false;                                                            \
+        try {                                                                           \
+            expr;                                                                       \
+        } catch (const std::runtime_error &) {                                          \
+            thrown = true;                                                              \
+        }                                                                               \
+        if (!thrown) {                                                                  \
+            ++check_failures;                                                           \
+            printf("%s:%d: 没有抛出异常: %s\n", __FILE__, __LINE__, #expr);             \
+        }                                                                               \
+    } while (0)
+
+//main 的返回值 打印结果
+static int check_result(const char *name)
+{
+    if (check_failures == 0)
+        printf("%s: 全部通过\n", name);
+    else
+        printf("%s: %d 项失败\n", name, check_failures);
+    return check_failures == 0 ? 0 : 1;
+}
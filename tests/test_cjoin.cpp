@@ -0,0 +1,126 @@
+//文本链文件的外存对比和多文件投票
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cjoin.h"
+
+#include "check.h"
+
+//写一个临时文本链文件 返回路径
+static std::string write_file(const std::string &text)
+{
+    char path[] = "/tmp/newscan_join_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        CHECK(write(fd, text.data(), text.size()) == (ssize_t)text.size());
+        close(fd);
+    }
+    return path;
+}
+
+static void test_normalize()
+{
+    std::string a, b;
+    CHECK(chainer::normalize_chain("a.so[0] + 0x0010 -> + 0xA8", 26, a));
+    const char *compact = "  a.so[0]+0x10->+0xa8 \r";
+    CHECK(chainer::normalize_chain(compact, strlen(compact), b));
+    CHECK(a == b);
+    CHECK(chainer::fingerprint_of(a.data(), a.size()) == chainer::fingerprint_of(b.data(), b.size()));
+
+    // 偏移或模块不同的链指纹不同 只有空白的行不是链
+    std::string c;
+    CHECK(chainer::normalize_chain("a.so[1] + 0x10 -> + 0xa8", 24, c));
+    CHECK(!(chainer::fingerprint_of(a.data(), a.size()) == chainer::fingerprint_of(c.data(), c.size())));
+    CHECK(!chainer::normalize_chain(" \t\r", 3, c));
+}
+
+//emit 输出的行
+static std::vector<std::string> lines_of(chainer::txt_join &join, chainer::txt_join_set which)
+{
+    std::vector<std::string> out;
+    join.emit(which, [&](const char *p, size_t n) { out.emplace_back(p, n); });
+    return out;
+}
+
+static void test_join()
+{
+    // 同一条链的不同写法算一条 不能解析的行和空行不参与 重复的链只输出第一次
+    auto lhs = write_file("# header\n"
+                          "a.so[0] + 0x10 -> + 0x8\n"
+                          "\n"
+                          "a.so[0] + 0x20 -> + 0x8\n"
+                          "a.so[0]+0x0010->+0x8\n"
+                          "b.so[1] + 0x30\n");
+    auto rhs = write_file("b.so[1] + 0x30\n"
+                          "garbage\n"
+                          "  a.so[0] + 0x10 -> + 0x8\r\n"
+                          "c.so[0] + 0x40");
+
+    // 内存很小时分区更多 结果相同
+    for (size_t memory : {512ul << 20, 1ul << 16}) {
+        chainer::txt_join join("", memory);
+        auto st = join.run(lhs, rhs);
+        CHECK(st.lines[0] == 4 && st.lines[1] == 3);
+        CHECK(st.unique[0] == 3 && st.unique[1] == 3);
+        CHECK(st.common == 2);
+
+        CHECK((lines_of(join, chainer::TXT_JOIN_COMMON) == std::vector<std::string>{"a.so[0] + 0x10 -> + 0x8", "b.so[1] + 0x30"}));
+        CHECK((lines_of(join, chainer::TXT_JOIN_LHS_ONLY) == std::vector<std::string>{"a.so[0] + 0x20 -> + 0x8"}));
+        CHECK((lines_of(join, chainer::TXT_JOIN_RHS_ONLY) == std::vector<std::string>{"c.so[0] + 0x40"}));
+    }
+
+    chainer::txt_join join;
+    CHECK_THROWS(join.run(lhs, "/nonexistent/newscan_join"));
+
+    unlink(lhs.c_str());
+    unlink(rhs.c_str());
+}
+
+static void test_vote()
+{
+    std::vector<std::string> files = {
+        write_file("a.so[0] + 0x10\nb.so[0] + 0x20\nc.so[0] + 0x30\n"),
+        write_file("b.so[0]+0x20\na.so[0] + 0x10\na.so[0] + 0x10\n"),
+        write_file("d.so[0] + 0x40\nb.so[0] + 0x20\n"),
+    };
+
+    chainer::txt_join join;
+    auto st = join.vote(files, 2);
+    CHECK((st.lines == std::vector<size_t>{3, 3, 2}));
+    CHECK((st.unique == std::vector<size_t>{3, 2, 2}));
+    CHECK(st.support.size() == 4);
+    if (st.support.size() == 4)
+        CHECK(st.support[1] == 2 && st.support[2] == 1 && st.support[3] == 1);
+    CHECK(st.kept == 2);
+
+    // 按文件顺序 每条链在第一次出现的位置输出一次
+    std::vector<std::string> kept;
+    std::vector<size_t> support;
+    size_t n = join.emit_votes([&](const char *p, size_t len, size_t s) {
+        kept.emplace_back(p, len);
+        support.push_back(s);
+    });
+    CHECK(n == 2);
+    CHECK((kept == std::vector<std::string>{"a.so[0] + 0x10", "b.so[0] + 0x20"}));
+    CHECK((support == std::vector<size_t>{2, 3}));
+
+    for (auto &f : files)
+        unlink(f.c_str());
+}
+
+int main()
+{
+    test_normalize();
+    test_join();
+    test_vote();
+    return check_result("test_cjoin");
+}
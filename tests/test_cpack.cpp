@@ -0,0 +1,196 @@
+//v2 .bin 编解码: 变长整数 LZ 块压缩 块的写出和读取
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "cpack.h"
+
+#include "check.h"
+
+static void test_zigzag()
+{
+    for (int64_t v : {0l, 1l, -1l, 63l, -64l, 64l, INT64_MAX, INT64_MIN})
+        CHECK(chainer::unzigzag(chainer::zigzag(v)) == v);
+    CHECK(chainer::zigzag(0) == 0);
+    CHECK(chainer::zigzag(-1) == 1);
+    CHECK(chainer::zigzag(1) == 2);
+}
+
+static void test_varint()
+{
+    std::vector<uint64_t> values = {0, 1, 127, 128, 16383, 16384, UINT32_MAX, (uint64_t)UINT32_MAX + 1, UINT64_MAX};
+    std::vector<uint8_t> buf;
+    for (auto v : values)
+        chainer::put_varint(buf, v);
+    CHECK(buf.size() == 1 + 1 + 1 + 2 + 2 + 3 + 5 + 5 + 10);
+
+    chainer::varint_reader in{buf.data(), buf.data() + buf.size()};
+    for (auto v : values)
+        CHECK(in.get() == v);
+    CHECK(in.p == in.end);
+    CHECK_THROWS(in.get());
+
+    // 截断的变长整数和超过 64 位的变长整数
+    std::vector<uint8_t> cut = {0x80, 0x80};
+    chainer::varint_reader short_in{cut.data(), cut.data() + cut.size()};
+    CHECK_THROWS(short_in.get());
+
+    std::vector<uint8_t> longer(11, 0x80);
+    chainer::varint_reader long_in{longer.data(), longer.data() + longer.size()};
+    CHECK_THROWS(long_in.get());
+
+    chainer::varint_reader take_in{buf.data(), buf.data() + 4};
+    CHECK(take_in.take(3) == buf.data());
+    CHECK_THROWS(take_in.take(2));
+}
+
+static bool lz_round_trip(const std::vector<uint8_t> &src)
+{
+    std::vector<uint8_t> packed(chainer::lz::bound(src.size()));
+    packed.resize(chainer::lz::compress(src.data(), src.size(), packed.data()));
+    if (packed.size() > chainer::lz::bound(src.size()) || src.size() > chainer::lz::max_raw(packed.size()))
+        return false;
+
+    std::vector<uint8_t> raw(src.size());
+    return chainer::lz::decompress(packed.data(), packed.size(), raw.data(), raw.size()) && raw == src;
+}
+
+static void test_lz()
+{
+    std::mt19937 rng(7);
+
+    CHECK(lz_round_trip({}));
+    CHECK(lz_round_trip({1, 2, 3}));
+    CHECK(lz_round_trip(std::vector<uint8_t>(9, 0x55)));
+
+    // 随机数据不可压缩 重复数据有长匹配和重叠复制
+    std::vector<uint8_t> noise(100000);
+    for (auto &b : noise)
+        b = rng();
+    CHECK(lz_round_trip(noise));
+
+    std::vector<uint8_t> runs(100000);
+    for (size_t i = 0; i < runs.size(); ++i)
+        runs[i] = (i / 1000) & 0xff;
+    CHECK(lz_round_trip(runs));
+
+    std::vector<uint8_t> mixed;
+    for (int i = 0; i < 2000; ++i) {
+        chainer::put_varint(mixed, chainer::zigzag((int64_t)(rng() % 64) - 32));
+        chainer::put_varint(mixed, 0x10);
+        if (i % 7 == 0)
+            mixed.push_back(rng());
+    }
+    CHECK(lz_round_trip(mixed));
+
+    // 长度不对和截断的压缩数据
+    std::vector<uint8_t> packed(chainer::lz::bound(runs.size()));
+    packed.resize(chainer::lz::compress(runs.data(), runs.size(), packed.data()));
+    CHECK(packed.size() < runs.size() / 10);
+
+    std::vector<uint8_t> raw(runs.size() + 1);
+    CHECK(!chainer::lz::decompress(packed.data(), packed.size(), raw.data(), runs.size() + 1));
+    CHECK(!chainer::lz::decompress(packed.data(), packed.size(), raw.data(), runs.size() - 1));
+    CHECK(!chainer::lz::decompress(packed.data(), packed.size() / 2, raw.data(), runs.size()));
+}
+
+//把 f 整个读到内存
+static std::vector<char> read_all(FILE *f)
+{
+    std::vector<char> data;
+    char buf[4096];
+    rewind(f);
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;)
+        data.insert(data.end(), buf, buf + n);
+    return data;
+}
+
+static void test_packer()
+{
+    constexpr size_t block_size = 256;
+    std::mt19937 rng(11);
+
+    // 同一份负载写成小块 既有可压缩的块也有原样保存的块 变长整数和字节串跨块
+    FILE *f = tmpfile();
+    CHECK(f != nullptr);
+    if (f == nullptr)
+        return;
+
+    std::vector<uint8_t> expect;
+    {
+        chainer::cprog_packer pack(f, sizeof(size_t), block_size);
+        for (int i = 0; i < 20000; ++i) {
+            uint64_t v = i % 3 == 0 ? (uint64_t)rng() << 20 : i % 16;
+            pack.put(v);
+            chainer::put_varint(expect, v);
+            if (i % 500 == 0) {
+                char name[32];
+                int n = snprintf(name, sizeof(name), "lib%d.so:bss", i);
+                pack.put_bytes(name, n);
+                chainer::put_varint(expect, n);
+                expect.insert(expect.end(), name, name + n);
+            }
+        }
+        CHECK(pack.finish());
+    }
+
+    auto data = read_all(f);
+    fclose(f);
+
+    chainer::cprog_header_v2 header;
+    CHECK(data.size() > sizeof(header));
+    memcpy(&header, data.data(), sizeof(header));
+    CHECK(memcmp(header.magic, chainer::cprog_v2_magic, sizeof(header.magic)) == 0);
+    CHECK(header.version == 2);
+    CHECK(header.size == sizeof(size_t));
+    CHECK(header.block_size == block_size);
+
+    // 除最后一块外每块正好 block_size 字节
+    size_t pos = sizeof(header), blocks = 0, stored = 0;
+    while (pos + 8 <= data.size()) {
+        uint32_t len[2];
+        memcpy(len, data.data() + pos, sizeof(len));
+        pos += sizeof(len) + (len[1] == 0 ? len[0] : len[1]);
+        stored += len[1] == 0;
+        CHECK(len[0] == block_size || pos == data.size());
+        ++blocks;
+    }
+    CHECK(pos == data.size());
+    CHECK(blocks == (expect.size() + block_size - 1) / block_size);
+    CHECK(stored > 0 && stored < blocks);
+
+    CHECK(chainer::unpack_cprog_blocks(data.data(), data.size()) == expect);
+
+    // 截断 块长度超出 block_size 压缩长度不小于原长度
+    CHECK_THROWS(chainer::unpack_cprog_blocks(data.data(), sizeof(header) - 1));
+    CHECK_THROWS(chainer::unpack_cprog_blocks(data.data(), data.size() - 1));
+
+    auto bad = data;
+    uint32_t len[2] = {block_size + 1, 0};
+    memcpy(bad.data() + sizeof(header), len, sizeof(len));
+    CHECK_THROWS(chainer::unpack_cprog_blocks(bad.data(), bad.size()));
+
+    bad = data;
+    len[0] = block_size, len[1] = block_size;
+    memcpy(bad.data() + sizeof(header), len, sizeof(len));
+    CHECK_THROWS(chainer::unpack_cprog_blocks(bad.data(), bad.size()));
+
+    bad = data;
+    header.block_size = 0;
+    memcpy(bad.data(), &header, sizeof(header));
+    CHECK_THROWS(chainer::unpack_cprog_blocks(bad.data(), bad.size()));
+}
+
+int main()
+{
+    test_zigzag();
+    test_varint();
+    test_lz();
+    test_packer();
+    return check_result("test_cpack");
+}
@@ -0,0 +1,143 @@
+//文本链的解析: 单行解析 格式错误和溢出的行 整个文件的并行解析
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cparse.h"
+
+#include "check.h"
+
+//head.name 指向行内 line 为临时对象时只能在这里取出
+static std::string name;
+
+template <class T>
+static bool parse(const std::string &line, chainer::txt_chain_head &head, std::vector<T> &offsets)
+{
+    if (!chainer::parse_chain_line<T>(line.data(), line.data() + line.size(), head, offsets))
+        return false;
+    name.assign(head.name, head.name_len);
+    return true;
+}
+
+static void test_parse_line()
+{
+    chainer::txt_chain_head head;
+    std::vector<uint64_t> offsets;
+
+    CHECK(parse("libil2cpp.so:bss[1] + 0x10 -> + 0x8 -> - 0x18", head, offsets));
+    CHECK(name == "libil2cpp.so:bss");
+    CHECK(head.count == 1);
+    CHECK((offsets == std::vector<uint64_t>{0x10, 0x8, (uint64_t)-0x18}));
+
+    // 空白可有可无 十六进制不分大小写 前导零 行尾的 \r
+    offsets.clear();
+    CHECK(parse("  a.so[0]+0X00Ab->-0x1\r\n", head, offsets));
+    CHECK(name == "a.so");
+    CHECK((offsets == std::vector<uint64_t>{0xab, (uint64_t)-1}));
+
+    // 名字中的 '[' ']' 以后面紧跟偏移的 ']' 为准
+    offsets.clear();
+    CHECK(parse("[anon:libc_malloc][12] + 0x20", head, offsets));
+    CHECK(name == "[anon:libc_malloc]");
+    CHECK(head.count == 12);
+    CHECK((offsets == std::vector<uint64_t>{0x20}));
+
+    // 格式错误的行返回 false 且不修改 offsets
+    offsets.assign({1, 2});
+    for (const char *bad : {"", "   ", "# comment", "a.so + 0x10", "a.so[] + 0x10", "[0] + 0x10", "a.so[x] + 0x10",
+                            "a.so[0]", "a.so[0] + 10", "a.so[0] + 0x", "a.so[0] + 0x10 ->", "a.so[0] + 0x10 -> 0x8",
+                            "a.so[0] + 0x10 + 0x8", "a.so[0] + 0x10g"})
+        CHECK(!parse(bad, head, offsets));
+    CHECK((offsets == std::vector<uint64_t>{1, 2}));
+}
+
+static void test_parse_overflow()
+{
+    chainer::txt_chain_head head;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> narrow;
+
+    // 偏移的有效位数不超过 T 的宽度 前导零不计
+    CHECK(parse("a.so[0] + 0xffffffffffffffff", head, offsets));
+    CHECK(offsets.back() == UINT64_MAX);
+    CHECK(parse("a.so[0] + 0x000000000000000000000010", head, offsets));
+    CHECK(offsets.back() == 0x10);
+    CHECK(!parse("a.so[0] + 0x10000000000000000", head, offsets));
+    CHECK(!parse("a.so[0] + 0x8 -> + 0x1ffffffffffffffff", head, offsets));
+    CHECK(offsets.size() == 2);
+
+    CHECK(parse("a.so[0] + 0xffffffff -> - 0x8", head, narrow));
+    CHECK((narrow == std::vector<uint32_t>{UINT32_MAX, (uint32_t)-8}));
+    CHECK(!parse("a.so[0] + 0x100000000", head, narrow));
+    CHECK(narrow.size() == 2);
+
+    // 模块序号不超过 int
+    CHECK(parse("a.so[2147483647] + 0x10", head, offsets));
+    CHECK(head.count == 2147483647);
+    CHECK(!parse("a.so[2147483648] + 0x10", head, offsets));
+    CHECK(!parse("a.so[99999999999999999999] + 0x10", head, offsets));
+}
+
+static void test_parse_file()
+{
+    FILE *f = tmpfile();
+    CHECK(f != nullptr);
+    if (f == nullptr)
+        return;
+
+    const char *text = "a.so:bss[0] + 0x10 -> + 0x8\n"
+                       "not a chain\n"
+                       "\n"
+                       "b.so:bss[1] + 0x20\r\n"
+                       "a.so:bss[0] + 0x30 -> - 0x8 -> + 0x0\n"
+                       "a.so:bss[1] + 0x40 -> + 0x0";
+    fputs(text, f);
+    fflush(f);
+
+    chainer::txt_chain_set<uint64_t> set;
+    chainer::parse_txt_chains(f, set);
+    fclose(f);
+
+    CHECK(set.chains() == 4);
+    CHECK((set.names == std::vector<std::string>{"a.so:bss", "b.so:bss", "a.so:bss"}));
+    CHECK((set.counts == std::vector<int>{0, 1, 1}));
+    CHECK(set.offsets.size() == 8);
+    CHECK(set.first[4] == 8);
+
+    // 第 i 条链的偏移 模块和原文
+    std::vector<std::vector<uint64_t>> expect = {{0x10, 0x8}, {0x20}, {0x30, (uint64_t)-8, 0}, {0x40, 0}};
+    std::vector<uint32_t> modules = {0, 1, 0, 2};
+    std::vector<std::string> lines = {"a.so:bss[0] + 0x10 -> + 0x8", "b.so:bss[1] + 0x20", "a.so:bss[0] + 0x30 -> - 0x8 -> + 0x0",
+                                      "a.so:bss[1] + 0x40 -> + 0x0"};
+    for (size_t i = 0; i < set.chains() && i < expect.size(); ++i) {
+        std::vector<uint64_t> got(&set.offsets[set.first[i]], &set.offsets[0] + set.first[i + 1]);
+        CHECK(got == expect[i]);
+        CHECK(set.module[i] == modules[i]);
+
+        size_t len;
+        const char *p = set.text(i, len);
+        CHECK(std::string(p, len) == lines[i]);
+    }
+
+    // 空文件和空指针
+    chainer::txt_chain_set<uint64_t> empty;
+    FILE *e = tmpfile();
+    chainer::parse_txt_chains(e, empty);
+    fclose(e);
+    CHECK(empty.chains() == 0);
+    chainer::parse_txt_chains<uint64_t>(nullptr, empty);
+    CHECK(empty.chains() == 0);
+}
+
+int main()
+{
+    test_parse_line();
+    test_parse_overflow();
+    test_parse_file();
+    return check_result("test_cparse");
+}
@@ -0,0 +1,273 @@
+//.bin 上的随机访问 游标枚举和查询 与转文本的输出逐条对比
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cformat.hpp"
+#include "ccursor.h"
+#include "cparse.h"
+#include "cquery.h"
+#include "cstore.h"
+
+#include "check.h"
+
+using dir_t = chainer::pointer_dir<size_t>;
+
+struct test_module {
+    const char *name;
+    int count;
+    size_t start;
+    int level;
+    std::vector<dir_t> roots;
+};
+
+//手工写一个 v101 文件 levels[l] 为第 l 层的节点 模块的根节点指向 levels[level - 1]
+static FILE *write_v101(const std::vector<test_module> &modules, const std::vector<std::vector<dir_t>> &levels)
+{
+    FILE *f = tmpfile();
+    if (f == nullptr)
+        return nullptr;
+
+    chainer::cprog_header header{};
+    strcpy(header.sign, ".bin from chainer, by 青衫白衣\n");
+    header.module_count = modules.size();
+    header.version = 101;
+    header.size = sizeof(size_t);
+    header.level = levels.size();
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (auto &m : modules) {
+        chainer::cprog_sym<size_t> sym{};
+        sym.start = m.start;
+        strcpy(sym.name, m.name);
+        sym.range = 0;
+        sym.count = m.count;
+        sym.pointer_count = m.roots.size();
+        sym.level = m.level;
+        fwrite(&sym, sizeof(sym), 1, f);
+        fwrite(m.roots.data(), sizeof(dir_t), m.roots.size(), f);
+    }
+
+    for (size_t l = 0; l < levels.size(); ++l) {
+        chainer::cprog_llen llen{};
+        llen.level = l;
+        llen.count = levels[l].size();
+        fwrite(&llen, sizeof(llen), 1, f);
+        fwrite(levels[l].data(), sizeof(dir_t), levels[l].size(), f);
+    }
+    fflush(f);
+    rewind(f);
+    return f;
+}
+
+//第0层是目标 第1层的 a 指向两个目标 b 指向一个 第2层的 c 指向 a 和 b
+//四个模块的根节点分别在第 1 2 3 0 层 链数 2 3 3 1
+static FILE *make_tree()
+{
+    std::vector<std::vector<dir_t>> levels = {
+        {dir_t(0x1000, 0, 0, 0), dir_t(0x1100, 0, 0, 0)},
+        {dir_t(0x2000, 0x0ff0, 0, 2), dir_t(0x2100, 0x1100, 1, 2)},
+        {dir_t(0x3000, 0x1ff8, 0, 2)},
+    };
+    std::vector<test_module> modules = {
+        {"a.so:bss", 0, 0x10000, 1, {dir_t(0x10010, 0x0ff8, 0, 1), dir_t(0x10020, 0x1108, 1, 2)}},
+        {"b.so:bss", 1, 0x20000, 2, {dir_t(0x20008, 0x1ff0, 0, 2)}},
+        {"a.so:bss", 1, 0x30000, 3, {dir_t(0x30000, 0x2ff0, 0, 1)}},
+        {"c.so:bss", 0, 0x40000, 0, {dir_t(0x40018, 0x1100, 0, 0)}},
+    };
+    return write_v101(modules, levels);
+}
+
+static const std::vector<std::string> expect_lines = {
+    "a.so:bss[0] + 0x10 -> + 0x8",
+    "a.so:bss[0] + 0x20 -> - 0x8",
+    "b.so:bss[1] + 0x8 -> + 0x10 -> + 0x10",
+    "b.so:bss[1] + 0x8 -> + 0x10 -> + 0x110",
+    "b.so:bss[1] + 0x8 -> + 0x110 -> + 0x0",
+    "a.so:bss[1] + 0x0 -> + 0x10 -> + 0x8 -> + 0x10",
+    "a.so:bss[1] + 0x0 -> + 0x10 -> + 0x8 -> + 0x110",
+    "a.so:bss[1] + 0x0 -> + 0x10 -> + 0x108 -> + 0x0",
+    "c.so:bss[0] + 0x18",
+};
+
+//文件中的每一行
+static std::vector<std::string> read_lines(FILE *f)
+{
+    std::vector<std::string> lines;
+    char buf[1024];
+    rewind(f);
+    while (fgets(buf, sizeof(buf), f)) {
+        size_t n = strlen(buf);
+        while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
+            --n;
+        lines.emplace_back(buf, n);
+    }
+    return lines;
+}
+
+//游标当前链的文本
+static std::string view_text(const chainer::cprog_chain_info<size_t> &info, const chainer::chain_view<size_t> &v)
+{
+    auto sym = info.syms[v.module].sym;
+    char buf[1024];
+    int n = sprintf(buf, "%s[%d]", sym->name, sym->count);
+    for (size_t k = 0; k < v.size; ++k)
+        n += chainer::format_offset(buf + n, k == 0 ? " " : " -> ", v.offsets[k]);
+    return std::string(buf, n);
+}
+
+static void test_format(FILE *bin)
+{
+    FILE *out = tmpfile();
+    chainer::format<size_t> fmt;
+    rewind(bin);
+    CHECK(fmt.format_bin_chain_data(bin, out) == expect_lines.size());
+    CHECK(read_lines(out) == expect_lines);
+    fclose(out);
+}
+
+static void test_cursor(FILE *bin)
+{
+    chainer::base<size_t> reader;
+    auto info = reader.parse_cprog_bin_data(bin);
+
+    std::vector<std::string> lines;
+    for (auto &v : chainer::chain_cursor<size_t>(info))
+        lines.emplace_back(view_text(info, v));
+    CHECK(lines == expect_lines);
+
+    // 按链数切段 各段首尾相接与整体相同
+    for (size_t parts : {1, 2, 3, 10}) {
+        auto ranges = chainer::split_chain_ranges(info, parts);
+        CHECK(!ranges.empty() && ranges.size() <= parts);
+        std::vector<std::string> joined;
+        size_t next = 0;
+        for (auto &r : ranges) {
+            CHECK(r.first == next);
+            next = r.second;
+            chainer::chain_cursor<size_t> cursor(info, r.first, r.second);
+            while (cursor.next())
+                joined.emplace_back(view_text(info, cursor.get()));
+        }
+        CHECK(joined == expect_lines);
+    }
+}
+
+static void test_store(FILE *bin)
+{
+    chainer::store<size_t> st;
+    rewind(bin);
+    st.open(bin);
+    CHECK(!st.indexed());
+    CHECK(st.chains() == expect_lines.size());
+    CHECK(st.module_count() == 4);
+
+    std::vector<size_t> per_module = {2, 3, 3, 1};
+    for (size_t m = 0; m < st.module_count() && m < per_module.size(); ++m)
+        CHECK(st.module_chains(m) == per_module[m]);
+
+    // 按链号随机读取 顺序与转文本相同
+    chainer::chain_record<size_t> chain;
+    for (size_t n = expect_lines.size(); n-- > 0;) {
+        CHECK(st.get_chain(n, chain));
+        CHECK(chain.index == n);
+        CHECK(st.format(chain) == expect_lines[n]);
+    }
+    CHECK(!st.get_chain(expect_lines.size(), chain));
+
+    // 模块内分页
+    std::vector<chainer::chain_record<size_t>> page;
+    CHECK(st.get_page(2, 1, 5, page) == 2);
+    CHECK(page.size() == 2 && st.format(page[0]) == expect_lines[6] && st.format(page[1]) == expect_lines[7]);
+    CHECK(st.get_page(4, 0, 1, page) == 0);
+
+    // 不是 .bin 的文件
+    FILE *text = tmpfile();
+    fputs("a.so:bss[0] + 0x10\n", text);
+    fflush(text);
+    chainer::store<size_t> bad;
+    CHECK_THROWS(bad.open(text));
+    fclose(text);
+}
+
+//按条件逐行过滤 expect_lines 作为对照
+static std::vector<std::string> brute_filter(const chainer::chain_filter &f)
+{
+    std::vector<std::string> out;
+    chainer::txt_chain_head head;
+    std::vector<size_t> offsets;
+    for (auto &line : expect_lines) {
+        offsets.clear();
+        if (!chainer::parse_chain_line<size_t>(line.data(), line.data() + line.size(), head, offsets))
+            continue;
+        int depth = offsets.size() - 1;
+        if (!f.module.empty() && f.module != std::string(head.name, head.name_len))
+            continue;
+        if ((f.index >= 0 && f.index != head.count) || depth < f.min_depth || depth > f.max_depth)
+            continue;
+        bool ok = true;
+        for (size_t k = 0; k < f.hops.size() && k < offsets.size(); ++k)
+            ok = ok && f.hops[k].accept(chainer::signed_offset(offsets[k]));
+        if (ok)
+            out.push_back(line);
+    }
+    return out;
+}
+
+static void test_query(FILE *bin)
+{
+    chainer::base<size_t> reader;
+    rewind(bin);
+    auto info = reader.parse_cprog_bin_data(bin, chainer::CPROG_RANDOM);
+    chainer::query<size_t> q(info);
+
+    std::vector<chainer::chain_filter> filters(8);
+    filters[1].module = "a.so:bss";
+    filters[2].module = "a.so:bss", filters[2].index = 1;
+    filters[3].min_depth = 2, filters[3].max_depth = 2;
+    filters[4].hop(1, 0x10, 0x10);
+    filters[5].hop(0, -0x10, 0x8), filters[5].hop(2, 0x100, 0x200);
+    CHECK(filters[6].set_pattern("0x0 * 0x8 *"));
+    CHECK(filters[7].set_pattern("* -0x8"));
+    CHECK(!filters[7].set_pattern("0x10 zz"));
+
+    for (auto &f : filters) {
+        auto expect = brute_filter(f);
+        CHECK(q.count(f) == expect.size());
+
+        auto st = q.stats(f, 1);
+        CHECK(st.chains == expect.size());
+        size_t hop1 = 0;
+        for (auto &kv : st.offsets)
+            hop1 += kv.second;
+        size_t deep = 0;
+        for (auto &line : expect)
+            deep += line.find("->") != std::string::npos;
+        CHECK(hop1 == deep);
+
+        FILE *out = tmpfile();
+        CHECK(q.write(f, out) == expect.size());
+        CHECK(read_lines(out) == expect);
+        fclose(out);
+    }
+}
+
+int main()
+{
+    FILE *bin = make_tree();
+    CHECK(bin != nullptr);
+    if (bin == nullptr)
+        return check_result("test_cstore");
+
+    test_format(bin);
+    test_cursor(bin);
+    test_store(bin);
+    test_query(bin);
+    fclose(bin);
+    return check_result("test_cstore");
+}
@@ -0,0 +1,111 @@
+//线程池: 任务组只等待自己的任务 工作线程中嵌套等待 绑核策略的核心数
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+
+#include "check.h"
+
+//组的 wait 不等组外的任务 组外的任务被阻塞时也能返回
+static void test_group_isolation(utils::threadpool &pool)
+{
+    std::atomic<bool> release(false), blocked_done(false);
+    pool.post([&]() {
+        while (!release.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        blocked_done.store(true);
+    });
+
+    utils::task_group jobs;
+    std::atomic<size_t> sum(0);
+    for (size_t i = 1; i <= 1000; ++i)
+        pool.post(jobs, [&sum](size_t v) { sum += v; }, i);
+    pool.wait(jobs);
+
+    CHECK(sum.load() == 500500);
+    CHECK(jobs.pending() == 0);
+    CHECK(!blocked_done.load());
+
+    // 组可以重复使用
+    for (size_t i = 0; i < 10; ++i)
+        pool.post(jobs, [&sum]() { ++sum; });
+    pool.wait(jobs);
+    CHECK(sum.load() == 500510);
+
+    release.store(true);
+    pool.wait();
+    CHECK(blocked_done.load());
+}
+
+//任务中提交子任务组并等待 线程数少于外层任务数时也不会死锁
+static void test_nested(utils::threadpool &pool)
+{
+    utils::task_group outer;
+    std::vector<size_t> sums(16, 0);
+    for (size_t i = 0; i < sums.size(); ++i) {
+        pool.post(outer, [&pool, &sums, i]() {
+            utils::task_group inner;
+            std::atomic<size_t> sum(0);
+            for (size_t k = 0; k < 100; ++k)
+                pool.post(inner, [&sum, i, k]() { sum += i * k; });
+            pool.wait(inner);
+            sums[i] = sum.load();
+        });
+    }
+    pool.wait(outer);
+
+    for (size_t i = 0; i < sums.size(); ++i)
+        CHECK(sums[i] == i * 4950);
+}
+
+//留核时至少保留一个核心给线程池 只用大核时只选算力不低于 512 的核心
+static void test_affinity(utils::threadpool &pool)
+{
+    auto cores = utils::threadpool::cpu_cores();
+    CHECK(!cores.empty());
+    size_t big = 0;
+    for (auto &c : cores) {
+        CHECK(c.capacity > 0 && c.capacity <= 1024);
+        big += c.capacity >= 512;
+    }
+
+    size_t threads = pool.size();
+    for (size_t reserved : {(size_t)0, (size_t)1, cores.size(), cores.size() + 5}) {
+        pool.set_affinity(utils::affinity_policy::reserve, reserved);
+        size_t kept = std::min(reserved, cores.size() - 1);
+        CHECK(pool.bound_cores().size() == cores.size() - kept);
+        CHECK(pool.size() == cores.size() - kept);
+    }
+
+    pool.set_affinity(utils::affinity_policy::big);
+    CHECK(pool.bound_cores().size() == big);
+    for (auto &c : pool.bound_cores())
+        CHECK(c.capacity >= 512);
+
+    // 绑核后任务照常执行
+    utils::task_group jobs;
+    std::atomic<size_t> n(0);
+    for (int i = 0; i < 100; ++i)
+        pool.post(jobs, [&n]() { ++n; });
+    pool.wait(jobs);
+    CHECK(n.load() == 100);
+
+    pool.set_affinity(utils::affinity_policy::none);
+    CHECK(pool.bound_cores().empty());
+    CHECK(pool.size() == threads);
+}
+
+int main()
+{
+    utils::threadpool pool(2);
+    test_group_isolation(pool);
+    test_nested(pool);
+    test_affinity(pool);
+    return check_result("test_threadpool");
+}
@@ -3,52 +3,274 @@
 
 #include "threadpool.h"
 
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
 namespace utils
 {
 
-// 工作线程函数
-void threadpool::work_thread()
+thread_local threadpool *threadpool::current_pool = nullptr;
+thread_local size_t threadpool::current_index = 0;
+
+// 扩容为两倍 保持头部到尾部的顺序
+void task_deque::grow()
 {
-    while (true) {
-        std::function<void()> task;
+    std::vector<pool_task> bigger(ring.size() * 2);
+    size_t n = count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i)
+        bigger[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+    ring.swap(bigger);
+    head = 0;
+}
+
+void task_deque::push(pool_task &&t)
+{
+    std::lock_guard<std::mutex> hold(lock);
+    size_t n = count.load(std::memory_order_relaxed);
+    if (n == ring.size())
+        grow();
+    ring[(head + n) & (ring.size() - 1)] = std::move(t);
+    count.store(n + 1, std::memory_order_relaxed);
+}
+
+// 所属线程从尾部取
+bool task_deque::pop(pool_task &t)
+{
+    if (size() == 0)
+        return false;
+    std::lock_guard<std::mutex> hold(lock);
+    size_t n = count.load(std::memory_order_relaxed);
+    if (n == 0)
+        return false;
+    t = std::move(ring[(head + n - 1) & (ring.size() - 1)]);
+    count.store(n - 1, std::memory_order_relaxed);
+    return true;
+}
+
+// 其它线程从头部窃取
+bool task_deque::steal(pool_task &t)
+{
+    if (size() == 0)
+        return false;
+    std::lock_guard<std::mutex> hold(lock);
+    size_t n = count.load(std::memory_order_relaxed);
+    if (n == 0)
+        return false;
+    t = std::move(ring[head]);
+    head = (head + 1) & (ring.size() - 1);
+    count.store(n - 1, std::memory_order_relaxed);
+    return true;
+}
+
+// 取出属于 group 的任务 from_tail 为真时从尾部找起
+// 在头部或尾部时直接出队 在中间时移动较短的一侧补上空位
+bool task_deque::take_group(const task_group *group, bool from_tail, pool_task &t)
+{
+    if (size() == 0)
+        return false;
+    std::lock_guard<std::mutex> hold(lock);
+    size_t n = count.load(std::memory_order_relaxed);
+    size_t mask = ring.size() - 1;
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = from_tail ? n - 1 - k : k;
+        if (ring[(head + i) & mask].group != group)
+            continue;
 
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+        t = std::move(ring[(head + i) & mask]);
+        if (i < n - 1 - i) {
+            for (size_t j = i; j > 0; --j)
+                ring[(head + j) & mask] = std::move(ring[(head + j - 1) & mask]);
+            head = (head + 1) & mask;
+        } else {
+            for (size_t j = i; j + 1 < n; ++j)
+                ring[(head + j) & mask] = std::move(ring[(head + j + 1) & mask]);
+        }
+        count.store(n - 1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
 
-            // 等待任务或停止信号
-            condition.wait(lock, [this] { 
-                return stop.load(std::memory_order_acquire) || !tasks.empty(); 
-            });
+// 任务出队后的计数
+void threadpool::taken(const pool_task &t)
+{
+    pending.fetch_sub(1);
+    if (t.group != nullptr)
+        t.group->queued.fetch_sub(1);
+}
 
-            // 如果停止且任务队列为空，则退出
-            if (stop.load(std::memory_order_acquire) && tasks.empty()) {
-                return;
-            }
+// 先取自己队列的尾部 再依次从其它队列头部窃取
+bool threadpool::take(size_t index, pool_task &t)
+{
+    size_t n = queues.size();
+    bool ok = queues[index]->pop(t);
+    for (size_t i = 1; !ok && i < n; ++i)
+        ok = queues[(index + i) % n]->steal(t);
+    if (ok)
+        taken(t);
+    return ok;
+}
+
+// 工作线程按 take 取 其它线程从各队列头部窃取
+bool threadpool::take_any(pool_task &t)
+{
+    if (current_pool == this)
+        return take(current_index, t);
 
-            // 如果有任务，取出任务
-            if (!tasks.empty()) {
-                task = std::move(tasks.front());
-                tasks.pop();
-            }
+    size_t n = queues.size();
+    size_t start = next_queue.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        if (queues[(start + i) % n]->steal(t)) {
+            taken(t);
+            return true;
         }
+    }
+    return false;
+}
 
-        // 执行任务（在锁外执行以减少锁持有时间）
-        if (task) {
-            active_tasks.fetch_add(1, std::memory_order_relaxed);
-            
-            try {
-                task();
-            } catch (...) {
-                // 捕获并忽略任务执行中的异常
-                // 实际应用中可以添加日志记录
-            }
-            
-            active_tasks.fetch_sub(1, std::memory_order_relaxed);
-            
-            // 通知可能在等待的 wait() 函数
-            wait_condition.notify_all();
+// 只取属于 group 的任务 工作线程先找自己队列的尾部
+bool threadpool::take_group(const task_group &group, pool_task &t)
+{
+    size_t n = queues.size();
+    size_t start = current_pool == this ? current_index : next_queue.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        bool own = i == 0 && current_pool == this;
+        if (queues[(start + i) % n]->take_group(&group, own, t)) {
+            taken(t);
+            return true;
         }
     }
+    return false;
+}
+
+void threadpool::run(pool_task &t)
+{
+    active_tasks.fetch_add(1, std::memory_order_relaxed);
+
+    try {
+        t();
+    } catch (...) {
+        // 捕获并忽略任务执行中的异常
+        // 实际应用中可以添加日志记录
+    }
+    auto group = t.group;
+    t = pool_task();
+
+    active_tasks.fetch_sub(1, std::memory_order_relaxed);
+
+    // 组内或全部的最后一个任务完成时通知等待的线程 计数归零后不能再访问 group
+    bool last = group != nullptr && group->count.fetch_sub(1) == 1;
+    last = unfinished.fetch_sub(1) == 1 || last;
+    if (last) {
+        std::lock_guard<std::mutex> hold(wait_mutex);
+        wait_condition.notify_all();
+    }
+}
+
+// 工作线程内提交的放进自己的队列 外部线程提交的轮流放入各队列
+void threadpool::push_task(pool_task &&t)
+{
+    if (stop.load(std::memory_order_acquire)) {
+        throw std::runtime_error("线程池已停止，无法提交新任务");
+    }
+
+    size_t index = current_pool == this ? current_index : slots[next_queue.fetch_add(1, std::memory_order_relaxed) % slots.size()];
+    if (t.group != nullptr) {
+        t.group->count.fetch_add(1);
+        t.group->queued.fetch_add(1);
+    }
+    unfinished.fetch_add(1);
+    queues[index]->push(std::move(t));
+    pending.fetch_add(1);
+
+    // 有线程休眠时才需要加锁唤醒 休眠前会先检查 pending
+    if (sleepers.load() != 0) {
+        std::lock_guard<std::mutex> hold(sleep_mutex);
+        condition.notify_one();
+    }
+    if (helpers.load() != 0) {
+        std::lock_guard<std::mutex> hold(wait_mutex);
+        wait_condition.notify_all();
+    }
+}
+
+// 全部完成前执行排队中的任务 没有可执行的任务时休眠 有新任务或全部完成时醒来
+void threadpool::help_all()
+{
+    pool_task task;
+    while (unfinished.load() != 0) {
+        if (take_any(task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        helpers.fetch_add(1);
+        wait_condition.wait(lock, [this] {
+            return unfinished.load() == 0 || pending.load() != 0;
+        });
+        helpers.fetch_sub(1);
+    }
+}
+
+// 组完成前只执行这一组排队中的任务 不会接手其它组里可能很久的任务
+// 组内的任务要么在排队 (自己执行) 要么正在别的线程上执行 嵌套的等待因此不会死锁
+void threadpool::help_group(task_group &group)
+{
+    pool_task task;
+    while (group.count.load() != 0) {
+        if (take_group(group, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        helpers.fetch_add(1);
+        wait_condition.wait(lock, [&group] {
+            return group.count.load() == 0 || group.queued.load() != 0;
+        });
+        helpers.fetch_sub(1);
+    }
+}
+
+// 工作线程函数
+void threadpool::work_thread(size_t index)
+{
+    current_pool = this;
+    current_index = index;
+
+    // 绑核失败时不绑核继续运行
+    if (!worker_cores.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker_cores[index % worker_cores.size()].id, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+
+    pool_task task;
+    while (true) {
+        if (take(index, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+
+        // 如果停止且没有排队的任务，则退出
+        if (stop.load(std::memory_order_acquire) && pending.load() == 0) {
+            return;
+        }
+
+        // 等待任务或停止信号
+        sleepers.fetch_add(1);
+        condition.wait(lock, [this] {
+            return stop.load(std::memory_order_acquire) || pending.load() != 0;
+        });
+        sleepers.fetch_sub(1);
+    }
 }
 
 // 停止所有线程
@@ -59,7 +281,10 @@ void threadpool::kill_thread()
     }
 
     // 设置停止标志
-    stop.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> hold(sleep_mutex);
+        stop.store(true, std::memory_order_release);
+    }
 
     // 唤醒所有等待的线程
     condition.notify_all();
@@ -94,13 +319,158 @@ void threadpool::resize(size_t count, bool wait_finish)
 
     // 重置停止标志
     stop.store(false, std::memory_order_release);
+    if (worker_cores.empty()) {
+        unpinned_count = count;
+    }
+    start_thread(count);
+}
+
+// 按数量创建队列和线程
+void threadpool::start_thread(size_t count)
+{
     thread_count = count;
 
-    // 创建新线程
+    queues.clear();
+    for (size_t i = 0; i < count; ++i) {
+        queues.emplace_back(std::make_unique<task_deque>());
+    }
+
+    // 算力最强的核心占 4 份 其余按比例 至少 1 份
+    uint32_t top = 0;
+    for (auto &core : worker_cores) {
+        top = std::max(top, core.capacity);
+    }
+    slots.clear();
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t weight = 1;
+        if (top != 0) {
+            weight = std::max<uint32_t>((worker_cores[i % worker_cores.size()].capacity * 4 + top / 2) / top, 1);
+        }
+        slots.insert(slots.end(), weight, i);
+    }
+
     workers.reserve(count);
     for (size_t i = 0; i < count; ++i) {
-        workers.emplace_back([this] { work_thread(); });
+        workers.emplace_back([this, i] { work_thread(i); });
+    }
+}
+
+// 读取 sysfs 中一个核心的整数属性 读不到为 0
+static uint32_t read_cpu_value(int id, const char *name)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", id, name);
+
+    unsigned value = 0;
+    FILE *f = fopen(path, "r");
+    if (f != nullptr) {
+        if (fscanf(f, "%u", &value) != 1) {
+            value = 0;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+std::vector<cpu_core> threadpool::cpu_cores()
+{
+    std::vector<cpu_core> cores;
+
+    // 在线核心列表 如 "0-3,5,7-8"
+    char buf[256] = {0};
+    FILE *f = fopen("/sys/devices/system/cpu/online", "r");
+    if (f != nullptr) {
+        if (fgets(buf, sizeof(buf), f) == nullptr) {
+            buf[0] = 0;
+        }
+        fclose(f);
+    }
+
+    for (char *p = buf; *p != 0;) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long id = first; id <= last; ++id) {
+            cores.push_back(cpu_core{(int)id, 0, 0});
+        }
+        if (*end != ',') {
+            break;
+        }
+        p = end + 1;
     }
+
+    if (cores.empty()) {
+        for (unsigned id = 0; id < std::max(std::thread::hardware_concurrency(), 1u); ++id) {
+            cores.push_back(cpu_core{(int)id, 0, 0});
+        }
+    }
+
+    uint32_t top_capacity = 0, top_freq = 0;
+    for (auto &core : cores) {
+        core.capacity = read_cpu_value(core.id, "cpu_capacity");
+        core.max_freq = read_cpu_value(core.id, "cpufreq/cpuinfo_max_freq");
+        top_capacity = std::max(top_capacity, core.capacity);
+        top_freq = std::max(top_freq, core.max_freq);
+    }
+
+    // 统一为最强核心 1024 没有 cpu_capacity 时按最高频率折算 都没有时视为相同
+    for (auto &core : cores) {
+        if (top_capacity != 0) {
+            core.capacity = (uint32_t)((uint64_t)core.capacity * 1024 / top_capacity);
+        } else if (top_freq != 0) {
+            core.capacity = (uint32_t)((uint64_t)core.max_freq * 1024 / top_freq);
+        } else {
+            core.capacity = 1024;
+        }
+    }
+    return cores;
+}
+
+void threadpool::set_affinity(affinity_policy p, size_t reserved)
+{
+    std::vector<cpu_core> cores;
+    if (p != affinity_policy::none) {
+        cores = cpu_cores();
+
+        // 按算力从高到低 算力相同时按编号
+        std::stable_sort(cores.begin(), cores.end(), [](const cpu_core &a, const cpu_core &b) {
+            return a.capacity > b.capacity;
+        });
+
+        if (p == affinity_policy::big) {
+            cores.erase(std::remove_if(cores.begin(), cores.end(), [](const cpu_core &c) {
+                return c.capacity < 512;
+            }), cores.end());
+        } else if (p == affinity_policy::reserve) {
+            cores.erase(cores.begin(), cores.begin() + std::min(reserved, cores.size() - 1));
+        }
+    }
+
+    // 等待当前任务完成后按新策略重建线程
+    wait();
+    kill_thread();
+    workers.clear();
+    stop.store(false, std::memory_order_release);
+
+    policy = p;
+    worker_cores = std::move(cores);
+    start_thread(worker_cores.empty() ? unpinned_count : worker_cores.size());
+}
+
+affinity_policy threadpool::affinity() const
+{
+    return policy;
+}
+
+const std::vector<cpu_core> &threadpool::bound_cores() const
+{
+    return worker_cores;
 }
 
 // 兼容旧接口
@@ -112,19 +482,20 @@ void threadpool::change_thread(size_t count)
 // 等待所有任务完成
 void threadpool::wait()
 {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    
-    // 等待任务队列为空且没有活跃任务
-    wait_condition.wait(lock, [this] {
-        return tasks.empty() && active_tasks.load(std::memory_order_relaxed) == 0;
-    });
+    // 等待所有已提交的任务执行完
+    help_all();
+}
+
+// 等待任务组完成
+void threadpool::wait(task_group &group)
+{
+    help_group(group);
 }
 
 // 获取待处理任务数量
 size_t threadpool::pending_tasks() const
 {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    return tasks.size();
+    return pending.load(std::memory_order_relaxed);
 }
 
 // 获取正在执行的任务数量
@@ -142,24 +513,28 @@ size_t threadpool::size() const
 // 检查线程池是否空闲
 bool threadpool::is_idle() const
 {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    return tasks.empty() && active_tasks.load(std::memory_order_relaxed) == 0;
+    return unfinished.load(std::memory_order_relaxed) == 0;
 }
 
 // 构造函数
 threadpool::threadpool(size_t count) 
     : thread_count(count > 0 ? count : std::thread::hardware_concurrency())
+    , unpinned_count(0)
+    , next_queue(0)
+    , policy(affinity_policy::none)
+    , pending(0)
+    , unfinished(0)
     , active_tasks(0)
+    , sleepers(0)
+    , helpers(0)
     , stop(false)
 {
     if (thread_count == 0) {
         thread_count = 1; // 至少有一个线程
     }
+    unpinned_count = thread_count;
 
-    workers.reserve(thread_count);
-    for (size_t i = 0; i < thread_count; ++i) {
-        workers.emplace_back([this] { work_thread(); });
-    }
+    start_thread(thread_count);
 }
 
 // 析构函数
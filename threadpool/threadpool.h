@@ -1,19 +1,141 @@
 #pragma once
 
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <atomic>
 
 namespace utils
 {
 
+class threadpool;
+
+/**
+ * @brief 一个在线 CPU 核心 (来自 /sys/devices/system/cpu)
+ */
+struct cpu_core {
+    int id;
+    uint32_t capacity; // 相对算力 最强的核心为 1024 读不到 cpu_capacity 时按最高频率折算
+    uint32_t max_freq; // 最高频率 kHz 读不到为 0
+};
+
+/**
+ * @brief 工作线程绑核策略
+ */
+enum class affinity_policy {
+    none,    // 不绑核 由系统调度 (默认)
+    all,     // 每个在线核心一个线程
+    big,     // 只用大核 (算力不低于最强核心的一半) 每核一个线程
+    reserve, // 留出最强的若干核心给目标进程 其余每核一个线程
+};
+
+/**
+ * @brief 任务组
+ *
+ * 用 post(group, ...) 提交的任务属于该组 wait(group) 只等这一组完成
+ * 等待的线程会执行这一组排队中的任务 而不是休眠 因此可以在任务中再提交任务组并等待 (嵌套并行)
+ * 组只能用于一个线程池 销毁前必须等待完成
+ */
+class task_group
+{
+private:
+    friend class threadpool;
+    std::atomic<size_t> count;  // 已提交未完成的任务数
+    std::atomic<size_t> queued; // 其中还在排队的任务数
+
+public:
+    task_group() : count(0), queued(0) {}
+
+    task_group(const task_group &) = delete;
+    task_group &operator=(const task_group &) = delete;
+
+    /**
+     * @brief 获取组内未完成的任务数量
+     */
+    size_t pending() const { return count.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief 不分配内存的任务
+ *
+ * 可调用对象不超过 capacity 字节时就地存放 放不下时才在堆上分配
+ * 只能移动 不能拷贝
+ */
+class pool_task
+{
+public:
+    static constexpr size_t capacity = 80;
+
+    task_group *group; // 所属的任务组 没有时为空
+
+    pool_task() noexcept : group(nullptr), ops(nullptr) {}
+
+    template <class F, class = std::enable_if_t<!std::is_same<std::decay_t<F>, pool_task>::value>>
+    explicit pool_task(F &&f);
+
+    pool_task(pool_task &&other) noexcept;
+    pool_task &operator=(pool_task &&other) noexcept;
+    ~pool_task();
+
+    pool_task(const pool_task &) = delete;
+    pool_task &operator=(const pool_task &) = delete;
+
+    explicit operator bool() const { return ops != nullptr; }
+
+    void operator()();
+
+private:
+    enum class op { call, move, destroy };
+    using ops_fn = void (*)(op, pool_task *self, pool_task *from);
+
+    template <class F>
+    static void inline_ops(op o, pool_task *self, pool_task *from);
+
+    template <class F>
+    static void heap_ops(op o, pool_task *self, pool_task *from);
+
+    void reset();
+
+    alignas(std::max_align_t) unsigned char storage[capacity];
+    ops_fn ops;
+};
+
+/**
+ * @brief 工作线程的任务双端队列
+ *
+ * 所属线程从尾部存取 (后进先出 数据还在缓存里) 其它线程从头部窃取
+ * 每个队列一把锁 线程之间只在窃取时才会竞争
+ */
+class task_deque
+{
+private:
+    std::vector<pool_task> ring; // 容量为 2 的幂
+    size_t head;
+    std::atomic<size_t> count;
+    std::mutex lock;
+
+    void grow();
+
+public:
+    task_deque() : ring(64), head(0), count(0) {}
+
+    void push(pool_task &&t);
+    bool pop(pool_task &t);
+    bool steal(pool_task &t);
+    bool take_group(const task_group *group, bool from_tail, pool_task &t);
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+};
+
 /**
  * @brief 线程池类，用于管理和调度任务执行
  * 
@@ -21,25 +143,53 @@ namespace utils
  * - 支持任意可调用对象 (函数、lambda、仿函数等)
  * - 自动管理线程生命周期
  * - 通过 std::future 获取任务返回值
+ * - post 提交不需要返回值的任务 不分配内存
+ * - 每个工作线程一个任务队列 空闲时从其它线程窃取
+ * - 工作线程内提交的任务放进自己的队列 后进先出
+ * - 可按大小核绑定工作线程 外部提交的任务按核心算力加权分配
  * - 支持动态调整线程数量
  * - 线程安全
  */
 class threadpool
 {
 private:
-    void work_thread();
+    void work_thread(size_t index);
     void kill_thread();
+    void start_thread(size_t count);
+
+    void taken(const pool_task &t);
+    bool take(size_t index, pool_task &t);
+    bool take_any(pool_task &t);
+    bool take_group(const task_group &group, pool_task &t);
+    void run(pool_task &t);
+    void push_task(pool_task &&t);
+    void help_all();
+    void help_group(task_group &group);
 
-    std::vector<std::thread> workers;           // 工作线程集合
-    std::queue<std::function<void()>> tasks;    // 任务队列
+    std::vector<std::thread> workers;                 // 工作线程集合
+    std::vector<std::unique_ptr<task_deque>> queues;  // 每个工作线程的任务队列
 
     size_t thread_count;                        // 线程数量
+    size_t unpinned_count;                      // 不绑核时的线程数量
+    std::atomic<size_t> next_queue;             // 外部线程提交时轮流取 slots 中的队列
+    std::vector<uint32_t> slots;                // 队列下标 每个队列按所在核心的算力出现多次
+
+    affinity_policy policy;                     // 绑核策略
+    std::vector<cpu_core> worker_cores;         // 第 i 个工作线程绑定的核心 不绑核时为空
+    std::atomic<size_t> pending;                // 排队中的任务数
+    std::atomic<size_t> unfinished;             // 已提交未完成的任务数
     std::atomic<size_t> active_tasks;           // 正在执行的任务数
+    std::atomic<size_t> sleepers;               // 休眠中的工作线程数
+    std::atomic<size_t> helpers;                // 在 wait 中休眠的线程数
     std::atomic<bool> stop;                     // 停止标志
-    
-    mutable std::mutex queue_mutex;             // 队列互斥锁 (mutable 以支持 const 方法)
+
+    std::mutex sleep_mutex;                     // 工作线程休眠用
     std::condition_variable condition;          // 条件变量 (用于唤醒工作线程)
-    std::condition_variable wait_condition;     // 等待条件变量 (用于 wait())
+    std::mutex wait_mutex;
+    std::condition_variable wait_condition;     // 等待条件变量 (用于 wait() 和 wait(group))
+
+    static thread_local threadpool *current_pool;  // 当前线程所属的线程池 外部线程为空
+    static thread_local size_t current_index;      // 当前线程在所属线程池中的下标
 
 public:
     /**
@@ -66,6 +216,21 @@ public:
     template <class F, class... Args>
     auto pushpool(F &&f, Args &&...args) -> std::future<decltype(f(args...))>;
 
+    /**
+     * @brief 提交不需要返回值的任务
+     * 不创建 future 可调用对象和参数不超过 pool_task::capacity 字节时不分配内存
+     * 任务抛出的异常被忽略
+     * @throws std::runtime_error 如果线程池已停止
+     */
+    template <class F, class... Args>
+    void post(F &&f, Args &&...args);
+
+    /**
+     * @brief 提交属于任务组 group 的任务 其余同 post
+     */
+    template <class F, class... Args>
+    void post(task_group &group, F &&f, Args &&...args);
+
     /**
      * @brief 动态调整线程池大小
      * @param count 新的线程数量
@@ -78,11 +243,43 @@ public:
      */
     void change_thread(size_t count);
 
+    /**
+     * @brief 读取在线核心的算力和最高频率
+     * 按核心编号排序 读不到 sysfs 时按 hardware_concurrency 返回算力相同的核心
+     */
+    static std::vector<cpu_core> cpu_cores();
+
+    /**
+     * @brief 设置绑核策略 等待当前任务完成后按策略重建工作线程
+     * 绑核时每个选中的核心一个线程 (sched_setaffinity) 外部提交的任务按核心算力加权分配
+     * 小核分到的任务少 每层的尾部不再由小核上的任务决定
+     * @param policy 策略 none 恢复不绑核和原来的线程数
+     * @param reserved reserve 策略下留给目标进程的核心数 至少保留一个核心给线程池
+     */
+    void set_affinity(affinity_policy policy, size_t reserved = 0);
+
+    /**
+     * @brief 获取当前绑核策略
+     */
+    affinity_policy affinity() const;
+
+    /**
+     * @brief 获取工作线程绑定的核心 不绑核时为空
+     */
+    const std::vector<cpu_core> &bound_cores() const;
+
     /**
      * @brief 等待所有任务完成
+     * 等待期间调用线程也执行排队中的任务 不能在工作线程中调用 (自己的任务永远不会完成)
      */
     void wait();
 
+    /**
+     * @brief 只等待任务组 group 完成
+     * 等待期间调用线程执行这一组排队中的任务 可以在工作线程中调用
+     */
+    void wait(task_group &group);
+
     /**
      * @brief 获取待处理任务数量
      */
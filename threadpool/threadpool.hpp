@@ -5,6 +5,92 @@
 namespace utils
 {
 
+template <class F, class>
+pool_task::pool_task(F &&f) : group(nullptr)
+{
+    using fn_type = std::decay_t<F>;
+
+    // 放得下且移动不抛异常时就地存放
+    if constexpr (sizeof(fn_type) <= capacity && alignof(fn_type) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<fn_type>::value) {
+        new (storage) fn_type(std::forward<F>(f));
+        ops = &inline_ops<fn_type>;
+    } else {
+        *reinterpret_cast<fn_type **>(storage) = new fn_type(std::forward<F>(f));
+        ops = &heap_ops<fn_type>;
+    }
+}
+
+template <class F>
+void pool_task::inline_ops(op o, pool_task *self, pool_task *from)
+{
+    switch (o) {
+    case op::call:
+        (*reinterpret_cast<F *>(self->storage))();
+        break;
+    case op::move:
+        new (self->storage) F(std::move(*reinterpret_cast<F *>(from->storage)));
+        reinterpret_cast<F *>(from->storage)->~F();
+        break;
+    case op::destroy:
+        reinterpret_cast<F *>(self->storage)->~F();
+        break;
+    }
+}
+
+template <class F>
+void pool_task::heap_ops(op o, pool_task *self, pool_task *from)
+{
+    switch (o) {
+    case op::call:
+        (**reinterpret_cast<F **>(self->storage))();
+        break;
+    case op::move:
+        *reinterpret_cast<F **>(self->storage) = *reinterpret_cast<F **>(from->storage);
+        break;
+    case op::destroy:
+        delete *reinterpret_cast<F **>(self->storage);
+        break;
+    }
+}
+
+inline pool_task::pool_task(pool_task &&other) noexcept : group(other.group), ops(other.ops)
+{
+    if (ops != nullptr)
+        ops(op::move, this, &other);
+    other.ops = nullptr;
+}
+
+inline pool_task &pool_task::operator=(pool_task &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        group = other.group;
+        ops = other.ops;
+        if (ops != nullptr)
+            ops(op::move, this, &other);
+        other.ops = nullptr;
+    }
+    return *this;
+}
+
+inline pool_task::~pool_task()
+{
+    reset();
+}
+
+inline void pool_task::reset()
+{
+    if (ops != nullptr)
+        ops(op::destroy, this, nullptr);
+    group = nullptr;
+    ops = nullptr;
+}
+
+inline void pool_task::operator()()
+{
+    ops(op::call, this, nullptr);
+}
+
 // submit 实现 - 推荐使用
 template <class F, class... Args>
 auto threadpool::submit(F &&f, Args &&...args) -> std::future<decltype(f(args...))>
@@ -23,27 +109,9 @@ auto threadpool::submit(F &&f, Args &&...args) -> std::future<decltype(f(args...
 
     std::future<return_type> result = task->get_future();
 
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        
-        // 再次检查，防止在获取锁期间线程池被停止
-        if (stop.load(std::memory_order_acquire)) {
-            throw std::runtime_error("线程池已停止，无法提交新任务");
-        }
-
-        // 将任务包装为 void() 函数并加入队列
-        tasks.emplace([task]() { 
-            try {
-                (*task)(); 
-            } catch (...) {
-                // packaged_task 会自动捕获异常并存储到 future 中
-            }
-        });
-    }
+    // packaged_task 会自动捕获异常并存储到 future 中
+    push_task(pool_task([task]() { (*task)(); }));
 
-    // 唤醒一个等待的线程
-    condition.notify_one();
-    
     return result;
 }
 
@@ -54,4 +122,19 @@ auto threadpool::pushpool(F &&f, Args &&...args) -> std::future<decltype(f(args.
     return submit(std::forward<F>(f), std::forward<Args>(args)...);
 }
 
-} // namespace utils
\ No newline at end of file
+// post 实现 - 不需要返回值时使用
+template <class F, class... Args>
+void threadpool::post(F &&f, Args &&...args)
+{
+    push_task(pool_task(std::bind(std::forward<F>(f), std::forward<Args>(args)...)));
+}
+
+template <class F, class... Args>
+void threadpool::post(task_group &group, F &&f, Args &&...args)
+{
+    pool_task task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    task.group = &group;
+    push_task(std::move(task));
+}
+
+} // namespace utils